@@ -0,0 +1,70 @@
+// per instance transform storage, one layout per shader variant.
+// the build defines one of INSTANCE_AFFINE, INSTANCE_QUAT or INSTANCE_QUAT_HALF,
+// a full mat4 is used when none is. INSTANCE_BINDING is the binding in set 0.
+
+#ifndef INSTANCE_BINDING
+#define INSTANCE_BINDING 1
+#endif
+
+#if defined(INSTANCE_AFFINE)
+
+// 48 bytes, the three top rows of the matrix
+layout(std430, set = 0, binding = INSTANCE_BINDING) readonly buffer storageBuffer {
+    vec4 rows[];
+} ObjectData;
+
+mat4 instance_transform(uint index) {
+    return transpose(mat4(ObjectData.rows[index * 3u], ObjectData.rows[index * 3u + 1u],
+                          ObjectData.rows[index * 3u + 2u], vec4(0.0f, 0.0f, 0.0f, 1.0f)));
+}
+
+#elif defined(INSTANCE_QUAT) || defined(INSTANCE_QUAT_HALF)
+
+mat4 compose(vec3 position, vec4 rotation, float scale) {
+    vec4 q = rotation;
+    mat3 basis = mat3(
+        1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y + q.w * q.z), 2.0f * (q.x * q.z - q.w * q.y),
+        2.0f * (q.x * q.y - q.w * q.z), 1.0f - 2.0f * (q.x * q.x + q.z * q.z), 2.0f * (q.y * q.z + q.w * q.x),
+        2.0f * (q.x * q.z + q.w * q.y), 2.0f * (q.y * q.z - q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y)) * scale;
+    return mat4(vec4(basis[0], 0.0f), vec4(basis[1], 0.0f), vec4(basis[2], 0.0f), vec4(position, 1.0f));
+}
+
+#if defined(INSTANCE_QUAT)
+
+// 32 bytes, xyz position and w uniform scale, then the rotation quaternion xyzw
+layout(std430, set = 0, binding = INSTANCE_BINDING) readonly buffer storageBuffer {
+    vec4 data[];
+} ObjectData;
+
+mat4 instance_transform(uint index) {
+    vec4 positionScale = ObjectData.data[index * 2u];
+    return compose(positionScale.xyz, ObjectData.data[index * 2u + 1u], positionScale.w);
+}
+
+#else
+
+// 16 bytes, the same values as INSTANCE_QUAT packed as half floats
+layout(std430, set = 0, binding = INSTANCE_BINDING) readonly buffer storageBuffer {
+    uvec4 halves[];
+} ObjectData;
+
+mat4 instance_transform(uint index) {
+    uvec4 halves = ObjectData.halves[index];
+    vec4 positionScale = vec4(unpackHalf2x16(halves.x), unpackHalf2x16(halves.y));
+    vec4 rotation = vec4(unpackHalf2x16(halves.z), unpackHalf2x16(halves.w));
+    return compose(positionScale.xyz, normalize(rotation), positionScale.w);
+}
+
+#endif
+
+#else
+
+layout(std140, set = 0, binding = INSTANCE_BINDING) readonly buffer storageBuffer {
+    mat4 model[];
+} ObjectData;
+
+mat4 instance_transform(uint index) {
+    return ObjectData.model[index];
+}
+
+#endif
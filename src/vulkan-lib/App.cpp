@@ -3,6 +3,8 @@ module;
 #include <chrono>
 module vulkan_lib.app;
 
+import <atomic>;
+import <thread>;
 import <sstream>;
 
 import <iostream>;
@@ -10,15 +12,17 @@ import <format>;
 import vulkan_lib.engine;
 import vulkan_lib.scene;
 import vulkan_lib.result;
+import vulkan_lib.frameSnapshot;
+import vulkan_lib.camera3D;
 
 //#include "Engine.h"
 //#include "Scene.h"
 namespace vkl {
-    App::App(int width, int height) {
+    App::App(int width, int height, FrameMode mode) : mode(mode) {
         auto res = build_glfw_window(width, height);
         if (!res)
             throw std::runtime_error(std::format("failed to make window: {}", res.error().message));
-        graphicsEngine = std::make_unique<Engine>(width, height, window);
+        graphicsEngine = std::make_unique<Engine>(width, height, window, jobSystem);
     }
 
     App::~App() {
@@ -44,9 +48,12 @@ namespace vkl {
     }
 
     [[nodiscard]] std::expected<EmptyOk, EmptyErr>    App::run() {
+        if (mode == FrameMode::Pipelined)
+            return run_pipelined();
         std::chrono::time_point start = std::chrono::high_resolution_clock::now();
         while (!glfwWindowShouldClose(window)) {
             glfwPollEvents();
+            jobSystem.run_main_jobs();
             std::chrono::time_point end = std::chrono::high_resolution_clock::now();//get end
             if (!graphicsEngine->render(scene, std::chrono::duration_cast<std::chrono::duration<float>>(end - start)))
                 return std::unexpected(EmptyErr{});
@@ -56,13 +63,59 @@ namespace vkl {
         return EmptyOk{};
     }
 
+    ///the window thread keeps polling and rendering, glfw and the swapchain
+    ///recreation it triggers have to stay on it. the simulation moves its own
+    ///copy of the camera with the keys the window thread last saw held.
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> App::run_pipelined() {
+        SnapshotQueue snapshots;
+        vkInit::Camera simulatedCamera = graphicsEngine->camera_state();
+        std::atomic<int> heldKeys = simulatedCamera.state;
+
+        std::thread simulation([&]() {
+            std::chrono::time_point start = std::chrono::high_resolution_clock::now();
+            uint64_t frame = 0;
+            while (FrameSnapshot* snapshot = snapshots.begin_write()) {
+                std::chrono::time_point end = std::chrono::high_resolution_clock::now();
+                simulatedCamera.state = heldKeys.load(std::memory_order_relaxed);
+                simulatedCamera.update(std::chrono::duration_cast<std::chrono::duration<float>>(end - start));
+                start = end;
+                snapshot->frame = frame++;
+                snapshot->camera = simulatedCamera;
+                snapshot->triangleRPositions.assign(scene.triangleRPositions.begin(), scene.triangleRPositions.end());
+                snapshots.publish();
+            }
+        });
+
+        std::expected<EmptyOk, EmptyErr> result = EmptyOk{};
+        while (!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            jobSystem.run_main_jobs();
+            heldKeys.store(graphicsEngine->camera_state().state, std::memory_order_relaxed);
+            const FrameSnapshot* snapshot = snapshots.begin_read();
+            if (!snapshot)
+                break;
+            auto rendered = graphicsEngine->render(*snapshot);
+            snapshots.end_read();
+            if (!rendered) {
+                result = std::unexpected(EmptyErr{});
+                break;
+            }
+            calculateFrameRate();
+        }
+        snapshots.close();
+        simulation.join();
+        return result;
+    }
+
     void App::calculateFrameRate() {
         currentTime = glfwGetTime();
         double delta = currentTime - lastTime;
         if (delta >= 1) {
             int framerate{ std::max(1, int(numFrames / delta)) };
             std::stringstream title;
-            title << "Running at " << framerate << " fps.";
+            title << "Running at " << framerate << " fps, "
+                << graphicsEngine->occlusion_stats().occlusionRejected << " instances occluded, "
+                << graphicsEngine->draw_counters().draws << " draws.";
             glfwSetWindowTitle(window, title.str().c_str());
             lastTime = currentTime;
             numFrames = -1;
@@ -4,28 +4,41 @@ import <GLFW/glfw3.h>;
 import <expected>;
 import <memory>;
 import vulkan_lib.engine;
+import vulkan_lib.jobSystem;
 import vulkan_lib.scene;
 import vulkan_lib.result;
 
 namespace vkl {
+    export enum class FrameMode {
+        ///update and render one after the other on the window thread
+        Serial,
+        ///a simulation thread produces snapshots the window thread renders, a frame
+        ///takes as long as the slower of the two instead of both together
+        Pipelined,
+    };
+
     export class App {
     public:
-        App(int width, int height);
+        App(int width, int height, FrameMode mode = FrameMode::Serial);
         ~App();
         App(const App& ref) = delete;
         App& operator=(const App& ref) = delete;
         [[nodiscard]] Result<EmptyOk> run();
 
     private:
+        //declared first, the engine's work runs on it until the engine is gone
+        JobSystem jobSystem;
         std::unique_ptr<Engine> graphicsEngine;
         Scene scene;
         GLFWwindow* window;
+        FrameMode mode;
 
         double lastTime, currentTime;
         int numFrames;
         float frameTime;
 
         [[nodiscard]] Result<EmptyOk, Error> build_glfw_window(int width, int height)noexcept;
+        [[nodiscard]] Result<EmptyOk> run_pipelined();
         void calculateFrameRate();
 
     };
@@ -0,0 +1,116 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.asyncCompute;
+
+import vulkan_lib.logging;
+
+namespace vkl {
+
+    AsyncCompute::AsyncCompute() : separateFamily(false), currentFrame(0), joined(0), submissions(0), joins(0) {
+    }
+
+    AsyncCompute::~AsyncCompute() {
+        destroy();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> AsyncCompute::make(vk::Device device, vkUtil::Queue queue, uint32_t graphicsFamily,
+        uint32_t framesInFlight) noexcept {
+        destroy();
+        this->device = device;
+        this->queue = queue;
+        separateFamily = queue.queueFamilyIndex != graphicsFamily;
+        joined = 0;
+        if (!computeTimeline.make(device))
+            return std::unexpected(EmptyErr{});
+        return resize(framesInFlight);
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> AsyncCompute::resize(uint32_t framesInFlight) noexcept {
+        //one recording thread, the work is submitted from the frame loop
+        if (!commands.make(device, queue.queueFamilyIndex, framesInFlight, 1))
+            return std::unexpected(EmptyErr{});
+        currentFrame = 0;
+        frameValues.assign(framesInFlight, computeTimeline.submitted());
+        return EmptyOk{};
+    }
+
+    void AsyncCompute::destroy() noexcept {
+        commands.destroy();
+        computeTimeline.destroy();
+        frameValues.clear();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> AsyncCompute::begin_frame(uint32_t frame) noexcept {
+        //free when the slot's work finished while the frames in between ran
+        if (!computeTimeline.wait(frameValues[frame]) || !computeTimeline.collect())
+            return std::unexpected(EmptyErr{});
+        currentFrame = frame;
+        return commands.begin_frame(frame);
+    }
+
+    [[nodiscard]] std::expected<uint64_t, EmptyErr> AsyncCompute::submit(const std::function<void(vk::CommandBuffer)>& record,
+        std::span<const vk::SemaphoreSubmitInfo> waits) noexcept {
+        auto command_buffer_res = commands.allocate(0, vk::CommandBufferLevel::ePrimary);
+        if (!command_buffer_res)
+            return std::unexpected(EmptyErr{});
+        vk::CommandBuffer commandBuffer = command_buffer_res.value();
+        vk::CommandBufferBeginInfo beginInfo = {};
+        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        if (commandBuffer.begin(beginInfo) != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to begin async compute command buffer");
+            return std::unexpected(EmptyErr{});
+        }
+        record(commandBuffer);
+        if (commandBuffer.end() != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to record async compute command buffer");
+            return std::unexpected(EmptyErr{});
+        }
+
+        const uint64_t value = computeTimeline.next();
+        vk::SemaphoreSubmitInfo signalInfo = computeTimeline.signal_info(value, vk::PipelineStageFlagBits2::eAllCommands);
+        vk::CommandBufferSubmitInfo commandInfo = {};
+        commandInfo.commandBuffer = commandBuffer;
+        vk::SubmitInfo2 submitInfo = {};
+        submitInfo.waitSemaphoreInfoCount = static_cast<uint32_t>(waits.size());
+        submitInfo.pWaitSemaphoreInfos = waits.data();
+        submitInfo.commandBufferInfoCount = 1;
+        submitInfo.pCommandBufferInfos = &commandInfo;
+        submitInfo.signalSemaphoreInfoCount = 1;
+        submitInfo.pSignalSemaphoreInfos = &signalInfo;
+        if (queue.queue.submit2(submitInfo, nullptr) != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to submit async compute");
+            return std::unexpected(EmptyErr{});
+        }
+        computeTimeline.commit(value);
+        frameValues[currentFrame] = value;
+        submissions++;
+        return value;
+    }
+
+    [[nodiscard]] std::optional<vk::SemaphoreSubmitInfo> AsyncCompute::join(vk::PipelineStageFlags2 stages) noexcept {
+        if (computeTimeline.submitted() <= joined)
+            return std::nullopt;
+        //the timeline counts up, waiting on the last value waits on everything before it
+        joined = computeTimeline.submitted();
+        joins++;
+        return computeTimeline.wait_info(joined, stages);
+    }
+
+    [[nodiscard]] bool AsyncCompute::dedicated() const noexcept {
+        return separateFamily;
+    }
+
+    [[nodiscard]] QueueTimeline& AsyncCompute::timeline() noexcept {
+        return computeTimeline;
+    }
+
+    [[nodiscard]] AsyncComputeStats AsyncCompute::stats() const noexcept {
+        AsyncComputeStats result = {};
+        result.dedicated = separateFamily;
+        result.submissions = submissions;
+        result.joins = joins;
+        return result;
+    }
+}
@@ -0,0 +1,79 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.asyncCompute;
+
+import <expected>;
+import <functional>;
+import <optional>;
+import <span>;
+import <vector>;
+import vulkan_lib.commandAllocator;
+import vulkan_lib.queueFamilies;
+import vulkan_lib.result;
+import vulkan_lib.timeline;
+
+namespace vkl {
+
+    export struct AsyncComputeStats {
+        ///false when compute shares the graphics family and only queues behind it
+        bool dedicated;
+        uint64_t submissions;
+        ///graphics submissions that waited on compute work
+        uint64_t joins;
+    };
+
+    ///compute work submitted to its own queue next to the frame.
+    ///
+    ///every submission signals the compute timeline and the graphics submission
+    ///that uses its results takes join as one of its waits, so the two queues
+    ///only meet where the graphics work needs the output. with a dedicated
+    ///family the work overlaps the frame, on devices with one family it runs on
+    ///the graphics family and is still correct. buffers and images it shares
+    ///with graphics must be made with concurrent sharing when the families
+    ///differ, or be handed over with queue family ownership barriers.
+    ///
+    ///command buffers come from per frame pools like the graphics ones, a
+    ///frame's pool is reset by begin_frame once its last submission completed.
+    export class AsyncCompute {
+    public:
+        AsyncCompute();
+        ~AsyncCompute();
+        AsyncCompute(const AsyncCompute& ref) = delete;
+        AsyncCompute& operator=(const AsyncCompute& ref) = delete;
+
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make(vk::Device device, vkUtil::Queue queue, uint32_t graphicsFamily,
+            uint32_t framesInFlight) noexcept;
+        ///the frame count changed with the swapchain, the queue must be idle
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> resize(uint32_t framesInFlight) noexcept;
+        ///runs the pending releases, the queue must be idle
+        void destroy() noexcept;
+
+        ///waits for frame's last submission and recycles its command buffers
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> begin_frame(uint32_t frame) noexcept;
+        ///records one command buffer and submits it after waits, returns the value it signals
+        [[nodiscard]] std::expected<uint64_t, EmptyErr> submit(const std::function<void(vk::CommandBuffer)>& record,
+            std::span<const vk::SemaphoreSubmitInfo> waits = {}) noexcept;
+        ///wait for everything submitted since the last join, none when nothing was
+        [[nodiscard]] std::optional<vk::SemaphoreSubmitInfo> join(vk::PipelineStageFlags2 stages) noexcept;
+
+        [[nodiscard]] bool dedicated() const noexcept;
+        [[nodiscard]] QueueTimeline& timeline() noexcept;
+        [[nodiscard]] AsyncComputeStats stats() const noexcept;
+
+    private:
+        vk::Device device;
+        vkUtil::Queue queue;
+        bool separateFamily;
+        CommandAllocator commands;
+        QueueTimeline computeTimeline;
+        uint32_t currentFrame;
+        ///compute value each frame slot last signaled, indexed by frame
+        std::vector<uint64_t> frameValues;
+        ///last value a graphics submission waited on
+        uint64_t joined;
+        uint64_t submissions;
+        uint64_t joins;
+    };
+}
@@ -0,0 +1,239 @@
+///times the cpu side structures of the engine and the job system against the
+///plainest code doing the same work, built as its own executable next to the library
+#include <cstdio>
+import <algorithm>;
+import <atomic>;
+import <chrono>;
+import <cmath>;
+import <optional>;
+import <random>;
+import <vector>;
+import <glm/glm.hpp>;
+import <glm/gtc/matrix_transform.hpp>;
+import vulkan_lib.bounds;
+import vulkan_lib.bvh;
+import vulkan_lib.jobSystem;
+
+namespace {
+    constexpr uint32_t itemCount = 100000;
+    constexpr uint32_t queryCount = 1000;
+    constexpr int repeats = 10;
+    constexpr float worldSize = 200.0f;
+
+    ///fastest of repeats runs in milliseconds, setup runs untimed before each
+    template<typename Setup, typename Body>
+    double best_ms(Setup setup, Body body) {
+        double best = 1e30;
+        for (int i = 0; i < repeats; i++) {
+            setup();
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+
+    template<typename Body>
+    double best_ms(Body body) {
+        return best_ms([]() {}, body);
+    }
+
+    void report(const char* name, double ms, double baselineMs) {
+        std::printf("  %-34s %10.3f ms %10.3f ms %8.1fx\n", name, ms, baselineMs, baselineMs / ms);
+    }
+
+    [[nodiscard]] std::vector<vkl::Aabb> random_boxes(std::mt19937& random, uint32_t count) {
+        std::uniform_real_distribution<float> position(-worldSize * 0.5f, worldSize * 0.5f);
+        std::uniform_real_distribution<float> extent(0.2f, 1.0f);
+        std::vector<vkl::Aabb> boxes(count);
+        for (vkl::Aabb& box : boxes) {
+            const glm::vec3 center(position(random), position(random), position(random));
+            const glm::vec3 half(extent(random), extent(random), extent(random));
+            box = { center - half, center + half };
+        }
+        return boxes;
+    }
+
+    ///every box moved by up to distance, the way instances drift between frames
+    [[nodiscard]] std::vector<vkl::Aabb> moved_boxes(std::mt19937& random, const std::vector<vkl::Aabb>& boxes, float distance) {
+        std::uniform_real_distribution<float> step(-distance, distance);
+        std::vector<vkl::Aabb> moved(boxes);
+        for (vkl::Aabb& box : moved) {
+            const glm::vec3 offset(step(random), step(random), step(random));
+            box = { box.min + offset, box.max + offset };
+        }
+        return moved;
+    }
+
+    void bench_bvh(vkl::JobSystem& jobs) {
+        std::mt19937 random(7);
+        const std::vector<vkl::Aabb> boxes = random_boxes(random, itemCount);
+        const std::vector<vkl::Aabb> moved = moved_boxes(random, boxes, 0.5f);
+        std::printf("bvh over %u boxes\n  %-34s %13s %13s %9s\n", itemCount, "", "bvh", "baseline", "speedup");
+
+        //a brute force scan needs no structure, the build is what the tree costs up front
+        vkl::Bvh bvh;
+        const double buildMs = best_ms([&]() { bvh.build(boxes, jobs); });
+        std::printf("  %-34s %10.3f ms\n", "build", buildMs);
+
+        //a refit against rebuilding from scratch, updating a few moved items against refitting all
+        bool flip = false;
+        const double refitMs = best_ms([&]() { flip = !flip; }, [&]() { bvh.refit(flip ? moved : boxes); });
+        report("refit all vs build", refitMs, buildMs);
+        const uint32_t fewMoved = itemCount / 100;
+        const double updateFewMs = best_ms([&]() { flip = !flip; }, [&]() {
+            const std::vector<vkl::Aabb>& target = flip ? moved : boxes;
+            for (uint32_t i = 0; i < fewMoved; i++)
+                bvh.update(i * 100, target[i * 100]);
+        });
+        const double refitFewMs = best_ms([&]() { flip = !flip; }, [&]() { bvh.refit(flip ? moved : boxes); });
+        report("update 1% vs refit", updateFewMs, refitFewMs);
+        std::printf("  %-34s %10s\n", "prefers updates at 1%", bvh.prefers_updates(fewMoved) ? "yes" : "no");
+        bvh.build(boxes, jobs);
+
+        //a camera on the edge of the world looking at its center
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, worldSize);
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, worldSize * 0.5f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const vkl::Frustum frustum = vkl::make_frustum(projection * view);
+        std::vector<uint32_t> found;
+        std::vector<uint32_t> expected;
+        const double frustumMs = best_ms([&]() { found.clear(); }, [&]() { bvh.query_frustum(frustum, found); });
+        const double frustumBruteMs = best_ms([&]() { expected.clear(); }, [&]() {
+            for (uint32_t i = 0; i < itemCount; i++)
+                if (vkl::intersects(frustum, boxes[i]))
+                    expected.push_back(i);
+        });
+        report("frustum query", frustumMs, frustumBruteMs);
+        std::sort(found.begin(), found.end());
+        if (found != expected)
+            std::printf("  frustum query disagrees with the scan, %zu against %zu boxes\n", found.size(), expected.size());
+
+        std::vector<vkl::Aabb> queries = random_boxes(random, queryCount);
+        for (vkl::Aabb& query : queries) {
+            query.min -= glm::vec3(4.0f);
+            query.max += glm::vec3(4.0f);
+        }
+        size_t foundItems = 0;
+        size_t expectedItems = 0;
+        const double boxMs = best_ms([&]() { foundItems = 0; }, [&]() {
+            for (const vkl::Aabb& query : queries) {
+                found.clear();
+                bvh.query_aabb(query, found);
+                foundItems += found.size();
+            }
+        });
+        const double boxBruteMs = best_ms([&]() { expectedItems = 0; }, [&]() {
+            for (const vkl::Aabb& query : queries)
+                for (const vkl::Aabb& box : boxes)
+                    expectedItems += vkl::overlaps(box, query);
+        });
+        report("1000 box queries", boxMs, boxBruteMs);
+        if (foundItems != expectedItems)
+            std::printf("  box queries disagree with the scan, %zu against %zu hits\n", foundItems, expectedItems);
+
+        std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+        std::vector<glm::vec3> rays(queryCount);
+        for (glm::vec3& ray : rays)
+            ray = glm::normalize(glm::vec3(direction(random), direction(random), direction(random)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+        uint32_t hits = 0;
+        uint32_t expectedHits = 0;
+        const double rayMs = best_ms([&]() { hits = 0; }, [&]() {
+            for (const glm::vec3& ray : rays)
+                hits += bvh.query_ray(glm::vec3(0.0f), ray, worldSize).has_value();
+        });
+        const double rayBruteMs = best_ms([&]() { expectedHits = 0; }, [&]() {
+            for (const glm::vec3& ray : rays) {
+                const glm::vec3 inverseDirection = 1.0f / ray;
+                float maxT = worldSize;
+                bool hit = false;
+                float tNear;
+                for (const vkl::Aabb& box : boxes) {
+                    if (vkl::ray_hits(box, glm::vec3(0.0f), inverseDirection, maxT, tNear)) {
+                        maxT = tNear;
+                        hit = true;
+                    }
+                }
+                expectedHits += hit;
+            }
+        });
+        report("1000 nearest ray hits", rayMs, rayBruteMs);
+        if (hits != expectedHits)
+            std::printf("  ray queries disagree with the scan, %u against %u hits\n", hits, expectedHits);
+    }
+
+    ///a few transcendentals, per item work on the order of encoding one instance
+    [[nodiscard]] float item_work(uint32_t i) noexcept {
+        const float x = static_cast<float>(i) * 1e-3f;
+        return std::sin(x) * std::cos(x * 0.5f) + std::sqrt(x + 1.0f);
+    }
+
+    ///splits [first, last) in halves down to grain, the left halves as jobs, the way the bvh build recurses
+    void split_jobs(vkl::JobSystem& jobs, std::vector<float>& out, uint32_t first, uint32_t last, uint32_t grain) {
+        if (last - first <= grain) {
+            for (uint32_t i = first; i < last; i++)
+                out[i] = item_work(i);
+            return;
+        }
+        const uint32_t middle = first + (last - first) / 2;
+        vkl::JobCounter left;
+        jobs.submit([&jobs, &out, first, middle, grain]() { split_jobs(jobs, out, first, middle, grain); }, &left);
+        split_jobs(jobs, out, middle, last, grain);
+        jobs.wait(left);
+    }
+
+    void bench_jobs(vkl::JobSystem& jobs) {
+        constexpr uint32_t count = 1 << 22;
+        std::vector<float> out(count);
+        std::printf("job system over %u items\n  %-34s %13s %13s %9s\n", count, "", "jobs", "serial", "speedup");
+
+        const double serialMs = best_ms([&]() {
+            for (uint32_t i = 0; i < count; i++)
+                out[i] = item_work(i);
+        });
+        const uint32_t grains[] = { 0, 64, 1024, 16384 };
+        for (uint32_t grain : grains) {
+            const double parallelMs = best_ms([&]() {
+                jobs.parallel_for(0, count, grain, [&](uint32_t first, uint32_t last) {
+                    for (uint32_t i = first; i < last; i++)
+                        out[i] = item_work(i);
+                });
+            });
+            char name[64];
+            std::snprintf(name, sizeof(name), "parallel_for, grain %u", grain);
+            report(name, parallelMs, serialMs);
+        }
+
+        const vkl::JobStats before = jobs.stats();
+        const double splitMs = best_ms([&]() { split_jobs(jobs, out, 0, count, 4096); });
+        report("recursive split, nested waits", splitMs, serialMs);
+        const vkl::JobStats after = jobs.stats();
+        std::printf("  %-34s %10llu of %llu\n", "jobs stolen from another queue",
+            static_cast<unsigned long long>(after.stolen - before.stolen), static_cast<unsigned long long>(after.executed - before.executed));
+
+        //what one job costs when it does nothing, against calling the same function inline
+        constexpr uint32_t emptyJobs = 100000;
+        std::atomic<uint32_t> ran = 0;
+        const double submitMs = best_ms([&]() {
+            vkl::JobCounter counter;
+            for (uint32_t i = 0; i < emptyJobs; i++)
+                jobs.submit([&ran]() { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+            jobs.wait(counter);
+        });
+        const double inlineMs = best_ms([&]() {
+            for (uint32_t i = 0; i < emptyJobs; i++)
+                ran.fetch_add(1, std::memory_order_relaxed);
+        });
+        report("100000 empty jobs", submitMs, inlineMs);
+        std::printf("  %-34s %10.3f us\n", "overhead per job", (submitMs - inlineMs) * 1000.0 / emptyJobs);
+    }
+}
+
+int main()
+{
+    vkl::JobSystem jobs;
+    std::printf("%u workers and the calling thread\n\n", jobs.worker_count());
+    bench_bvh(jobs);
+    std::printf("\n");
+    bench_jobs(jobs);
+    return 0;
+}
@@ -0,0 +1,276 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.bindless;
+
+import <algorithm>;
+import <array>;
+import <functional>;
+import vulkan_lib.logging;
+
+namespace vkl {
+
+    [[nodiscard]] std::expected<uint32_t, EmptyErr> BindlessTable::SlotList::take() noexcept {
+        if (!free.empty()) {
+            std::pop_heap(free.begin(), free.end(), std::greater<uint32_t>());
+            uint32_t slot = free.back();
+            free.pop_back();
+            return slot;
+        }
+        if (next == capacity) {
+            vkInit::errprintDebug("bindless table is full");
+            return std::unexpected(EmptyErr{});
+        }
+        return next++;
+    }
+
+    void BindlessTable::SlotList::give_back(uint32_t slot) noexcept {
+        free.push_back(slot);
+        std::push_heap(free.begin(), free.end(), std::greater<uint32_t>());
+    }
+
+    BindlessTable::BindlessTable() : textures{}, buffers{}, materialCount(0), initialized(false) {
+    }
+
+    BindlessTable::~BindlessTable() {
+        destroy();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> BindlessTable::make(vk::Device device, vk::PhysicalDevice physicalDevice,
+        uint32_t maxTextures, uint32_t maxBuffers, uint32_t maxMaterials) noexcept {
+        destroy();
+        this->device = device;
+
+        vk::PhysicalDeviceVulkan12Properties limits = {};
+        vk::PhysicalDeviceProperties2 properties = {};
+        properties.pNext = &limits;
+        physicalDevice.getProperties2(&properties);
+        maxTextures = std::min({ maxTextures, limits.maxDescriptorSetUpdateAfterBindSampledImages,
+            limits.maxPerStageDescriptorUpdateAfterBindSampledImages });
+        maxBuffers = std::min({ maxBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers,
+            limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+        textures = { {}, 0, maxTextures };
+        buffers = { {}, 0, maxBuffers };
+
+        vk::DescriptorSetLayoutBinding bindings[2] = {};
+        bindings[bufferBinding].binding = bufferBinding;
+        bindings[bufferBinding].descriptorType = vk::DescriptorType::eStorageBuffer;
+        bindings[bufferBinding].descriptorCount = maxBuffers;
+        bindings[bufferBinding].stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
+        bindings[textureBinding].binding = textureBinding;
+        bindings[textureBinding].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        bindings[textureBinding].descriptorCount = maxTextures;
+        bindings[textureBinding].stageFlags = vk::ShaderStageFlagBits::eFragment;
+        //a variable count is only allowed on the last binding
+        const vk::DescriptorBindingFlags shared =
+            vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind;
+        vk::DescriptorBindingFlags bindingFlags[2] = {
+            shared, shared | vk::DescriptorBindingFlagBits::eVariableDescriptorCount
+        };
+        vk::DescriptorSetLayoutBindingFlagsCreateInfo flagsInfo = {};
+        flagsInfo.bindingCount = 2;
+        flagsInfo.pBindingFlags = bindingFlags;
+        vk::DescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.pNext = &flagsInfo;
+        layoutInfo.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+        layoutInfo.bindingCount = 2;
+        layoutInfo.pBindings = bindings;
+        vk::ResultValue<vk::DescriptorSetLayout> layoutR = device.createDescriptorSetLayout(layoutInfo);
+        if (layoutR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to create bindless set layout");
+            return std::unexpected(EmptyErr{});
+        }
+        setLayout = layoutR.value;
+
+        vk::DescriptorPoolSize poolSizes[2] = {
+            { vk::DescriptorType::eStorageBuffer, maxBuffers },
+            { vk::DescriptorType::eCombinedImageSampler, maxTextures },
+        };
+        vk::DescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = poolSizes;
+        vk::ResultValue<vk::DescriptorPool> poolR = device.createDescriptorPool(poolInfo);
+        if (poolR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to create bindless descriptor pool");
+            return std::unexpected(EmptyErr{});
+        }
+        pool = poolR.value;
+
+        vk::DescriptorSetVariableDescriptorCountAllocateInfo countInfo = {};
+        countInfo.descriptorSetCount = 1;
+        countInfo.pDescriptorCounts = &maxTextures;
+        vk::DescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.pNext = &countInfo;
+        allocInfo.descriptorPool = pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &setLayout;
+        if (device.allocateDescriptorSets(&allocInfo, &descriptorSet) != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to allocate bindless set");
+            return std::unexpected(EmptyErr{});
+        }
+
+        //the material table takes the first buffer slot, the shaders read it there
+        if (!materials.make(device, physicalDevice, vk::BufferUsageFlagBits::eStorageBuffer, maxMaterials))
+            return std::unexpected(EmptyErr{});
+        auto table_slot_res = add_buffer(materials.descriptor());
+        if (!table_slot_res || table_slot_res.value() != materialTableSlot)
+            return std::unexpected(EmptyErr{});
+
+        vkUtil::ImageInput input = {};
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.extent = vk::Extent2D(1, 1);
+        input.format = vk::Format::eR8G8B8A8Unorm;
+        input.usage = vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst;
+        input.aspect = vk::ImageAspectFlagBits::eColor;
+        auto image_res = vkUtil::make_image(input);
+        if (!image_res)
+            return std::unexpected(EmptyErr{});
+        whiteImage = image_res.value();
+        initialized = false;
+
+        vk::SamplerCreateInfo samplerInfo = {};
+        samplerInfo.magFilter = vk::Filter::eLinear;
+        samplerInfo.minFilter = vk::Filter::eLinear;
+        samplerInfo.mipmapMode = vk::SamplerMipmapMode::eLinear;
+        samplerInfo.addressModeU = vk::SamplerAddressMode::eRepeat;
+        samplerInfo.addressModeV = vk::SamplerAddressMode::eRepeat;
+        samplerInfo.addressModeW = vk::SamplerAddressMode::eRepeat;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        vk::ResultValue<vk::Sampler> samplerR = device.createSampler(samplerInfo);
+        if (samplerR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to create bindless sampler");
+            return std::unexpected(EmptyErr{});
+        }
+        sampler = samplerR.value;
+        auto texture_slot_res = add_texture(whiteImage.view, sampler);
+        if (!texture_slot_res || texture_slot_res.value() != defaultTexture)
+            return std::unexpected(EmptyErr{});
+
+        MaterialData white = {};
+        white.color = glm::vec4(1.0f);
+        white.texture = defaultTexture;
+        auto material_res = add_material(white);
+        if (!material_res || material_res.value() != defaultMaterial)
+            return std::unexpected(EmptyErr{});
+        return EmptyOk{};
+    }
+
+    void BindlessTable::destroy() noexcept {
+        if (!setLayout)
+            return;
+        materials.destroy();
+        materialCount = 0;
+        if (whiteImage.image)
+            vkUtil::destroy_image(device, whiteImage);
+        device.destroySampler(sampler);
+        sampler = nullptr;
+        //destroying the pool frees the set
+        device.destroyDescriptorPool(pool);
+        pool = nullptr;
+        descriptorSet = nullptr;
+        device.destroyDescriptorSetLayout(setLayout);
+        setLayout = nullptr;
+    }
+
+    [[nodiscard]] std::expected<uint32_t, EmptyErr> BindlessTable::add_texture(vk::ImageView view, vk::Sampler sampler,
+        vk::ImageLayout layout) noexcept {
+        auto slot_res = textures.take();
+        if (!slot_res)
+            return std::unexpected(EmptyErr{});
+        vk::DescriptorImageInfo imageInfo(sampler, view, layout);
+        vk::WriteDescriptorSet write = {};
+        write.dstSet = descriptorSet;
+        write.dstBinding = textureBinding;
+        write.dstArrayElement = slot_res.value();
+        write.descriptorCount = 1;
+        write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        write.pImageInfo = &imageInfo;
+        device.updateDescriptorSets(write, nullptr);
+        return slot_res.value();
+    }
+
+    void BindlessTable::remove_texture(uint32_t slot) noexcept {
+        //partially bound, the stale descriptor stays until the slot is written again
+        textures.give_back(slot);
+    }
+
+    [[nodiscard]] std::expected<uint32_t, EmptyErr> BindlessTable::add_buffer(const vk::DescriptorBufferInfo& info) noexcept {
+        auto slot_res = buffers.take();
+        if (!slot_res)
+            return std::unexpected(EmptyErr{});
+        write_buffer(slot_res.value(), info);
+        return slot_res.value();
+    }
+
+    void BindlessTable::set_buffer(uint32_t slot, const vk::DescriptorBufferInfo& info) noexcept {
+        write_buffer(slot, info);
+    }
+
+    void BindlessTable::remove_buffer(uint32_t slot) noexcept {
+        buffers.give_back(slot);
+    }
+
+    [[nodiscard]] std::expected<uint32_t, EmptyErr> BindlessTable::add_material(const MaterialData& material) noexcept {
+        if (materialCount == materials.capacity()) {
+            vkInit::errprintDebug("material table is full");
+            return std::unexpected(EmptyErr{});
+        }
+        //host coherent, frames in flight only read the ids handed out before
+        materials.span(materialCount + 1)[materialCount] = material;
+        return materialCount++;
+    }
+
+    void BindlessTable::record_pending(vk::CommandBuffer commandBuffer) noexcept {
+        if (initialized)
+            return;
+        vk::ImageMemoryBarrier2 barrier = {};
+        barrier.srcStageMask = vk::PipelineStageFlagBits2::eNone;
+        barrier.dstStageMask = vk::PipelineStageFlagBits2::eClear;
+        barrier.dstAccessMask = vk::AccessFlagBits2::eTransferWrite;
+        barrier.oldLayout = vk::ImageLayout::eUndefined;
+        barrier.newLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = whiteImage.image;
+        barrier.subresourceRange = vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+        vk::DependencyInfo dependency = {};
+        dependency.imageMemoryBarrierCount = 1;
+        dependency.pImageMemoryBarriers = &barrier;
+        commandBuffer.pipelineBarrier2(dependency);
+
+        vk::ClearColorValue white(std::array<float, 4>{ 1.0f, 1.0f, 1.0f, 1.0f });
+        commandBuffer.clearColorImage(whiteImage.image, vk::ImageLayout::eTransferDstOptimal, white, barrier.subresourceRange);
+
+        barrier.srcStageMask = vk::PipelineStageFlagBits2::eClear;
+        barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+        barrier.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+        barrier.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+        barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+        barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        commandBuffer.pipelineBarrier2(dependency);
+        initialized = true;
+    }
+
+    [[nodiscard]] vk::DescriptorSetLayout BindlessTable::layout() const noexcept {
+        return setLayout;
+    }
+
+    [[nodiscard]] vk::DescriptorSet BindlessTable::set() const noexcept {
+        return descriptorSet;
+    }
+
+    void BindlessTable::write_buffer(uint32_t slot, const vk::DescriptorBufferInfo& info) noexcept {
+        vk::WriteDescriptorSet write = {};
+        write.dstSet = descriptorSet;
+        write.dstBinding = bufferBinding;
+        write.dstArrayElement = slot;
+        write.descriptorCount = 1;
+        write.descriptorType = vk::DescriptorType::eStorageBuffer;
+        write.pBufferInfo = &info;
+        device.updateDescriptorSets(write, nullptr);
+    }
+}
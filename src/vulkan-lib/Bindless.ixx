@@ -0,0 +1,97 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.bindless;
+
+import <expected>;
+import <vector>;
+import <glm/glm.hpp>;
+import vulkan_lib.image;
+import vulkan_lib.memory;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    ///one entry of the material table the fragment shader indexes by material id
+    export struct MaterialData {
+        glm::vec4 color;
+        ///index into the texture array of the bindless set
+        uint32_t texture;
+        uint32_t padding[3];
+    };
+
+    ///the buffer array element that holds the material table, the shaders expect it here
+    export constexpr uint32_t materialTableSlot = 0;
+    ///a white texel, what materials without a texture sample
+    export constexpr uint32_t defaultTexture = 0;
+    export constexpr uint32_t defaultMaterial = 0;
+
+    ///one descriptor set holding every texture and buffer the shaders index.
+    ///
+    ///binding 0 is an array of storage buffers, binding 1 an array of combined
+    ///image samplers sized at allocation. both are partially bound and update
+    ///after bind, so slots are written while frames that use other slots are in
+    ///flight and unwritten slots are never touched. the set is bound once per
+    ///command buffer at set 1 and draws pick what they read through the material
+    ///id of their instance, changing materials no longer changes bound state.
+    export class BindlessTable {
+    public:
+        static constexpr uint32_t bufferBinding = 0;
+        static constexpr uint32_t textureBinding = 1;
+
+        BindlessTable();
+        ~BindlessTable();
+        BindlessTable(const BindlessTable& ref) = delete;
+        BindlessTable& operator=(const BindlessTable& ref) = delete;
+
+        ///the array sizes are clamped to the device's update after bind limits
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make(vk::Device device, vk::PhysicalDevice physicalDevice,
+            uint32_t maxTextures = 4096, uint32_t maxBuffers = 256, uint32_t maxMaterials = 1024) noexcept;
+        void destroy() noexcept;
+
+        ///the slot the texture was written to, sampled in layout
+        [[nodiscard]] std::expected<uint32_t, EmptyErr> add_texture(vk::ImageView view, vk::Sampler sampler,
+            vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal) noexcept;
+        ///the slot may be handed out again, no frame in flight may still sample it
+        void remove_texture(uint32_t slot) noexcept;
+        [[nodiscard]] std::expected<uint32_t, EmptyErr> add_buffer(const vk::DescriptorBufferInfo& info) noexcept;
+        ///points slot at another buffer, for buffers that were grown
+        void set_buffer(uint32_t slot, const vk::DescriptorBufferInfo& info) noexcept;
+        void remove_buffer(uint32_t slot) noexcept;
+        ///the id instances store to be drawn with it
+        [[nodiscard]] std::expected<uint32_t, EmptyErr> add_material(const MaterialData& material) noexcept;
+
+        ///clears the default texture the first time, before any draw samples it
+        void record_pending(vk::CommandBuffer commandBuffer) noexcept;
+
+        [[nodiscard]] vk::DescriptorSetLayout layout() const noexcept;
+        [[nodiscard]] vk::DescriptorSet set() const noexcept;
+
+    private:
+        ///hands out the lowest free slot below capacity
+        struct SlotList {
+            std::vector<uint32_t> free;
+            uint32_t next;
+            uint32_t capacity;
+
+            [[nodiscard]] std::expected<uint32_t, EmptyErr> take() noexcept;
+            void give_back(uint32_t slot) noexcept;
+        };
+
+        void write_buffer(uint32_t slot, const vk::DescriptorBufferInfo& info) noexcept;
+
+        vk::Device device;
+        vk::DescriptorSetLayout setLayout;
+        vk::DescriptorPool pool;
+        vk::DescriptorSet descriptorSet;
+        SlotList textures;
+        SlotList buffers;
+
+        vkUtil::GrowableBuffer<MaterialData> materials;
+        uint32_t materialCount;
+        vkUtil::AllocatedImage whiteImage;
+        vk::Sampler sampler;
+        bool initialized;
+    };
+}
@@ -0,0 +1,97 @@
+export module vulkan_lib.bounds;
+
+import <algorithm>;
+import <limits>;
+import <glm/glm.hpp>;
+
+namespace vkl {
+
+    export struct Aabb {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    ///box around a sphere stored as xyz center and w radius
+    export [[nodiscard]] inline auto
+    sphere_aabb(const glm::vec4& sphere) noexcept -> Aabb {
+        glm::vec3 center(sphere);
+        return { center - glm::vec3(sphere.w), center + glm::vec3(sphere.w) };
+    }
+
+    ///moves an object space sphere into world space, the radius grows with the largest axis scale
+    export [[nodiscard]] inline auto
+    transform_sphere(const glm::vec4& localSphere, const glm::mat4& model) noexcept -> glm::vec4 {
+        glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(localSphere), 1.0f));
+        float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+        return glm::vec4(center, localSphere.w * scale);
+    }
+
+    ///an empty box that any merge replaces
+    export [[nodiscard]] inline auto
+    empty_aabb() noexcept -> Aabb {
+        return { glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest()) };
+    }
+
+    export [[nodiscard]] inline auto
+    merge(const Aabb& a, const Aabb& b) noexcept -> Aabb {
+        return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+    }
+
+    export [[nodiscard]] inline auto
+    surface_area(const Aabb& box) noexcept -> float {
+        glm::vec3 size = glm::max(box.max - box.min, glm::vec3(0.0f));
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    export [[nodiscard]] inline auto
+    overlaps(const Aabb& a, const Aabb& b) noexcept -> bool {
+        return glm::all(glm::lessThanEqual(a.min, b.max)) && glm::all(glm::lessThanEqual(b.min, a.max));
+    }
+
+    export [[nodiscard]] inline auto
+    overlaps_sphere(const Aabb& box, const glm::vec3& center, float radius) noexcept -> bool {
+        glm::vec3 closest = glm::clamp(center, box.min, box.max) - center;
+        return glm::dot(closest, closest) <= radius * radius;
+    }
+
+    ///slab test, tNear is where the ray enters the box, 0 when it starts inside
+    export [[nodiscard]] inline auto
+    ray_hits(const Aabb& box, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxT, float& tNear) noexcept -> bool {
+        glm::vec3 t0 = (box.min - origin) * inverseDirection;
+        glm::vec3 t1 = (box.max - origin) * inverseDirection;
+        glm::vec3 tMin = glm::min(t0, t1);
+        glm::vec3 tMax = glm::max(t0, t1);
+        tNear = std::max({ tMin.x, tMin.y, tMin.z, 0.0f });
+        float tFar = std::min({ tMax.x, tMax.y, tMax.z, maxT });
+        return tNear <= tFar;
+    }
+
+    ///the six planes of a view projection, normals pointing inside
+    export struct Frustum {
+        glm::vec4 planes[6];
+    };
+
+    export [[nodiscard]] inline auto
+    make_frustum(const glm::mat4& viewProjection) noexcept -> Frustum {
+        glm::mat4 rows = glm::transpose(viewProjection);
+        Frustum frustum = {};
+        frustum.planes[0] = rows[3] + rows[0];
+        frustum.planes[1] = rows[3] - rows[0];
+        frustum.planes[2] = rows[3] + rows[1];
+        frustum.planes[3] = rows[3] - rows[1];
+        frustum.planes[4] = rows[3] + rows[2];
+        frustum.planes[5] = rows[3] - rows[2];
+        return frustum;
+    }
+
+    ///conservative, a box near a frustum corner may pass while being outside
+    export [[nodiscard]] inline auto
+    intersects(const Frustum& frustum, const Aabb& box) noexcept -> bool {
+        for (const glm::vec4& plane : frustum.planes) {
+            glm::vec3 farthest = glm::mix(box.min, box.max, glm::greaterThan(glm::vec3(plane), glm::vec3(0.0f)));
+            if (glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f)
+                return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,277 @@
+module vulkan_lib.bvh;
+
+import <algorithm>;
+import <array>;
+import <bit>;
+import <chrono>;
+import <limits>;
+
+namespace vkl {
+
+    constexpr uint32_t binCount = 16;
+    //subtrees with more items than this build the left child as a job
+    constexpr uint32_t parallelItems = 4096;
+    constexpr float traversalCost = 1.0f;
+
+    Bvh::Bvh() : nodesUsed(0), builtCost(0.0f), updatesSinceCost(0), jobs(nullptr), statistics{} {
+    }
+
+    void Bvh::build(std::span<const Aabb> boxes, JobSystem& jobs) noexcept {
+        auto start = std::chrono::steady_clock::now();
+        this->jobs = &jobs;
+        const uint32_t count = static_cast<uint32_t>(boxes.size());
+        itemBoxes.assign(boxes.begin(), boxes.end());
+        centroids.resize(count);
+        itemOrder.resize(count);
+        itemLeaf.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+            itemOrder[i] = i;
+        }
+
+        nodes.resize(std::max(1u, 2 * count));
+        nodesUsed = 1;
+        nodes[0].parent = std::numeric_limits<uint32_t>::max();
+        build_node(0, 0, count, 0);
+        nodes.resize(nodesUsed);
+
+        builtCost = sah_cost();
+        updatesSinceCost = 0;
+        statistics.costRatio = 1.0f;
+        statistics.nodeCount = nodesUsed;
+        statistics.builds++;
+        statistics.buildTime = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void Bvh::build_node(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth) noexcept {
+        Node& node = nodes[nodeIndex];
+        node.first = first;
+        node.count = count;
+        Aabb centroidBounds = empty_aabb();
+        node.bounds = empty_aabb();
+        for (uint32_t i = first; i < first + count; i++) {
+            node.bounds = merge(node.bounds, itemBoxes[itemOrder[i]]);
+            centroidBounds = merge(centroidBounds, { centroids[itemOrder[i]], centroids[itemOrder[i]] });
+        }
+        if (count <= leafSize || depth >= maxDepth) {
+            make_leaf(node, nodeIndex);
+            return;
+        }
+
+        glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+        int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+        //every centroid in the same spot, nothing to split
+        if (extent[axis] <= 0.0f) {
+            make_leaf(node, nodeIndex);
+            return;
+        }
+
+        std::array<Aabb, binCount> binBounds;
+        std::array<uint32_t, binCount> binItems = {};
+        binBounds.fill(empty_aabb());
+        const float scale = binCount / extent[axis];
+        auto bin_of = [&](uint32_t item) {
+            uint32_t bin = static_cast<uint32_t>((centroids[item][axis] - centroidBounds.min[axis]) * scale);
+            return std::min(bin, binCount - 1);
+        };
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t bin = bin_of(itemOrder[i]);
+            binBounds[bin] = merge(binBounds[bin], itemBoxes[itemOrder[i]]);
+            binItems[bin]++;
+        }
+
+        //sweep from the right to know the cost of everything after each split plane
+        std::array<float, binCount> rightCost = {};
+        Aabb sweep = empty_aabb();
+        uint32_t sweepItems = 0;
+        for (uint32_t bin = binCount - 1; bin > 0; bin--) {
+            sweep = merge(sweep, binBounds[bin]);
+            sweepItems += binItems[bin];
+            rightCost[bin] = sweepItems ? surface_area(sweep) * sweepItems : 0.0f;
+        }
+        float bestCost = std::numeric_limits<float>::max();
+        uint32_t bestSplit = 0;
+        sweep = empty_aabb();
+        sweepItems = 0;
+        for (uint32_t split = 1; split < binCount; split++) {
+            sweep = merge(sweep, binBounds[split - 1]);
+            sweepItems += binItems[split - 1];
+            if (sweepItems == 0 || sweepItems == count)
+                continue;
+            float cost = surface_area(sweep) * sweepItems + rightCost[split];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestSplit = split;
+            }
+        }
+
+        const float area = surface_area(node.bounds);
+        const float leafCost = area * count;
+        if (bestSplit == 0 || (count <= maxLeafSize && traversalCost * area + bestCost >= leafCost)) {
+            make_leaf(node, nodeIndex);
+            return;
+        }
+
+        auto middle = std::partition(itemOrder.begin() + first, itemOrder.begin() + first + count,
+            [&](uint32_t item) { return bin_of(item) < bestSplit; });
+        const uint32_t leftCount = static_cast<uint32_t>(middle - (itemOrder.begin() + first));
+
+        const uint32_t left = nodesUsed.fetch_add(2);
+        node.first = left;
+        node.count = 0;
+        nodes[left].parent = nodeIndex;
+        nodes[left + 1].parent = nodeIndex;
+
+        if (count > parallelItems) {
+            //waiting runs other jobs, nested splits never starve the workers
+            JobCounter leftBuild;
+            jobs->submit([=, this]() { build_node(left, first, leftCount, depth + 1); }, &leftBuild);
+            build_node(left + 1, first + leftCount, count - leftCount, depth + 1);
+            jobs->wait(leftBuild);
+        }
+        else {
+            build_node(left, first, leftCount, depth + 1);
+            build_node(left + 1, first + leftCount, count - leftCount, depth + 1);
+        }
+    }
+
+    void Bvh::make_leaf(Node& node, uint32_t nodeIndex) noexcept {
+        for (uint32_t i = node.first; i < node.first + node.count; i++)
+            itemLeaf[itemOrder[i]] = nodeIndex;
+    }
+
+    void Bvh::refit_node(uint32_t nodeIndex) noexcept {
+        Node& node = nodes[nodeIndex];
+        if (node.count == 0) {
+            node.bounds = merge(nodes[node.first].bounds, nodes[node.first + 1].bounds);
+            return;
+        }
+        node.bounds = empty_aabb();
+        for (uint32_t i = node.first; i < node.first + node.count; i++)
+            node.bounds = merge(node.bounds, itemBoxes[itemOrder[i]]);
+    }
+
+    void Bvh::update(uint32_t item, const Aabb& box) noexcept {
+        itemBoxes[item] = box;
+        for (uint32_t nodeIndex = itemLeaf[item]; nodeIndex != std::numeric_limits<uint32_t>::max(); nodeIndex = nodes[nodeIndex].parent)
+            refit_node(nodeIndex);
+        statistics.updates++;
+        //measuring walks every node, once per eighth of the items moved keeps it a constant per update
+        if (++updatesSinceCost > itemBoxes.size() / 8) {
+            statistics.costRatio = builtCost > 0.0f ? sah_cost() / builtCost : 1.0f;
+            updatesSinceCost = 0;
+        }
+    }
+
+    void Bvh::refit(std::span<const Aabb> boxes) noexcept {
+        auto start = std::chrono::steady_clock::now();
+        std::copy(boxes.begin(), boxes.end(), itemBoxes.begin());
+        //children are always allocated after their parent
+        for (uint32_t nodeIndex = static_cast<uint32_t>(nodes.size()); nodeIndex-- > 0;)
+            refit_node(nodeIndex);
+
+        statistics.costRatio = builtCost > 0.0f ? sah_cost() / builtCost : 1.0f;
+        updatesSinceCost = 0;
+        statistics.refits++;
+        statistics.refitTime = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    [[nodiscard]] float Bvh::sah_cost() const noexcept {
+        const float rootArea = surface_area(nodes[0].bounds);
+        if (rootArea <= 0.0f)
+            return 0.0f;
+        float cost = 0.0f;
+        for (const Node& node : nodes)
+            cost += surface_area(node.bounds) * (node.count ? node.count : traversalCost);
+        return cost / rootArea;
+    }
+
+    [[nodiscard]] bool Bvh::prefers_updates(size_t moved) const noexcept {
+        //an update refits about log2 of the node count, a refit every node
+        return moved * std::bit_width(nodes.size()) < nodes.size();
+    }
+
+    [[nodiscard]] bool Bvh::needs_rebuild() const noexcept {
+        return statistics.costRatio > rebuildRatio;
+    }
+
+    [[nodiscard]] size_t Bvh::size() const noexcept {
+        return itemBoxes.size();
+    }
+
+    [[nodiscard]] BvhStats Bvh::stats() const noexcept {
+        return statistics;
+    }
+
+    template<typename Overlaps>
+    void Bvh::query(Overlaps overlaps, std::vector<uint32_t>& out) const noexcept {
+        if (itemBoxes.empty())
+            return;
+        std::array<uint32_t, maxDepth + 2> stack;
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize) {
+            const Node& node = nodes[stack[--stackSize]];
+            if (!overlaps(node.bounds))
+                continue;
+            if (node.count == 0) {
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = node.first + 1;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+                if (overlaps(itemBoxes[itemOrder[i]]))
+                    out.push_back(itemOrder[i]);
+        }
+    }
+
+    void Bvh::query_frustum(const Frustum& frustum, std::vector<uint32_t>& out) const noexcept {
+        query([&](const Aabb& bounds) { return intersects(frustum, bounds); }, out);
+    }
+
+    void Bvh::query_aabb(const Aabb& box, std::vector<uint32_t>& out) const noexcept {
+        query([&](const Aabb& bounds) { return overlaps(bounds, box); }, out);
+    }
+
+    void Bvh::query_sphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const noexcept {
+        query([&](const Aabb& bounds) { return overlaps_sphere(bounds, center, radius); }, out);
+    }
+
+    [[nodiscard]] std::optional<RayHit> Bvh::query_ray(const glm::vec3& origin, const glm::vec3& direction, float maxT) const noexcept {
+        if (itemBoxes.empty())
+            return std::nullopt;
+        const glm::vec3 inverseDirection = 1.0f / direction;
+        std::optional<RayHit> hit;
+        float tNear;
+        std::array<uint32_t, maxDepth + 2> stack;
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize) {
+            const Node& node = nodes[stack[--stackSize]];
+            if (!ray_hits(node.bounds, origin, inverseDirection, maxT, tNear))
+                continue;
+            if (node.count == 0) {
+                //push the farther child first so the nearer one is visited first and shrinks maxT
+                float tLeft, tRight;
+                bool hitsLeft = ray_hits(nodes[node.first].bounds, origin, inverseDirection, maxT, tLeft);
+                bool hitsRight = ray_hits(nodes[node.first + 1].bounds, origin, inverseDirection, maxT, tRight);
+                if (hitsLeft && hitsRight) {
+                    stack[stackSize++] = tLeft < tRight ? node.first + 1 : node.first;
+                    stack[stackSize++] = tLeft < tRight ? node.first : node.first + 1;
+                }
+                else if (hitsLeft)
+                    stack[stackSize++] = node.first;
+                else if (hitsRight)
+                    stack[stackSize++] = node.first + 1;
+                continue;
+            }
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                if (ray_hits(itemBoxes[itemOrder[i]], origin, inverseDirection, maxT, tNear)) {
+                    maxT = tNear;
+                    hit = RayHit{ itemOrder[i], tNear };
+                }
+            }
+        }
+        return hit;
+    }
+}
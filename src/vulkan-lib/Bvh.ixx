@@ -0,0 +1,99 @@
+export module vulkan_lib.bvh;
+
+import <atomic>;
+import <optional>;
+import <span>;
+import <vector>;
+import <glm/glm.hpp>;
+import vulkan_lib.bounds;
+import vulkan_lib.jobSystem;
+
+namespace vkl {
+
+    ///cost of keeping the tree up to date, times in microseconds
+    export struct BvhStats {
+        float buildTime;
+        float refitTime;
+        uint32_t builds;
+        uint32_t refits;
+        ///items moved one at a time with update
+        uint32_t updates;
+        uint32_t nodeCount;
+        ///sah cost of the tree relative to the one it had right after its last build
+        float costRatio;
+    };
+
+    export struct RayHit {
+        uint32_t item;
+        float t;
+    };
+
+    ///bounding volume hierarchy over item boxes, built top down with binned sah.
+    ///items are identified by their index in the span given to build.
+    ///
+    ///moving items are refit in place, which keeps every query exact but lets the
+    ///tree degrade as items drift away from the ones they were grouped with.
+    ///needs_rebuild() reports when the sah cost grew enough to pay for a new build.
+    ///refit walks every node, update only the path of one item to the root, so
+    ///a frame where few items moved updates them and leaves the rest alone.
+    export class Bvh {
+    public:
+        static constexpr uint32_t leafSize = 4;
+        static constexpr uint32_t maxLeafSize = 16;
+        static constexpr uint32_t maxDepth = 48;
+        static constexpr float rebuildRatio = 1.5f;
+
+        Bvh();
+
+        ///big subtrees are built as jobs
+        void build(std::span<const Aabb> boxes, JobSystem& jobs) noexcept;
+        ///moves one item, its leaf and every ancestor up to the root are refit
+        void update(uint32_t item, const Aabb& box) noexcept;
+        ///refits every node to new boxes for the same items
+        void refit(std::span<const Aabb> boxes) noexcept;
+        ///updating moved items one at a time touches fewer nodes than a refit
+        [[nodiscard]] bool prefers_updates(size_t moved) const noexcept;
+        [[nodiscard]] bool needs_rebuild() const noexcept;
+        [[nodiscard]] size_t size() const noexcept;
+
+        ///queries append the items they find to out, in tree order
+        void query_frustum(const Frustum& frustum, std::vector<uint32_t>& out) const noexcept;
+        void query_aabb(const Aabb& box, std::vector<uint32_t>& out) const noexcept;
+        void query_sphere(const glm::vec3& center, float radius, std::vector<uint32_t>& out) const noexcept;
+        ///nearest item whose box the ray enters before maxT
+        [[nodiscard]] std::optional<RayHit> query_ray(const glm::vec3& origin, const glm::vec3& direction, float maxT) const noexcept;
+
+        [[nodiscard]] BvhStats stats() const noexcept;
+
+    private:
+        struct Node {
+            Aabb bounds;
+            //leaf: first entry of itemOrder. inner: left child, the right one follows it
+            uint32_t first;
+            //items in a leaf, 0 for inner nodes
+            uint32_t count;
+            uint32_t parent;
+        };
+
+        void build_node(uint32_t nodeIndex, uint32_t first, uint32_t count, uint32_t depth) noexcept;
+        void make_leaf(Node& node, uint32_t nodeIndex) noexcept;
+        void refit_node(uint32_t nodeIndex) noexcept;
+        [[nodiscard]] float sah_cost() const noexcept;
+
+        template<typename Overlaps>
+        void query(Overlaps overlaps, std::vector<uint32_t>& out) const noexcept;
+
+        std::vector<Node> nodes;
+        std::vector<Aabb> itemBoxes;
+        std::vector<glm::vec3> centroids;
+        std::vector<uint32_t> itemOrder;
+        std::vector<uint32_t> itemLeaf;
+        std::atomic<uint32_t> nodesUsed;
+        float builtCost;
+        ///updates since the cost ratio was last measured
+        uint32_t updatesSinceCost;
+        ///only set during build
+        JobSystem* jobs;
+        BvhStats statistics;
+    };
+}
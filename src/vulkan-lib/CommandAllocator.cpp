@@ -0,0 +1,107 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.commandAllocator;
+
+import <algorithm>;
+import <thread>;
+import vulkan_lib.logging;
+
+namespace vkl {
+
+    CommandAllocator::CommandAllocator() : threadCount(0), currentFrame(0), poolResets(0) {
+    }
+
+    CommandAllocator::~CommandAllocator() {
+        destroy();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> CommandAllocator::make(vk::Device device, uint32_t queueFamilyIndex, uint32_t framesInFlight,
+        uint32_t threads) noexcept {
+        destroy();
+        this->device = device;
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        threadCount = std::clamp(threads, 1u, maxThreads);
+        currentFrame = 0;
+        poolResets = 0;
+
+        //transient without individual resets, the driver may allocate them linearly
+        vk::CommandPoolCreateInfo poolInfo = {};
+        poolInfo.flags = vk::CommandPoolCreateFlagBits::eTransient;
+        poolInfo.queueFamilyIndex = queueFamilyIndex;
+        pools.resize(static_cast<size_t>(framesInFlight) * threadCount);
+        for (ThreadPool& pool : pools) {
+            vk::ResultValue<vk::CommandPool> poolR = device.createCommandPool(poolInfo);
+            if (poolR.result != vk::Result::eSuccess) {
+                vkInit::errprintDebug("failed to create frame command pool");
+                return std::unexpected(EmptyErr{});
+            }
+            pool.pool = poolR.value;
+        }
+        return EmptyOk{};
+    }
+
+    void CommandAllocator::destroy() noexcept {
+        //destroying a pool frees its buffers
+        for (ThreadPool& pool : pools)
+            if (pool.pool)
+                device.destroyCommandPool(pool.pool);
+        pools.clear();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> CommandAllocator::begin_frame(uint32_t frame) noexcept {
+        currentFrame = frame;
+        for (uint32_t thread = 0; thread < threadCount; thread++) {
+            ThreadPool& pool = pools[frame * threadCount + thread];
+            if (pool.primaries.used == 0 && pool.secondaries.used == 0)
+                continue;
+            if (device.resetCommandPool(pool.pool) != vk::Result::eSuccess) {
+                vkInit::errprintDebug("failed to reset frame command pool");
+                return std::unexpected(EmptyErr{});
+            }
+            pool.primaries.used = 0;
+            pool.secondaries.used = 0;
+            poolResets++;
+        }
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] std::expected<vk::CommandBuffer, EmptyErr> CommandAllocator::allocate(uint32_t thread, vk::CommandBufferLevel level) noexcept {
+        ThreadPool& pool = pools[currentFrame * threadCount + thread];
+        Buffers& buffers = level == vk::CommandBufferLevel::ePrimary ? pool.primaries : pool.secondaries;
+        if (buffers.used < buffers.buffers.size()) {
+            pool.recycled++;
+            return buffers.buffers[buffers.used++];
+        }
+
+        vk::CommandBufferAllocateInfo allocInfo = {};
+        allocInfo.commandPool = pool.pool;
+        allocInfo.level = level;
+        allocInfo.commandBufferCount = 1;
+        vk::ResultValue<std::vector<vk::CommandBuffer>> commandBufferR = device.allocateCommandBuffers(allocInfo);
+        if (commandBufferR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to allocate frame command buffer");
+            return std::unexpected(EmptyErr{});
+        }
+        pool.allocated++;
+        buffers.buffers.push_back(commandBufferR.value[0]);
+        buffers.used++;
+        return commandBufferR.value[0];
+    }
+
+    [[nodiscard]] uint32_t CommandAllocator::thread_count() const noexcept {
+        return threadCount;
+    }
+
+    [[nodiscard]] CommandAllocatorStats CommandAllocator::stats() const noexcept {
+        CommandAllocatorStats stats = {};
+        stats.poolResets = poolResets;
+        for (const ThreadPool& pool : pools) {
+            stats.buffersAllocated += pool.allocated;
+            stats.buffersRecycled += pool.recycled;
+        }
+        return stats;
+    }
+}
@@ -0,0 +1,77 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.commandAllocator;
+
+import <expected>;
+import <vector>;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    export struct CommandAllocatorStats {
+        uint32_t poolResets;
+        ///buffers that had to be allocated from the driver
+        uint32_t buffersAllocated;
+        ///buffers handed out again after their pool was reset
+        uint32_t buffersRecycled;
+    };
+
+    ///command buffers for work recorded every frame.
+    ///
+    ///there are thread_count transient pools per frame in flight, picked by index.
+    ///the pools are never reset buffer by buffer, begin_frame resets a frame's pools
+    ///whole once its timeline value completed and the buffers they handed out are given
+    ///out again in the same order, so after the first frames nothing is allocated.
+    ///
+    ///a pool is not bound to an os thread. allocate and begin_frame belong to the
+    ///render thread, buffers may then be recorded anywhere as long as no two
+    ///threads record buffers of one pool at the same time. ParallelRecorder keeps
+    ///that by giving chunk i of a pass pool i and recording every chunk in exactly
+    ///one job while the render thread, whose primary comes from pool 0, waits.
+    export class CommandAllocator {
+    public:
+        static constexpr uint32_t maxThreads = 8;
+
+        CommandAllocator();
+        ~CommandAllocator();
+        CommandAllocator(const CommandAllocator& ref) = delete;
+        CommandAllocator& operator=(const CommandAllocator& ref) = delete;
+
+        ///threads of 0 picks one per hardware thread, up to maxThreads
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make(vk::Device device, uint32_t queueFamilyIndex, uint32_t framesInFlight,
+            uint32_t threads = 0) noexcept;
+        void destroy() noexcept;
+
+        ///recycles everything handed out for frame, its previous submission must be complete
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> begin_frame(uint32_t frame) noexcept;
+        ///a buffer from pool thread of the current frame, valid until the frame comes around again
+        [[nodiscard]] std::expected<vk::CommandBuffer, EmptyErr> allocate(uint32_t thread, vk::CommandBufferLevel level) noexcept;
+        [[nodiscard]] uint32_t thread_count() const noexcept;
+
+        [[nodiscard]] CommandAllocatorStats stats() const noexcept;
+
+    private:
+        struct Buffers {
+            std::vector<vk::CommandBuffer> buffers;
+            uint32_t used;
+        };
+
+        struct ThreadPool {
+            vk::CommandPool pool;
+            Buffers primaries;
+            Buffers secondaries;
+            ///counted by allocate on the render thread
+            uint32_t allocated;
+            uint32_t recycled;
+        };
+
+        vk::Device device;
+        uint32_t threadCount;
+        uint32_t currentFrame;
+        ///frame major, threadCount pools per frame
+        std::vector<ThreadPool> pools;
+        uint32_t poolResets;
+    };
+}
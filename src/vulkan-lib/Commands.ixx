@@ -16,9 +16,11 @@ namespace vkInit {
         vk::CommandPool commandPool;
         std::vector<vkInit::SwapchainFrame>& frames;
     };
-    export [[nodiscard]] inline std::expected<vk::CommandPool, EmptyErr> make_command_pool(vk::Device device, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, uint32_t queueFamilyIndex){ 
+    ///flags defaults to buffers that are reset one by one, per frame work goes through vkl::CommandAllocator instead
+    export [[nodiscard]] inline std::expected<vk::CommandPool, EmptyErr> make_command_pool(vk::Device device, vk::PhysicalDevice physicalDevice, vk::SurfaceKHR surface, uint32_t queueFamilyIndex,
+        vk::CommandPoolCreateFlags flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer){ 
         vk::CommandPoolCreateInfo poolInfo = {};
-        poolInfo.flags = vk::CommandPoolCreateFlags() | vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        poolInfo.flags = flags;
         poolInfo.queueFamilyIndex = queueFamilyIndex;
 
         vk::ResultValue<vk::CommandPool> commandPoolR = device.createCommandPool(poolInfo);
@@ -38,17 +40,4 @@ namespace vkInit {
             return std::unexpected(EmptyErr{});
         return commandBufferR.value[0];
     }
-    export [[nodiscard]] inline auto make_frame_command_buffers(CommandBufferInputBundle inputBundle) -> std::expected<EmptyOk, EmptyErr> {
-        vk::CommandBufferAllocateInfo allocInfo = {};
-        allocInfo.commandPool = inputBundle.commandPool;
-        allocInfo.level = vk::CommandBufferLevel::ePrimary;
-        allocInfo.commandBufferCount = 1;
-        for (int i = 0; i < inputBundle.frames.size(); i++){
-            vk::ResultValue<std::vector<vk::CommandBuffer>> commandBufferR = inputBundle.device.allocateCommandBuffers(allocInfo);
-            if (commandBufferR.result != vk::Result::eSuccess)
-                return std::unexpected(EmptyErr{});
-            inputBundle.frames[i].commandbuffer = commandBufferR.value[0];
-        }
-        return EmptyOk{};
-    }
 }
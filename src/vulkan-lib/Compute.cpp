@@ -0,0 +1,170 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.compute;
+
+import <algorithm>;
+import vulkan_lib.descriptors;
+import vulkan_lib.logging;
+
+namespace vkl {
+
+    ComputeKernel::ComputeKernel() : dispatchLoader(nullptr), pushConstantSize(0), groupSize{ 1, 1, 1 },
+        dispatches(0), indirectDispatches(0), descriptorPushes(0) {
+    }
+
+    ComputeKernel::~ComputeKernel() {
+        destroy();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> ComputeKernel::make(const ComputeKernelInfo& info) noexcept {
+        destroy();
+        device = info.device;
+        dispatchLoader = info.dispatch;
+
+        auto reflection_res = vkInit::reflect_file(*info.shaderLibrary, info.filepath);
+        if (!reflection_res)
+            return std::unexpected(EmptyErr{});
+        const vkInit::ShaderReflection& reflection = reflection_res.value();
+        if (!(reflection.stages & vk::ShaderStageFlagBits::eCompute)) {
+            vkInit::errprintDebug("compute kernel made from a shader that is not a compute shader");
+            return std::unexpected(EmptyErr{});
+        }
+        //push descriptors hold one set of fixed size descriptors
+        for (const vkInit::ReflectedBinding& binding : reflection.bindings) {
+            if (binding.set != 0 || binding.count == 0) {
+                vkInit::errprintDebug("compute kernels only push set 0 and no runtime arrays");
+                return std::unexpected(EmptyErr{});
+            }
+        }
+        bindings = reflection.bindings;
+        pushConstantSize = reflection.pushConstantSize;
+
+        //the constants the pipeline is specialized with decide the size the shader runs with
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            groupSize[axis] = reflection.workgroupSize[axis];
+            auto constant = std::find_if(info.constants.constants.begin(), info.constants.constants.end(),
+                [&](const vkInit::SpecializationConstant& constant) { return constant.id == reflection.workgroupSizeIds[axis]; });
+            if (reflection.workgroupSizeIds[axis] != vkInit::noSpecialization && constant != info.constants.constants.end())
+                groupSize[axis] = constant->value;
+            groupSize[axis] = std::max(groupSize[axis], 1u);
+        }
+
+        vkInit::DescriptorSetLayoutData setData = reflection.set_layout(0);
+        setData.flags = vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR;
+        auto set_layout_res = info.layouts->get(setData);
+        if (!set_layout_res)
+            return std::unexpected(EmptyErr{});
+        setLayout = set_layout_res.value();
+
+        vkInit::ComputePipelineBundle specs = {};
+        specs.device = device;
+        specs.filepath = info.filepath;
+        specs.descriptorSetLayout = setLayout;
+        specs.pushConstantSize = pushConstantSize;
+        specs.constants = info.constants;
+        specs.pipelineCache = info.pipelineCache;
+        specs.shaderLibrary = info.shaderLibrary;
+        auto compute_pipeline_res = vkInit::make_compute_pipeline(specs);
+        if (!compute_pipeline_res)
+            return std::unexpected(EmptyErr{});
+        pipeline = compute_pipeline_res.value().pipeline;
+        layout = compute_pipeline_res.value().layout;
+        return EmptyOk{};
+    }
+
+    void ComputeKernel::destroy() noexcept {
+        if (pipeline)
+            device.destroyPipeline(pipeline);
+        if (layout)
+            device.destroyPipelineLayout(layout);
+        pipeline = nullptr;
+        layout = nullptr;
+        bindings.clear();
+    }
+
+    void ComputeKernel::bind(vk::CommandBuffer commandBuffer) const noexcept {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+    }
+
+    void ComputeKernel::push_buffer(vk::CommandBuffer commandBuffer, uint32_t binding, const vk::DescriptorBufferInfo& buffer) noexcept {
+        push_descriptor(commandBuffer, binding, &buffer, nullptr);
+    }
+
+    void ComputeKernel::push_image(vk::CommandBuffer commandBuffer, uint32_t binding, const vk::DescriptorImageInfo& image) noexcept {
+        push_descriptor(commandBuffer, binding, nullptr, &image);
+    }
+
+    void ComputeKernel::dispatch(vk::CommandBuffer commandBuffer, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ) noexcept {
+        commandBuffer.dispatch(groupsX, groupsY, groupsZ);
+        dispatches++;
+    }
+
+    void ComputeKernel::dispatch_threads(vk::CommandBuffer commandBuffer, uint32_t x, uint32_t y, uint32_t z) noexcept {
+        dispatch(commandBuffer, (x + groupSize[0] - 1) / groupSize[0], (y + groupSize[1] - 1) / groupSize[1],
+            (z + groupSize[2] - 1) / groupSize[2]);
+    }
+
+    void ComputeKernel::dispatch_indirect(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::DeviceSize offset) noexcept {
+        commandBuffer.dispatchIndirect(buffer, offset);
+        indirectDispatches++;
+    }
+
+    [[nodiscard]] std::array<uint32_t, 3> ComputeKernel::group_size() const noexcept {
+        return groupSize;
+    }
+
+    [[nodiscard]] vk::PipelineLayout ComputeKernel::pipeline_layout() const noexcept {
+        return layout;
+    }
+
+    [[nodiscard]] ComputeKernelStats ComputeKernel::stats() const noexcept {
+        ComputeKernelStats result = {};
+        result.dispatches = dispatches.load();
+        result.indirectDispatches = indirectDispatches.load();
+        result.descriptorPushes = descriptorPushes.load();
+        return result;
+    }
+
+    void ComputeKernel::push_constant_bytes(vk::CommandBuffer commandBuffer, const void* data, uint32_t size) const noexcept {
+        //the range covers what the shader reads, more would fail validation
+        if (size > pushConstantSize) {
+            vkInit::errprintDebug("pushed more constants than the compute shader declares");
+            size = pushConstantSize;
+        }
+        if (size > 0)
+            commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eCompute, 0, size, data);
+    }
+
+    void ComputeKernel::push_descriptor(vk::CommandBuffer commandBuffer, uint32_t binding, const vk::DescriptorBufferInfo* buffer,
+        const vk::DescriptorImageInfo* image) noexcept {
+        auto declared = std::find_if(bindings.begin(), bindings.end(),
+            [binding](const vkInit::ReflectedBinding& reflected) { return reflected.binding == binding; });
+        if (declared == bindings.end()) {
+            vkInit::errprintDebug("pushed a binding the compute shader does not declare");
+            return;
+        }
+        vk::WriteDescriptorSet write = {};
+        write.dstBinding = binding;
+        write.descriptorCount = 1;
+        write.descriptorType = declared->type;
+        write.pBufferInfo = buffer;
+        write.pImageInfo = image;
+        commandBuffer.pushDescriptorSetKHR(vk::PipelineBindPoint::eCompute, layout, 0, 1, &write, *dispatchLoader);
+        descriptorPushes++;
+    }
+
+    void record_compute_barrier(vk::CommandBuffer commandBuffer, vk::PipelineStageFlags2 dstStages,
+        vk::AccessFlags2 dstAccess) noexcept {
+        vk::MemoryBarrier2 barrier = {};
+        barrier.srcStageMask = vk::PipelineStageFlagBits2::eComputeShader;
+        barrier.srcAccessMask = vk::AccessFlagBits2::eShaderStorageWrite;
+        barrier.dstStageMask = dstStages;
+        barrier.dstAccessMask = dstAccess;
+        vk::DependencyInfo dependency = {};
+        dependency.memoryBarrierCount = 1;
+        dependency.pMemoryBarriers = &barrier;
+        commandBuffer.pipelineBarrier2(dependency);
+    }
+}
@@ -0,0 +1,106 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.compute;
+
+import <array>;
+import <atomic>;
+import <expected>;
+import <string>;
+import <vector>;
+import vulkan_lib.descriptorAllocator;
+import vulkan_lib.pipeline;
+import vulkan_lib.pipelineCache;
+import vulkan_lib.reflection;
+import vulkan_lib.result;
+import vulkan_lib.shaderLibrary;
+
+namespace vkl {
+
+    export struct ComputeKernelInfo {
+        vk::Device device;
+        std::string filepath;
+        vkInit::SpecializationMap constants;
+        ShaderLibrary* shaderLibrary;
+        PipelineCache* pipelineCache;
+        ///the set 0 layout is shared through it
+        DescriptorLayoutCache* layouts;
+        ///loads vkCmdPushDescriptorSetKHR
+        const vk::detail::DispatchLoaderDynamic* dispatch;
+    };
+
+    export struct ComputeKernelStats {
+        uint32_t dispatches;
+        uint32_t indirectDispatches;
+        uint32_t descriptorPushes;
+    };
+
+    ///one compute shader with everything needed to record it.
+    ///
+    ///make reflects the shader for its set 0 bindings, its push constant size and
+    ///its workgroup size, with the specialization constants of the info applied,
+    ///and compiles the pipeline through the pipeline cache. set 0 is a push
+    ///descriptor set, the resources of a dispatch are written into the command
+    ///buffer with push_buffer and push_image so a kernel needs no descriptor
+    ///sets of its own and runs on whichever queue records it.
+    ///
+    ///barriers between dispatches of different passes come from the render
+    ///graph's compute usages, record_compute_barrier serves dispatches recorded
+    ///outside it. recording is const apart from the counters, several threads
+    ///may record the same kernel.
+    export class ComputeKernel {
+    public:
+        ComputeKernel();
+        ~ComputeKernel();
+        ComputeKernel(const ComputeKernel& ref) = delete;
+        ComputeKernel& operator=(const ComputeKernel& ref) = delete;
+
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make(const ComputeKernelInfo& info) noexcept;
+        void destroy() noexcept;
+
+        void bind(vk::CommandBuffer commandBuffer) const noexcept;
+        ///writes binding of set 0 with the descriptor type the shader declares for it
+        void push_buffer(vk::CommandBuffer commandBuffer, uint32_t binding, const vk::DescriptorBufferInfo& buffer) noexcept;
+        void push_image(vk::CommandBuffer commandBuffer, uint32_t binding, const vk::DescriptorImageInfo& image) noexcept;
+        ///constants must be the shader's push constant block, padding included
+        template<typename Constants>
+        void push_constants(vk::CommandBuffer commandBuffer, const Constants& constants) const noexcept {
+            push_constant_bytes(commandBuffer, &constants, static_cast<uint32_t>(sizeof(Constants)));
+        }
+
+        void dispatch(vk::CommandBuffer commandBuffer, uint32_t groupsX, uint32_t groupsY = 1, uint32_t groupsZ = 1) noexcept;
+        ///enough groups to run at least x by y by z invocations, the shader skips the ones past its data
+        void dispatch_threads(vk::CommandBuffer commandBuffer, uint32_t x, uint32_t y = 1, uint32_t z = 1) noexcept;
+        ///reads a vk::DispatchIndirectCommand at offset, written by an earlier pass
+        void dispatch_indirect(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::DeviceSize offset) noexcept;
+
+        ///local size of the shader after specialization
+        [[nodiscard]] std::array<uint32_t, 3> group_size() const noexcept;
+        [[nodiscard]] vk::PipelineLayout pipeline_layout() const noexcept;
+        [[nodiscard]] ComputeKernelStats stats() const noexcept;
+
+    private:
+        void push_constant_bytes(vk::CommandBuffer commandBuffer, const void* data, uint32_t size) const noexcept;
+        void push_descriptor(vk::CommandBuffer commandBuffer, uint32_t binding, const vk::DescriptorBufferInfo* buffer,
+            const vk::DescriptorImageInfo* image) noexcept;
+
+        vk::Device device;
+        const vk::detail::DispatchLoaderDynamic* dispatchLoader;
+        ///owned by the layout cache
+        vk::DescriptorSetLayout setLayout;
+        vk::PipelineLayout layout;
+        vk::Pipeline pipeline;
+        ///set 0 as the shader declares it, sorted by binding
+        std::vector<vkInit::ReflectedBinding> bindings;
+        uint32_t pushConstantSize;
+        std::array<uint32_t, 3> groupSize;
+        std::atomic<uint32_t> dispatches;
+        std::atomic<uint32_t> indirectDispatches;
+        std::atomic<uint32_t> descriptorPushes;
+    };
+
+    ///makes compute shader writes visible to dstStages, for dispatches recorded outside the render graph
+    export void record_compute_barrier(vk::CommandBuffer commandBuffer, vk::PipelineStageFlags2 dstStages,
+        vk::AccessFlags2 dstAccess) noexcept;
+}
@@ -0,0 +1,147 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.depthPyramid;
+
+import <algorithm>;
+import <bit>;
+import vulkan_lib.logging;
+
+namespace vkl {
+
+    constexpr uint32_t groupSize = 16;
+    ///constant_ids of local_size_x and local_size_y in depth_reduce.comp
+    constexpr uint32_t groupSizeXConstant = 0;
+    constexpr uint32_t groupSizeYConstant = 1;
+
+    DepthPyramid::DepthPyramid() : initialized(false) {
+    }
+
+    DepthPyramid::~DepthPyramid() {
+        destroy_resources();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> DepthPyramid::make_pipeline(vk::Device device, DescriptorLayoutCache& layouts,
+        PipelineCache& pipelineCache, ShaderLibrary& shaders, const vk::detail::DispatchLoaderDynamic& dispatch) noexcept {
+        this->device = device;
+        ComputeKernelInfo info = {};
+        info.device = device;
+        info.filepath = "depth_reduce.spv";
+        info.constants.set(groupSizeXConstant, groupSize);
+        info.constants.set(groupSizeYConstant, groupSize);
+        info.shaderLibrary = &shaders;
+        info.pipelineCache = &pipelineCache;
+        info.layouts = &layouts;
+        info.dispatch = &dispatch;
+        if (!reduce.make(info))
+            return std::unexpected(EmptyErr{});
+
+        vk::SamplerCreateInfo samplerInfo = {};
+        samplerInfo.flags = vk::SamplerCreateFlags();
+        samplerInfo.magFilter = vk::Filter::eNearest;
+        samplerInfo.minFilter = vk::Filter::eNearest;
+        samplerInfo.mipmapMode = vk::SamplerMipmapMode::eNearest;
+        samplerInfo.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+        samplerInfo.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+        samplerInfo.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        vk::ResultValue<vk::Sampler> samplerR = device.createSampler(samplerInfo);
+        if (samplerR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to create depth pyramid sampler");
+            return std::unexpected(EmptyErr{});
+        }
+        sampler = samplerR.value;
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> DepthPyramid::make_resources(vk::PhysicalDevice physicalDevice,
+        vk::ImageView depthView, vk::Extent2D depthExtent) noexcept {
+        this->depthView = depthView;
+        this->depthExtent = depthExtent;
+        vkUtil::ImageInput input = {};
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.extent.width = std::bit_floor(depthExtent.width);
+        input.extent.height = std::bit_floor(depthExtent.height);
+        input.mipLevels = static_cast<uint32_t>(std::bit_width(std::max(input.extent.width, input.extent.height)));
+        input.format = vk::Format::eR32Sfloat;
+        input.usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled;
+        input.aspect = vk::ImageAspectFlagBits::eColor;
+        auto image_res = vkUtil::make_image(input);
+        if (!image_res)
+            return std::unexpected(EmptyErr{});
+        image = image_res.value();
+        initialized = false;
+
+        for (uint32_t level = 0; level < image.mipLevels; level++) {
+            auto view_res = vkUtil::make_image_view(device, image.image, image.format, vk::ImageAspectFlagBits::eColor, level, 1);
+            if (!view_res)
+                return std::unexpected(EmptyErr{});
+            mipViews.push_back(view_res.value());
+        }
+        return EmptyOk{};
+    }
+
+    void DepthPyramid::destroy_resources() noexcept {
+        for (vk::ImageView view : mipViews)
+            device.destroyImageView(view);
+        mipViews.clear();
+        if (image.image)
+            vkUtil::destroy_image(device, image);
+    }
+
+    void DepthPyramid::record_build(vk::CommandBuffer commandBuffer) noexcept {
+        vk::ImageMemoryBarrier toGeneral = {};
+        toGeneral.oldLayout = initialized ? vk::ImageLayout::eGeneral : vk::ImageLayout::eUndefined;
+        toGeneral.newLayout = vk::ImageLayout::eGeneral;
+        toGeneral.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+        toGeneral.dstAccessMask = vk::AccessFlagBits::eShaderWrite;
+        toGeneral.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toGeneral.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toGeneral.image = image.image;
+        toGeneral.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        toGeneral.subresourceRange.baseMipLevel = 0;
+        toGeneral.subresourceRange.levelCount = image.mipLevels;
+        toGeneral.subresourceRange.baseArrayLayer = 0;
+        toGeneral.subresourceRange.layerCount = 1;
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), nullptr, nullptr, toGeneral);
+        initialized = true;
+
+        reduce.bind(commandBuffer);
+        for (uint32_t level = 0; level < image.mipLevels; level++) {
+            uint32_t width = std::max(1u, image.extent.width >> level);
+            uint32_t height = std::max(1u, image.extent.height >> level);
+            PushConstants constants = {};
+            constants.sourceWidth = static_cast<float>(level == 0 ? depthExtent.width : std::max(1u, image.extent.width >> (level - 1)));
+            constants.sourceHeight = static_cast<float>(level == 0 ? depthExtent.height : std::max(1u, image.extent.height >> (level - 1)));
+            constants.destinationWidth = static_cast<float>(width);
+            constants.destinationHeight = static_cast<float>(height);
+
+            //level 0 samples the depth buffer, every other level the one before it
+            vk::DescriptorImageInfo sourceInfo = {};
+            sourceInfo.sampler = sampler;
+            sourceInfo.imageView = level == 0 ? depthView : mipViews[level - 1];
+            sourceInfo.imageLayout = level == 0 ? vk::ImageLayout::eShaderReadOnlyOptimal : vk::ImageLayout::eGeneral;
+            vk::DescriptorImageInfo destinationInfo = {};
+            destinationInfo.imageView = mipViews[level];
+            destinationInfo.imageLayout = vk::ImageLayout::eGeneral;
+
+            reduce.push_image(commandBuffer, 0, sourceInfo);
+            reduce.push_image(commandBuffer, 1, destinationInfo);
+            reduce.push_constants(commandBuffer, constants);
+            reduce.dispatch_threads(commandBuffer, width, height);
+
+            vk::ImageMemoryBarrier levelDone = toGeneral;
+            levelDone.oldLayout = vk::ImageLayout::eGeneral;
+            levelDone.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+            levelDone.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+            levelDone.subresourceRange.baseMipLevel = level;
+            levelDone.subresourceRange.levelCount = 1;
+            commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader,
+                vk::DependencyFlags(), nullptr, nullptr, levelDone);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.depthPyramid;
+
+import <expected>;
+import <vector>;
+import vulkan_lib.compute;
+import vulkan_lib.image;
+import vulkan_lib.result;
+import vulkan_lib.descriptorAllocator;
+import vulkan_lib.pipelineCache;
+import vulkan_lib.shaderLibrary;
+
+namespace vkl {
+
+    ///max reduced mip chain of the scene depth. level 0 is the depth buffer
+    ///downsampled to the previous power of two, every following level keeps the
+    ///farthest depth of the texels it covers, so a box whose nearest depth is
+    ///behind the pyramid value is fully occluded.
+    export class DepthPyramid {
+    public:
+        DepthPyramid();
+        ~DepthPyramid();
+        DepthPyramid(const DepthPyramid& ref) = delete;
+        DepthPyramid& operator=(const DepthPyramid& ref) = delete;
+
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_pipeline(vk::Device device, DescriptorLayoutCache& layouts, PipelineCache& pipelineCache,
+            ShaderLibrary& shaders, const vk::detail::DispatchLoaderDynamic& dispatch) noexcept;
+        ///size dependent resources, rebuilt with the swapchain
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_resources(vk::PhysicalDevice physicalDevice, vk::ImageView depthView,
+            vk::Extent2D depthExtent) noexcept;
+        void destroy_resources() noexcept;
+        ///expects the depth buffer in eShaderReadOnlyOptimal, leaves every level
+        ///in eGeneral and visible to compute shader reads
+        void record_build(vk::CommandBuffer commandBuffer) noexcept;
+
+        vkUtil::AllocatedImage image;
+        vk::Sampler sampler;
+    private:
+        struct PushConstants {
+            float sourceWidth, sourceHeight;
+            float destinationWidth, destinationHeight;
+        };
+
+        vk::Device device;
+        ///reduces one level into the next, its images are pushed per level
+        ComputeKernel reduce;
+
+        std::vector<vk::ImageView> mipViews;
+        vk::ImageView depthView;
+        vk::Extent2D depthExtent;
+        bool initialized;
+    };
+}
@@ -0,0 +1,189 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.descriptorAllocator;
+
+import <algorithm>;
+import <cmath>;
+import vulkan_lib.hash;
+import vulkan_lib.logging;
+
+namespace vkl {
+
+    DescriptorLayoutCache::DescriptorLayoutCache() : statistics{} {
+    }
+
+    DescriptorLayoutCache::~DescriptorLayoutCache() {
+        destroy();
+    }
+
+    void DescriptorLayoutCache::make(vk::Device device) noexcept {
+        destroy();
+        this->device = device;
+        statistics = {};
+    }
+
+    void DescriptorLayoutCache::destroy() noexcept {
+        for (auto& [hash, entries] : layouts)
+            for (Entry& entry : entries)
+                device.destroyDescriptorSetLayout(entry.layout);
+        layouts.clear();
+    }
+
+    [[nodiscard]] std::expected<vk::DescriptorSetLayout, EmptyErr> DescriptorLayoutCache::get(const vkInit::DescriptorSetLayoutData& bindings) noexcept {
+        std::vector<vk::DescriptorSetLayoutBinding> key;
+        key.reserve(bindings.count);
+        for (int i = 0; i < bindings.count; i++)
+            key.emplace_back(bindings.indices[i], bindings.types[i], bindings.counts[i], bindings.stages[i]);
+        std::sort(key.begin(), key.end(), [](const auto& a, const auto& b) { return a.binding < b.binding; });
+
+        uint64_t hash = hash_combine(key.size(), static_cast<uint64_t>(static_cast<VkDescriptorSetLayoutCreateFlags>(bindings.flags)));
+        for (const vk::DescriptorSetLayoutBinding& binding : key) {
+            hash = hash_combine(hash, binding.binding);
+            hash = hash_combine(hash, static_cast<uint64_t>(binding.descriptorType));
+            hash = hash_combine(hash, binding.descriptorCount);
+            hash = hash_combine(hash, static_cast<uint64_t>(static_cast<VkShaderStageFlags>(binding.stageFlags)));
+        }
+        std::vector<Entry>& entries = layouts[hash];
+        for (const Entry& entry : entries) {
+            if (entry.flags == bindings.flags && entry.bindings == key) {
+                statistics.reused++;
+                return entry.layout;
+            }
+        }
+
+        auto layout_res = vkInit::make_descriptor_set_layout(device, bindings);
+        if (!layout_res)
+            return std::unexpected(EmptyErr{});
+        entries.push_back({ bindings.flags, std::move(key), layout_res.value() });
+        statistics.created++;
+        return layout_res.value();
+    }
+
+    [[nodiscard]] DescriptorLayoutStats DescriptorLayoutCache::stats() const noexcept {
+        return statistics;
+    }
+
+    DescriptorAllocator::DescriptorAllocator() : setsPerPool(0), currentFrame(0), statistics{} {
+    }
+
+    DescriptorAllocator::~DescriptorAllocator() {
+        destroy();
+    }
+
+    void DescriptorAllocator::make(vk::Device device, std::span<const DescriptorRatio> ratios, uint32_t setsPerPool) noexcept {
+        destroy();
+        this->device = device;
+        this->ratios.assign(ratios.begin(), ratios.end());
+        this->setsPerPool = std::clamp(setsPerPool, 1u, maxSetsPerPool);
+        currentFrame = 0;
+        statistics = {};
+    }
+
+    void DescriptorAllocator::destroy() noexcept {
+        //destroying a pool frees its sets
+        for (vk::DescriptorPool pool : persistent.pools)
+            device.destroyDescriptorPool(pool);
+        persistent.pools.clear();
+        for (Chain& chain : frames)
+            for (vk::DescriptorPool pool : chain.pools)
+                device.destroyDescriptorPool(pool);
+        frames.clear();
+        for (vk::DescriptorPool pool : freePools)
+            device.destroyDescriptorPool(pool);
+        freePools.clear();
+    }
+
+    [[nodiscard]] std::expected<vk::DescriptorSet, EmptyErr> DescriptorAllocator::allocate(vk::DescriptorSetLayout layout) noexcept {
+        return allocate(persistent, layout);
+    }
+
+    [[nodiscard]] std::expected<vk::DescriptorSet, EmptyErr> DescriptorAllocator::allocate_transient(vk::DescriptorSetLayout layout) noexcept {
+        if (currentFrame >= frames.size())
+            frames.resize(currentFrame + 1);
+        return allocate(frames[currentFrame], layout);
+    }
+
+    void DescriptorAllocator::reset() noexcept {
+        reset(persistent);
+    }
+
+    void DescriptorAllocator::begin_frame(uint32_t frame) noexcept {
+        currentFrame = frame;
+        if (frame >= frames.size())
+            frames.resize(frame + 1);
+        reset(frames[frame]);
+    }
+
+    [[nodiscard]] DescriptorAllocatorStats DescriptorAllocator::stats() const noexcept {
+        return statistics;
+    }
+
+    [[nodiscard]] std::expected<vk::DescriptorSet, EmptyErr> DescriptorAllocator::allocate(Chain& chain, vk::DescriptorSetLayout layout) noexcept {
+        if (chain.pools.empty()) {
+            auto pool_res = next_pool();
+            if (!pool_res)
+                return std::unexpected(EmptyErr{});
+            chain.pools.push_back(pool_res.value());
+        }
+
+        vk::DescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        //a full pool is only retried once, a fresh pool failing means the device is out of memory
+        for (int attempt = 0; attempt < 2; attempt++) {
+            allocInfo.descriptorPool = chain.pools.back();
+            vk::DescriptorSet set;
+            vk::Result result = device.allocateDescriptorSets(&allocInfo, &set);
+            if (result == vk::Result::eSuccess) {
+                statistics.setsAllocated++;
+                return set;
+            }
+            if (result != vk::Result::eErrorOutOfPoolMemory && result != vk::Result::eErrorFragmentedPool)
+                break;
+            statistics.poolsExhausted++;
+            auto pool_res = next_pool();
+            if (!pool_res)
+                return std::unexpected(EmptyErr{});
+            chain.pools.push_back(pool_res.value());
+        }
+        vkInit::errprintDebug("failed to allocate descriptor set");
+        return std::unexpected(EmptyErr{});
+    }
+
+    [[nodiscard]] std::expected<vk::DescriptorPool, EmptyErr> DescriptorAllocator::next_pool() noexcept {
+        if (!freePools.empty()) {
+            vk::DescriptorPool pool = freePools.back();
+            freePools.pop_back();
+            statistics.poolsRecycled++;
+            return pool;
+        }
+
+        std::vector<vk::DescriptorPoolSize> poolSizes;
+        for (const DescriptorRatio& ratio : ratios)
+            poolSizes.emplace_back(ratio.type, std::max(1u, static_cast<uint32_t>(std::ceil(ratio.perSet * setsPerPool))));
+        vk::DescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.flags = vk::DescriptorPoolCreateFlags();
+        poolInfo.maxSets = setsPerPool;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        vk::ResultValue<vk::DescriptorPool> poolR = device.createDescriptorPool(poolInfo);
+        if (poolR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to create descriptor pool");
+            return std::unexpected(EmptyErr{});
+        }
+        statistics.poolsCreated++;
+        setsPerPool = std::min(setsPerPool * 2, maxSetsPerPool);
+        return poolR.value;
+    }
+
+    void DescriptorAllocator::reset(Chain& chain) noexcept {
+        for (vk::DescriptorPool pool : chain.pools) {
+            device.resetDescriptorPool(pool);
+            freePools.push_back(pool);
+            statistics.poolResets++;
+        }
+        chain.pools.clear();
+    }
+}
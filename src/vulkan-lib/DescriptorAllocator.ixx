@@ -0,0 +1,124 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.descriptorAllocator;
+
+import <expected>;
+import <span>;
+import <unordered_map>;
+import <vector>;
+import vulkan_lib.descriptors;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    export struct DescriptorLayoutStats {
+        uint32_t created;
+        ///requests answered with a layout made before
+        uint32_t reused;
+    };
+
+    ///one layout per distinct set of bindings.
+    ///
+    ///layouts are looked up by a hash of their bindings sorted by index, so
+    ///modules asking for the same bindings share the layout. the cache owns
+    ///every layout it hands out, they live until destroy.
+    export class DescriptorLayoutCache {
+    public:
+        DescriptorLayoutCache();
+        ~DescriptorLayoutCache();
+        DescriptorLayoutCache(const DescriptorLayoutCache& ref) = delete;
+        DescriptorLayoutCache& operator=(const DescriptorLayoutCache& ref) = delete;
+
+        void make(vk::Device device) noexcept;
+        void destroy() noexcept;
+
+        [[nodiscard]] std::expected<vk::DescriptorSetLayout, EmptyErr> get(const vkInit::DescriptorSetLayoutData& bindings) noexcept;
+        [[nodiscard]] DescriptorLayoutStats stats() const noexcept;
+
+    private:
+        struct Entry {
+            vk::DescriptorSetLayoutCreateFlags flags;
+            std::vector<vk::DescriptorSetLayoutBinding> bindings;
+            vk::DescriptorSetLayout layout;
+        };
+
+        vk::Device device;
+        ///by hash of the flags and sorted bindings, equal hashes are told apart by comparing them
+        std::unordered_map<uint64_t, std::vector<Entry>> layouts;
+        DescriptorLayoutStats statistics;
+    };
+
+    ///descriptors of one type a pool holds per set it is sized for
+    export struct DescriptorRatio {
+        vk::DescriptorType type;
+        float perSet;
+    };
+
+    export struct DescriptorAllocatorStats {
+        uint32_t poolsCreated;
+        ///pools handed out again after a reset instead of being created
+        uint32_t poolsRecycled;
+        uint32_t poolResets;
+        uint64_t setsAllocated;
+        ///allocations that found their pool full and moved on to another one
+        uint32_t poolsExhausted;
+    };
+
+    ///descriptor sets from chains of pools that grow on demand.
+    ///
+    ///allocate takes from the current pool and moves on to the next one when
+    ///the driver reports it out of memory or fragmented, so allocating only
+    ///fails when the device itself is out of memory. every new pool is twice
+    ///the size of the last up to maxSetsPerPool. reset returns pools to a free
+    ///list whole, the next chains take them from there before creating any.
+    ///
+    ///long lived sets go in the persistent chain and stay until reset, sets
+    ///used by one frame go in the chain of their frame in flight, which
+    ///begin_frame resets once that frame's previous submission completed.
+    export class DescriptorAllocator {
+    public:
+        static constexpr uint32_t maxSetsPerPool = 4096;
+
+        DescriptorAllocator();
+        ~DescriptorAllocator();
+        DescriptorAllocator(const DescriptorAllocator& ref) = delete;
+        DescriptorAllocator& operator=(const DescriptorAllocator& ref) = delete;
+
+        void make(vk::Device device, std::span<const DescriptorRatio> ratios, uint32_t setsPerPool = 64) noexcept;
+        void destroy() noexcept;
+
+        ///a set that lives until reset
+        [[nodiscard]] std::expected<vk::DescriptorSet, EmptyErr> allocate(vk::DescriptorSetLayout layout) noexcept;
+        ///a set valid until the current frame comes around again
+        [[nodiscard]] std::expected<vk::DescriptorSet, EmptyErr> allocate_transient(vk::DescriptorSetLayout layout) noexcept;
+
+        ///frees every persistent set, the gpu must be done with them
+        void reset() noexcept;
+        ///frees the transient sets of frame, its previous submission must be complete.
+        ///frames are indexed like frameNumber and added as they first show up
+        void begin_frame(uint32_t frame) noexcept;
+
+        [[nodiscard]] DescriptorAllocatorStats stats() const noexcept;
+
+    private:
+        struct Chain {
+            ///pools filled up or handed out since the last reset, the last one is current
+            std::vector<vk::DescriptorPool> pools;
+        };
+
+        [[nodiscard]] std::expected<vk::DescriptorSet, EmptyErr> allocate(Chain& chain, vk::DescriptorSetLayout layout) noexcept;
+        [[nodiscard]] std::expected<vk::DescriptorPool, EmptyErr> next_pool() noexcept;
+        void reset(Chain& chain) noexcept;
+
+        vk::Device device;
+        std::vector<DescriptorRatio> ratios;
+        uint32_t setsPerPool;
+        Chain persistent;
+        std::vector<Chain> frames;
+        uint32_t currentFrame;
+        std::vector<vk::DescriptorPool> freePools;
+        DescriptorAllocatorStats statistics;
+    };
+}
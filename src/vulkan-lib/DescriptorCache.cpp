@@ -0,0 +1,105 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.descriptorCache;
+
+import vulkan_lib.hash;
+
+namespace vkl {
+
+    size_t DescriptorWriteCache::BindingHash::operator()(const Binding& key) const noexcept {
+        return static_cast<size_t>(hash_combine(handle_bits(key.set), key.binding));
+    }
+
+    DescriptorWriteCache::DescriptorWriteCache() : statistics{} {
+    }
+
+    void DescriptorWriteCache::make(vk::Device device) noexcept {
+        this->device = device;
+        clear();
+        statistics = {};
+    }
+
+    void DescriptorWriteCache::write_buffer(vk::DescriptorSet set, uint32_t binding, vk::DescriptorType type,
+        const vk::DescriptorBufferInfo& info) {
+        uint64_t hash = hash_combine(static_cast<uint64_t>(type), handle_bits(info.buffer));
+        hash = hash_combine(hash, info.offset);
+        hash = hash_combine(hash, info.range);
+        const Binding key = { set, binding };
+        if (!changed(key, hash))
+            return;
+        pending.push_back({ key, type, static_cast<uint32_t>(bufferInfos.size()), false });
+        bufferInfos.push_back(info);
+    }
+
+    void DescriptorWriteCache::write_image(vk::DescriptorSet set, uint32_t binding, vk::DescriptorType type,
+        const vk::DescriptorImageInfo& info) {
+        uint64_t hash = hash_combine(static_cast<uint64_t>(type), handle_bits(info.sampler));
+        hash = hash_combine(hash, handle_bits(info.imageView));
+        hash = hash_combine(hash, static_cast<uint64_t>(info.imageLayout));
+        const Binding key = { set, binding };
+        if (!changed(key, hash))
+            return;
+        pending.push_back({ key, type, static_cast<uint32_t>(imageInfos.size()), true });
+        imageInfos.push_back(info);
+    }
+
+    uint32_t DescriptorWriteCache::flush() noexcept {
+        if (pending.empty())
+            return 0;
+        //infos only stop moving once everything is queued
+        writes.clear();
+        for (const Pending& entry : pending) {
+            vk::WriteDescriptorSet write = {};
+            write.dstSet = entry.key.set;
+            write.dstBinding = entry.key.binding;
+            write.descriptorCount = 1;
+            write.descriptorType = entry.type;
+            if (entry.image)
+                write.pImageInfo = &imageInfos[entry.info];
+            else
+                write.pBufferInfo = &bufferInfos[entry.info];
+            writes.push_back(write);
+        }
+        device.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+        const uint32_t written = static_cast<uint32_t>(writes.size());
+        statistics.frameUpdates += written;
+        statistics.totalUpdates += written;
+        pending.clear();
+        bufferInfos.clear();
+        imageInfos.clear();
+        return written;
+    }
+
+    void DescriptorWriteCache::forget(vk::DescriptorSet set) noexcept {
+        std::erase_if(contents, [set](const auto& entry) { return entry.first.set == set; });
+        std::erase_if(pending, [set](const Pending& entry) { return entry.key.set == set; });
+    }
+
+    void DescriptorWriteCache::clear() noexcept {
+        contents.clear();
+        pending.clear();
+        bufferInfos.clear();
+        imageInfos.clear();
+    }
+
+    void DescriptorWriteCache::begin_frame() noexcept {
+        statistics.frameUpdates = 0;
+    }
+
+    [[nodiscard]] DescriptorCacheStats DescriptorWriteCache::stats() const noexcept {
+        return statistics;
+    }
+
+    [[nodiscard]] bool DescriptorWriteCache::changed(const Binding& key, uint64_t hash) {
+        auto [entry, inserted] = contents.try_emplace(key, hash);
+        if (!inserted && entry->second == hash) {
+            statistics.skipped++;
+            return false;
+        }
+        entry->second = hash;
+        return true;
+    }
+}
@@ -0,0 +1,77 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.descriptorCache;
+
+import <unordered_map>;
+import <vector>;
+
+namespace vkl {
+
+    export struct DescriptorCacheStats {
+        ///descriptors written since the last begin_frame
+        uint32_t frameUpdates;
+        uint64_t totalUpdates;
+        ///writes dropped because the set already held the same resource
+        uint64_t skipped;
+    };
+
+    ///writes descriptor sets only when what they point at changed.
+    ///
+    ///the contents of every binding written through it are kept as a hash, a
+    ///write that hashes the same as what the set holds is dropped, so sets are
+    ///written once when they are made and again only when a buffer they read is
+    ///replaced. writes are queued and issued together by flush.
+    export class DescriptorWriteCache {
+    public:
+        DescriptorWriteCache();
+
+        void make(vk::Device device) noexcept;
+
+        void write_buffer(vk::DescriptorSet set, uint32_t binding, vk::DescriptorType type, const vk::DescriptorBufferInfo& info);
+        void write_image(vk::DescriptorSet set, uint32_t binding, vk::DescriptorType type, const vk::DescriptorImageInfo& info);
+        ///issues the queued writes in one update, returns how many there were
+        uint32_t flush() noexcept;
+
+        ///the set was freed, a new set may come back with its handle
+        void forget(vk::DescriptorSet set) noexcept;
+        ///forgets every set, for when their pools are destroyed
+        void clear() noexcept;
+
+        ///starts counting the next frame's updates
+        void begin_frame() noexcept;
+        [[nodiscard]] DescriptorCacheStats stats() const noexcept;
+
+    private:
+        struct Binding {
+            vk::DescriptorSet set;
+            uint32_t binding;
+
+            bool operator==(const Binding& other) const noexcept = default;
+        };
+
+        struct BindingHash {
+            size_t operator()(const Binding& key) const noexcept;
+        };
+
+        struct Pending {
+            Binding key;
+            vk::DescriptorType type;
+            ///into bufferInfos or imageInfos
+            uint32_t info;
+            bool image;
+        };
+
+        ///true when contents differs from what key holds, which it holds from now on
+        [[nodiscard]] bool changed(const Binding& key, uint64_t contents);
+
+        vk::Device device;
+        std::unordered_map<Binding, uint64_t, BindingHash> contents;
+        std::vector<Pending> pending;
+        std::vector<vk::DescriptorBufferInfo> bufferInfos;
+        std::vector<vk::DescriptorImageInfo> imageInfos;
+        std::vector<vk::WriteDescriptorSet> writes;
+        DescriptorCacheStats statistics;
+    };
+}
@@ -16,6 +16,8 @@ namespace vkInit{
         std::vector<vk::DescriptorType> types;
         std::vector<int>counts;
         std::vector<vk::ShaderStageFlags> stages;
+        ///ePushDescriptorKHR for sets written into the command buffer instead of allocated
+        vk::DescriptorSetLayoutCreateFlags flags = {};
     };
 
     export [[nodiscard]] inline auto
@@ -32,7 +34,7 @@ namespace vkInit{
             layoutBindings.push_back(layoutBinding);
         }
         vk::DescriptorSetLayoutCreateInfo createInfo = {};
-        createInfo.flags = vk::DescriptorSetLayoutCreateFlagBits();
+        createInfo.flags = bindings.flags;
         createInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
         createInfo.pBindings = layoutBindings.data();
 
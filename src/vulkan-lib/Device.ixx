@@ -4,6 +4,7 @@ module;
 
 export module vulkan_lib.device;
 
+import <algorithm>;
 import <expected>;
 import <iostream>;
 import vulkan_lib.logging;
@@ -40,14 +41,40 @@ namespace vkInit{
     }
 
 
+    ///true when physical_device supports every extension in extensions
+    export [[nodiscard]] inline auto
+    device_extensions_supported(vk::PhysicalDevice physical_device, const std::vector<const char*>& extensions) noexcept -> bool {
+        vk::ResultValue<std::vector<vk::ExtensionProperties>> supportedExtensionsV = physical_device.enumerateDeviceExtensionProperties();
+        if (supportedExtensionsV.result != vk::Result::eSuccess)
+            return false;
+        for (const char* extension : extensions){
+            bool found = false;
+            for (const vk::ExtensionProperties& supportedExtension : supportedExtensionsV.value)
+                if (strcmp(extension, supportedExtension.extensionName) == 0)
+                    found = true;
+            if (!found){
+                if constexpr (_DEBUG)
+                    std::cerr << "\tDevice extension \"" << extension << "\" is not supported\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
     export [[nodiscard]] inline auto
     create_device(vk::PhysicalDevice physical_device, vk::SurfaceKHR surface) noexcept -> std::expected<vk::Device, EmptyErr> {
         vkUtil::QueueFamilyIndices indices = vkUtil::find_queue_families(physical_device, surface);
+        if (!indices.is_complete()){
+            if constexpr (_DEBUG)
+                std::cerr << "no queue family for graphics, present, compute or transfer.\n";
+            return std::unexpected(EmptyErr{});
+        }
+        //one queue per family, roles that share a family share its queue
         std::vector<uint32_t> unique_indices;
-        unique_indices.push_back(indices.presentFamily.value());
-        if (indices.presentFamily.value() != indices.graphicsFamily.value())
-            unique_indices.push_back(indices.graphicsFamily.value());
-        unique_indices.push_back(indices.transferFamily.value());
+        for (uint32_t family : { indices.graphicsFamily.value(), indices.presentFamily.value(),
+            indices.computeFamily.value(), indices.transferFamily.value() })
+            if (std::find(unique_indices.begin(), unique_indices.end(), family) == unique_indices.end())
+                unique_indices.push_back(family);
         float queuePriority = 1.f;
         std::vector<vk::DeviceQueueCreateInfo> queueCreateInfo;
         for (uint32_t queueFamilyIndex : unique_indices){
@@ -57,13 +84,35 @@ namespace vkInit{
             );
         }
         std::vector<const char *>deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+        //per draw buffers are pushed instead of allocated and bound as sets
+        VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME
         };
+        if (!device_extensions_supported(physical_device, deviceExtensions))
+            return std::unexpected(EmptyErr{});
 
         vk::PhysicalDeviceFeatures features;
 
         features.samplerAnisotropy = true;
 
+        //the render graph records its barriers with synchronization2
+        vk::PhysicalDeviceVulkan13Features features13 = {};
+        features13.synchronization2 = true;
+        //the scene is drawn into the attachments directly, no render pass or framebuffer objects
+        features13.dynamicRendering = true;
+        //every queue's work is tracked by one timeline semaphore
+        vk::PhysicalDeviceVulkan12Features features12 = {};
+        features12.timelineSemaphore = true;
+        //the bindless set, indexed per material and written while in use
+        features12.descriptorIndexing = true;
+        features12.runtimeDescriptorArray = true;
+        features12.shaderSampledImageArrayNonUniformIndexing = true;
+        features12.descriptorBindingPartiallyBound = true;
+        features12.descriptorBindingVariableDescriptorCount = true;
+        features12.descriptorBindingSampledImageUpdateAfterBind = true;
+        features12.descriptorBindingStorageBufferUpdateAfterBind = true;
+        features13.pNext = &features12;
+
         std::vector<const char*>layers;
         if (_DEBUG)
             layers.push_back("VK_LAYER_KHRONOS_validation");
@@ -75,6 +124,7 @@ namespace vkInit{
             static_cast<uint32_t>(deviceExtensions.size()),deviceExtensions.data(),
             &features
             );
+        createInfo.pNext = &features13;
         vk::ResultValue<vk::Device> deviceV = physical_device.createDevice(createInfo);
         if (deviceV.result != vk::Result::eSuccess){
             if constexpr (_DEBUG)
@@ -84,7 +134,7 @@ namespace vkInit{
         return deviceV.value;
     }
 
-    ///gets [graphics queue,present queue] from device, 
+    ///gets the [graphics, present, compute, transfer] families the device was created with
     export [[nodiscard]] inline auto
     get_queue(vk::PhysicalDevice physical_device, vk::Device device, vk::SurfaceKHR surface) noexcept -> vkUtil::QueueFamilyIndices{
         return  vkUtil::find_queue_families(physical_device, surface);
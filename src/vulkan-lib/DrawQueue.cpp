@@ -0,0 +1,211 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.drawQueue;
+
+import <algorithm>;
+import <cstring>;
+
+namespace vkl {
+
+    constexpr uint32_t radixBits = 8;
+    constexpr uint32_t radixBuckets = 1 << radixBits;
+    //below this many draws per chunk the sort stays on one thread
+    constexpr uint32_t chunkEntries = 2048;
+    constexpr uint32_t maxChunks = 16;
+
+    constexpr uint32_t depthShift = 0;
+    constexpr uint32_t meshShift = depthShift + DrawQueue::depthBits;
+    constexpr uint32_t materialShift = meshShift + DrawQueue::meshBits;
+    constexpr uint32_t pipelineShift = materialShift + DrawQueue::materialBits;
+    constexpr uint32_t passShift = pipelineShift + DrawQueue::pipelineBits;
+    static_assert(passShift + DrawQueue::passBits == 64);
+
+    constexpr uint32_t field(uint64_t key, uint32_t shift, uint32_t bits) {
+        return static_cast<uint32_t>((key >> shift) & ((uint64_t(1) << bits) - 1));
+    }
+
+    DrawQueue::DrawQueue() {
+        clear();
+    }
+
+    [[nodiscard]] uint64_t DrawQueue::make_key(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) noexcept {
+        const uint32_t maxDepth = (1u << depthBits) - 1;
+        uint64_t depthBucket = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * maxDepth);
+        return (uint64_t(pass) << passShift)
+            | (uint64_t(pipeline & ((1u << pipelineBits) - 1)) << pipelineShift)
+            | (uint64_t(material & ((1u << materialBits) - 1)) << materialShift)
+            | (uint64_t(mesh & ((1u << meshBits) - 1)) << meshShift)
+            | (depthBucket << depthShift);
+    }
+
+    void DrawQueue::clear() noexcept {
+        packets.clear();
+        bound = {};
+        frameCounters = {};
+    }
+
+    void DrawQueue::push(const DrawPacket& packet) noexcept {
+        packets.push_back(packet);
+    }
+
+    void DrawQueue::sort(JobSystem& jobs) noexcept {
+        const uint32_t count = static_cast<uint32_t>(packets.size());
+        entries.resize(count);
+        scratch.resize(count);
+        for (uint32_t i = 0; i < count; i++)
+            entries[i] = { packets[i].key, i };
+
+        const uint32_t chunkCount = std::clamp((count + chunkEntries - 1) / chunkEntries, 1u, maxChunks);
+        const uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+        histograms.resize(chunkCount * radixBuckets);
+
+        for (uint32_t shift = 0; shift < 64; shift += radixBits) {
+            jobs.parallel_for(0, chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+                for (uint32_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+                    uint32_t* histogram = histograms.data() + chunk * radixBuckets;
+                    std::fill(histogram, histogram + radixBuckets, 0u);
+                    const uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+                    for (uint32_t i = chunk * chunkSize; i < end; i++)
+                        histogram[(entries[i].key >> shift) & (radixBuckets - 1)]++;
+                }
+            });
+
+            //bucket major prefix so every chunk scatters its part of a bucket after the chunks before it
+            uint32_t offset = 0;
+            bool constantByte = false;
+            for (uint32_t bucket = 0; bucket < radixBuckets; bucket++) {
+                uint32_t bucketStart = offset;
+                for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+                    uint32_t items = histograms[chunk * radixBuckets + bucket];
+                    histograms[chunk * radixBuckets + bucket] = offset;
+                    offset += items;
+                }
+                if (offset - bucketStart == count)
+                    constantByte = true;
+            }
+            //every key shares this byte, the pass would not move anything
+            if (constantByte)
+                continue;
+
+            jobs.parallel_for(0, chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+                for (uint32_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+                    uint32_t* histogram = histograms.data() + chunk * radixBuckets;
+                    const uint32_t end = std::min(count, (chunk + 1) * chunkSize);
+                    for (uint32_t i = chunk * chunkSize; i < end; i++)
+                        scratch[histogram[(entries[i].key >> shift) & (radixBuckets - 1)]++] = entries[i];
+                }
+            });
+            entries.swap(scratch);
+        }
+    }
+
+    void DrawQueue::record(vk::CommandBuffer commandBuffer, uint32_t pass, const DrawTables& tables) noexcept {
+        auto [first, last] = pass_range(pass);
+        record_entries(commandBuffer, tables, first, last, bound, frameCounters);
+    }
+
+    [[nodiscard]] std::pair<uint32_t, uint32_t> DrawQueue::pass_range(uint32_t pass) const noexcept {
+        auto first = std::partition_point(entries.begin(), entries.end(),
+            [=](const SortEntry& entry) { return field(entry.key, passShift, passBits) < pass; });
+        auto last = std::partition_point(first, entries.end(),
+            [=](const SortEntry& entry) { return field(entry.key, passShift, passBits) == pass; });
+        return { static_cast<uint32_t>(first - entries.begin()), static_cast<uint32_t>(last - entries.begin()) };
+    }
+
+    void DrawQueue::record_range(vk::CommandBuffer commandBuffer, const DrawTables& tables, uint32_t first, uint32_t last,
+        DrawCounters& counters) const noexcept {
+        BoundState nothingBound = {};
+        record_entries(commandBuffer, tables, first, last, nothingBound, counters);
+    }
+
+    void DrawQueue::add_counters(const DrawCounters& counters) noexcept {
+        frameCounters.draws += counters.draws;
+        frameCounters.pipelineBinds += counters.pipelineBinds;
+        frameCounters.descriptorBinds += counters.descriptorBinds;
+        frameCounters.vertexBufferBinds += counters.vertexBufferBinds;
+        frameCounters.constantPushes += counters.constantPushes;
+        frameCounters.descriptorPushes += counters.descriptorPushes;
+        frameCounters.skippedBinds += counters.skippedBinds;
+    }
+
+    void DrawQueue::record_entries(vk::CommandBuffer commandBuffer, const DrawTables& tables, uint32_t first, uint32_t last,
+        BoundState& bound, DrawCounters& counters) const noexcept {
+        for (uint32_t i = first; i < last; i++) {
+            const SortEntry& entry = entries[i];
+            const DrawPacket& packet = packets[entry.packet];
+            const PipelineState& pipeline = tables.pipelines[field(entry.key, pipelineShift, pipelineBits)];
+            vk::DescriptorSet material = tables.materials[field(entry.key, materialShift, materialBits)];
+            const MeshState& mesh = tables.meshes[field(entry.key, meshShift, meshBits)];
+
+            if (pipeline.pipeline != bound.pipeline) {
+                commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.pipeline);
+                bound.pipeline = pipeline.pipeline;
+                counters.pipelineBinds++;
+            }
+            else
+                counters.skippedBinds++;
+
+            if (tables.bindless && tables.bindless != bound.bindless) {
+                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline.layout, 1, tables.bindless, nullptr);
+                bound.bindless = tables.bindless;
+                counters.descriptorBinds++;
+            }
+
+            if (material != bound.material) {
+                commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline.layout, 0, material, nullptr);
+                bound.material = material;
+                counters.descriptorBinds++;
+            }
+            else
+                counters.skippedBinds++;
+
+            if (mesh.vertexBuffer != bound.mesh.vertexBuffer || mesh.offset != bound.mesh.offset) {
+                commandBuffer.bindVertexBuffers(0, 1, &mesh.vertexBuffer, &mesh.offset);
+                bound.mesh = mesh;
+                counters.vertexBufferBinds++;
+            }
+            else
+                counters.skippedBinds++;
+
+            if (packet.hasConstants) {
+                if (!bound.constantsPushed || std::memcmp(&packet.constants, &bound.constants, sizeof(vkInit::ObjectData)) != 0) {
+                    commandBuffer.pushConstants(pipeline.layout, vkInit::objectDataStages, 0,
+                        sizeof(vkInit::ObjectData), &packet.constants);
+                    bound.constants = packet.constants;
+                    bound.constantsPushed = true;
+                    counters.constantPushes++;
+                }
+                else
+                    counters.skippedBinds++;
+            }
+
+            if (packet.drawBuffer.buffer) {
+                if (packet.drawBuffer != bound.drawBuffer) {
+                    vk::WriteDescriptorSet write = {};
+                    write.dstBinding = 0;
+                    write.descriptorCount = 1;
+                    write.descriptorType = vk::DescriptorType::eStorageBuffer;
+                    write.pBufferInfo = &packet.drawBuffer;
+                    commandBuffer.pushDescriptorSetKHR(vk::PipelineBindPoint::eGraphics, pipeline.layout, vkInit::drawSet,
+                        1, &write, *tables.dispatch);
+                    bound.drawBuffer = packet.drawBuffer;
+                    counters.descriptorPushes++;
+                }
+                else
+                    counters.skippedBinds++;
+            }
+
+            if (packet.indirectBuffer)
+                commandBuffer.drawIndirect(packet.indirectBuffer, packet.indirectOffset, 1, sizeof(vk::DrawIndirectCommand));
+            else
+                commandBuffer.draw(packet.vertexCount, packet.instanceCount, packet.firstVertex, packet.firstInstance);
+            counters.draws++;
+        }
+    }
+
+    [[nodiscard]] DrawCounters DrawQueue::counters() const noexcept {
+        return frameCounters;
+    }
+}
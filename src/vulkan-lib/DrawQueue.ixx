@@ -0,0 +1,132 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.drawQueue;
+
+import <span>;
+import <utility>;
+import <vector>;
+import vulkan_lib.jobSystem;
+import vulkan_lib.renderStructs;
+
+namespace vkl {
+
+    export struct PipelineState {
+        vk::Pipeline pipeline;
+        vk::PipelineLayout layout;
+    };
+
+    export struct MeshState {
+        vk::Buffer vertexBuffer;
+        vk::DeviceSize offset;
+    };
+
+    ///what the ids packed in a key stand for while recording.
+    ///materials are descriptor sets bound at set 0, every pipeline of one
+    ///queue has to be compatible with them. textures are picked through the
+    ///material id of each instance in the bindless set, so draws differing
+    ///only in texture share a material key.
+    export struct DrawTables {
+        std::span<const PipelineState> pipelines;
+        std::span<const vk::DescriptorSet> materials;
+        std::span<const MeshState> meshes;
+        ///bound at set 1 once per command buffer, none when null
+        vk::DescriptorSet bindless;
+        ///loads vkCmdPushDescriptorSetKHR, only read by draws with a draw buffer
+        const vk::detail::DispatchLoaderDynamic* dispatch;
+    };
+
+    export struct DrawPacket {
+        uint64_t key;
+        uint32_t vertexCount;
+        uint32_t instanceCount;
+        uint32_t firstVertex;
+        uint32_t firstInstance;
+        ///when set the counts are read from the vk::DrawIndirectCommand at indirectOffset
+        vk::Buffer indirectBuffer;
+        vk::DeviceSize indirectOffset;
+        ///pushed as constants when hasConstants, draws that only differ in
+        ///them share every bound set
+        vkInit::ObjectData constants;
+        bool hasConstants;
+        ///pushed to binding 0 of vkInit::drawSet when its buffer is set,
+        ///no set is allocated or written for it
+        vk::DescriptorBufferInfo drawBuffer;
+    };
+
+    ///what the last frame recorded, skipped binds were equal to the bound state
+    export struct DrawCounters {
+        uint32_t draws;
+        uint32_t pipelineBinds;
+        uint32_t descriptorBinds;
+        uint32_t vertexBufferBinds;
+        uint32_t constantPushes;
+        uint32_t descriptorPushes;
+        uint32_t skippedBinds;
+    };
+
+    ///draws of a frame sorted by a 64 bit key, from the top:
+    ///pass 4 bits, pipeline 12, material 12, mesh 12, depth 24.
+    ///sorting groups the draws that share state so recording them only binds
+    ///what changed between neighbours, depth orders front to back inside a group.
+    export class DrawQueue {
+    public:
+        static constexpr uint32_t passBits = 4;
+        static constexpr uint32_t pipelineBits = 12;
+        static constexpr uint32_t materialBits = 12;
+        static constexpr uint32_t meshBits = 12;
+        static constexpr uint32_t depthBits = 24;
+
+        DrawQueue();
+
+        ///depth is clamped to [0, 1]
+        [[nodiscard]] static uint64_t make_key(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) noexcept;
+
+        ///drops last frame's draws, bound state and counters
+        void clear() noexcept;
+        void push(const DrawPacket& packet) noexcept;
+        ///lsd radix sort over the keys, one byte per pass, chunks of draws counted and scattered in parallel
+        void sort(JobSystem& jobs) noexcept;
+        ///records the sorted draws of one pass. bound state carries over between calls until clear
+        void record(vk::CommandBuffer commandBuffer, uint32_t pass, const DrawTables& tables) noexcept;
+        ///first and one past the last sorted draw of pass
+        [[nodiscard]] std::pair<uint32_t, uint32_t> pass_range(uint32_t pass) const noexcept;
+        ///records sorted draws [first, last) starting from nothing bound, as a
+        ///secondary command buffer does. touches no queue state so several threads
+        ///can record disjoint ranges at once, each counting into its own counters
+        void record_range(vk::CommandBuffer commandBuffer, const DrawTables& tables, uint32_t first, uint32_t last,
+            DrawCounters& counters) const noexcept;
+        ///adds what record_range counted to the frame's counters
+        void add_counters(const DrawCounters& counters) noexcept;
+
+        [[nodiscard]] DrawCounters counters() const noexcept;
+
+    private:
+        struct SortEntry {
+            uint64_t key;
+            uint32_t packet;
+        };
+
+        struct BoundState {
+            vk::Pipeline pipeline;
+            vk::DescriptorSet material;
+            vk::DescriptorSet bindless;
+            MeshState mesh;
+            vkInit::ObjectData constants;
+            bool constantsPushed;
+            vk::DescriptorBufferInfo drawBuffer;
+        };
+
+        void record_entries(vk::CommandBuffer commandBuffer, const DrawTables& tables, uint32_t first, uint32_t last,
+            BoundState& bound, DrawCounters& counters) const noexcept;
+
+        std::vector<DrawPacket> packets;
+        std::vector<SortEntry> entries;
+        std::vector<SortEntry> scratch;
+        std::vector<uint32_t> histograms;
+
+        BoundState bound;
+        DrawCounters frameCounters;
+    };
+}
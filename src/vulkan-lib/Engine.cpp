@@ -5,10 +5,12 @@ module;
 module vulkan_lib.engine;
 
 import <glm/gtc/matrix_transform.hpp>;
+import <algorithm>;
+import <array>;
+import <span>;
 import <iostream>;
 import <expected>;
 import <stdexcept>; 
-import vulkan_lib.framebuffer;
 import vulkan_lib.instance;
 import vulkan_lib.logging;
 import vulkan_lib.pipeline;
@@ -24,17 +26,35 @@ import vulkan_lib.renderStructs;
 
 namespace vkl {
 
+    ///instances nearest to the camera rasterized as occluders by the cpu culler
+    constexpr size_t maxOccluders = 16;
+    ///instances a transform job encodes or bounds
+    constexpr uint32_t transformGrain = 1024;
+
+    ///passes of the draw queue, in the order they are recorded
+    constexpr uint32_t earlyPass = 0;
+    constexpr uint32_t latePass = 1;
+
+    ///descriptors a pool holds per set, covers the frame, cull and pyramid sets
+    constexpr DescriptorRatio descriptorRatios[] = {
+        { vk::DescriptorType::eUniformBuffer, 1.0f },
+        { vk::DescriptorType::eStorageBuffer, 4.0f },
+        { vk::DescriptorType::eCombinedImageSampler, 1.0f },
+        { vk::DescriptorType::eStorageImage, 1.0f },
+    };
+
     /// engine default constructor, will throw std::runtime_error
     /// if it fails.
-    Engine::Engine(int width, int height, GLFWwindow* window) : width(width), height(height), window(window) {
+    Engine::Engine(int width, int height, GLFWwindow* window, JobSystem& jobs, InstanceFormat instanceFormat) : width(width), height(height),
+        window(window), jobs(&jobs), instanceFormat(instanceFormat), cpuOcclusion(false), instanceColors(true), forceSecondaries(false), serialSnapshot{} {
         if constexpr (_DEBUG)
             std::cout << "building engine.\n";
         auto instanceRes = make_instance();
         if (!instanceRes)
             throw std::runtime_error("failed to make instance");
         //(void)make_instance().map_err_throw("failed to make instance");
+        dldi = vk::detail::DispatchLoaderDynamic(instance, vkGetInstanceProcAddr);
         if constexpr (_DEBUG) {
-            dldi = vk::detail::DispatchLoaderDynamic(instance, vkGetInstanceProcAddr);
             auto debug_messenger_res = make_debug_messanger();
             if (!debug_messenger_res)
                 throw std::runtime_error("failed to make debug messanger");
@@ -60,6 +80,14 @@ namespace vkl {
         if (!make_assets())
             throw std::runtime_error("failed to make assets");
         //(void)make_assets().map_err_throw("failed to make assets");
+        if constexpr (_DEBUG) {
+            PipelineCacheStats cacheStats = pipelineCache.stats();
+            std::cout << cacheStats.pipelinesCompiled << " pipelines compiled so far in " << cacheStats.compileMilliseconds
+                << " ms from a " << (cacheStats.warm ? "warm" : "cold") << " cache of " << cacheStats.loadedBytes << " bytes.\n";
+            ShaderLibraryStats shaderStats = shaderLibrary.stats();
+            std::cout << shaderStats.shaders << " shaders mapped from a " << (shaderStats.repacked ? "repacked " : "")
+                << shaderStats.archiveBytes << " byte archive, " << shaderStats.modulesCreated << " modules made.\n";
+        }
         set_glfw_input_callback();
         init_camera();
     }
@@ -69,12 +97,25 @@ namespace vkl {
             return;
         if constexpr (_DEBUG)
             std::cout << "deleting engine.\n";
+        //everything deferred is complete after the idle wait
+        graphicsTimeline.destroy();
+        transferTimeline.destroy();
+        asyncCompute.destroy();
+        //compiles still running finish into the cache before it is saved
+        pipelineRegistry.destroy();
+        //what this run compiled warms the next start
+        (void)pipelineCache.save();
+        pipelineCache.destroy();
+        shaderWatcher.destroy();
+        shaderLibrary.destroy();
         delete vertexManager;
-        device.destroyPipeline(pipeline);
         device.destroyPipelineLayout(layout);
-        device.destroyRenderPass(renderpass);
         cleanup_swapchain();
-        device.destroyDescriptorSetLayout(descriptorSetLayout);
+        commandAllocator.destroy();
+        delete occlusionCuller;
+        descriptorAllocator.destroy();
+        layoutCache.destroy();
+        bindless.destroy();
         device.destroyCommandPool(graphsPresCommandPool);
         device.destroyCommandPool(transferCommandPool);
         device.destroy();
@@ -86,9 +127,7 @@ namespace vkl {
     }
     void Engine::cleanup_swapchain() noexcept {
         for (auto& frame : swapchainFrames) {
-            device.destroyFramebuffer(frame.framebuffer);
             device.destroyImageView(frame.view);
-            device.destroyFence(frame.inFlightFence);
             device.destroySemaphore(frame.renderFinished);
             device.destroySemaphore(frame.imageAvailable);
 
@@ -96,14 +135,125 @@ namespace vkl {
             device.freeMemory(frame.cameraDataBuffer.bufferMemory);
             device.destroyBuffer(frame.cameraDataBuffer.buffer);
 
-            device.unmapMemory(frame.modelBuffer.bufferMemory);
-            device.freeMemory(frame.modelBuffer.bufferMemory);
-            device.destroyBuffer(frame.modelBuffer.buffer);
+            frame.instances.destroy();
+            frame.materialIds.destroy();
+            frame.sceneIds.destroy();
         }
-        device.destroyDescriptorPool(descriptorPool);
+        occlusionCuller->destroy_frame_resources();
+        //the sets go with their pools
+        descriptorCache.clear();
+        renderGraph.reset(device, physicalDevice);
+        //the frame, cull and pyramid sets go back to the free pools
+        descriptorAllocator.reset();
         device.destroySwapchainKHR(swapchain);
     }
 
+    [[nodiscard]] OcclusionStats Engine::occlusion_stats() const noexcept {
+        return occlusionStats;
+    }
+
+    void Engine::set_cpu_occlusion(bool enabled) noexcept {
+        cpuOcclusion = enabled;
+    }
+
+    void Engine::set_secondary_recording(bool forced) noexcept {
+        forceSecondaries = forced;
+    }
+
+    void Engine::set_instance_colors(bool enabled) noexcept {
+        if (instanceColors == enabled)
+            return;
+        instanceColors = enabled;
+        //the variant in use keeps drawing until the new one compiled, toggling back finds it in the registry
+        sceneState.vertexConstants.set_flag(vkInit::instanceColorsConstant, enabled);
+        scenePipeline = pipelineRegistry.request(sceneState, scenePipeline);
+    }
+
+    [[nodiscard]] BvhStats Engine::scene_bvh_stats() const noexcept {
+        return sceneBvh.stats();
+    }
+
+    [[nodiscard]] RenderGraphStats Engine::render_graph_stats() const noexcept {
+        return renderGraph.stats();
+    }
+
+    [[nodiscard]] TimelineStats Engine::graphics_timeline_stats() const noexcept {
+        return graphicsTimeline.stats();
+    }
+
+    [[nodiscard]] DescriptorCacheStats Engine::descriptor_cache_stats() const noexcept {
+        return descriptorCache.stats();
+    }
+
+    [[nodiscard]] DescriptorAllocatorStats Engine::descriptor_allocator_stats() const noexcept {
+        return descriptorAllocator.stats();
+    }
+
+    [[nodiscard]] CommandAllocatorStats Engine::command_allocator_stats() const noexcept {
+        return commandAllocator.stats();
+    }
+
+    [[nodiscard]] PipelineCacheStats Engine::pipeline_cache_stats() const noexcept {
+        return pipelineCache.stats();
+    }
+
+    [[nodiscard]] PipelineRegistryStats Engine::pipeline_registry_stats() const noexcept {
+        return pipelineRegistry.stats();
+    }
+
+    void Engine::reload_shaders() noexcept {
+        for (std::string& name : shaderWatcher.poll()) {
+            if (std::find(changedShaders.begin(), changedShaders.end(), name) == changedShaders.end())
+                changedShaders.push_back(std::move(name));
+        }
+
+        const ArchiveReload archiveReload = shaderLibrary.finish_reload();
+        if (archiveReload == ArchiveReload::Swapped) {
+            const uint32_t submitted = pipelineRegistry.reload(reloadingShaders);
+            if constexpr (_DEBUG) {
+                std::cout << reloadingShaders.size() << " shaders changed, recompiling " << submitted << " pipelines.\n";
+                //compute kernels are built once by the occlusion culler and keep their old code
+                for (const std::string& name : reloadingShaders) {
+                    if (!pipelineRegistry.uses(name))
+                        std::cerr << name << " changed but no reloadable pipeline uses it, restart to apply it\n";
+                }
+            }
+        }
+        if (archiveReload == ArchiveReload::Swapped || archiveReload == ArchiveReload::Failed)
+            reloadingShaders.clear();
+        //changes that came in while an archive was read start the next one
+        if (!changedShaders.empty() && shaderLibrary.begin_reload(*jobs)) {
+            reloadingShaders = std::move(changedShaders);
+            changedShaders.clear();
+        }
+        //modules of replaced code may only go once no compile could be creating from them
+        if (pipelineRegistry.idle())
+            shaderLibrary.purge_modules();
+
+        //frames in flight may still draw with a replaced pipeline, it goes once the last one that could finished
+        const uint64_t lastUse = graphicsTimeline.submitted();
+        (void)pipelineRegistry.swap([this, lastUse](vk::Pipeline retired) {
+            graphicsTimeline.defer(lastUse, [device = device, retired]() { device.destroyPipeline(retired); });
+        });
+    }
+
+    [[nodiscard]] ShaderLibraryStats Engine::shader_library_stats() const noexcept {
+        return shaderLibrary.stats();
+    }
+
+    [[nodiscard]] std::expected<uint64_t, EmptyErr> Engine::submit_compute(const std::function<void(vk::CommandBuffer)>& record) noexcept {
+        //graphics never waits the other way, the work may not read what frames write
+        return asyncCompute.submit(record);
+    }
+
+    [[nodiscard]] AsyncComputeStats Engine::async_compute_stats() const noexcept {
+        return asyncCompute.stats();
+    }
+
+    [[nodiscard]] DrawCounters Engine::draw_counters() const noexcept {
+        return drawQueue.counters();
+    }
+
     void Engine::init_camera() noexcept {
         glm::vec3 eye = { 5.0f, 0.0f, -1.0f };
         glm::vec3 center = glm::vec3(0.0f);
@@ -125,6 +275,12 @@ namespace vkl {
                 camera.state |= vkInit::player::Movement::Up;
             if (GLFW_KEY_LEFT_SHIFT == key)
                 camera.state |= vkInit::player::Movement::Down;
+            if (GLFW_KEY_C == key)
+                set_cpu_occlusion(!cpuOcclusion);
+            if (GLFW_KEY_V == key)
+                set_instance_colors(!instanceColors);
+            if (GLFW_KEY_P == key)
+                set_secondary_recording(!forceSecondaries);
         }
         if (action == GLFW_RELEASE) {
             if (GLFW_KEY_W == key)
@@ -191,6 +347,8 @@ namespace vkl {
         if (!device_res)
             return std::unexpected(EmptyErr{});
         device = device_res.value();
+        //extension commands recorded per draw are loaded from the device
+        dldi.init(device);
         vkUtil::QueueFamilyIndices indices =
             vkInit::get_queue(physicalDevice, device, surface);
         if (!indices.is_complete())
@@ -201,8 +359,32 @@ namespace vkl {
             indices.presentFamily.value() };
         transferQueue = { device.getQueue(indices.transferFamily.value(), 0),
             indices.transferFamily.value() };
+        computeQueue = { device.getQueue(indices.computeFamily.value(), 0),
+            indices.computeFamily.value() };
+        if (!graphicsTimeline.make(device) || !transferTimeline.make(device))
+            return std::unexpected(EmptyErr{});
+        descriptorCache.make(device);
+        layoutCache.make(device);
+        descriptorAllocator.make(device, descriptorRatios);
+        if (!shaderLibrary.make(device))
+            return std::unexpected(EmptyErr{});
+        //without a watcher the engine runs as before, only edits need a restart
+        if (!shaderWatcher.make("."))
+            vkInit::errprintDebug("shader hot reload is disabled");
+        if (!pipelineCache.make(device, physicalDevice))
+            return std::unexpected(EmptyErr{});
+        pipelineRegistry.make(device, pipelineCache, shaderLibrary, *jobs);
+        //the pipeline layout is made with the bindless layout before any asset loads
+        if (!bindless.make(device, physicalDevice))
+            return std::unexpected(EmptyErr{});
+        meshMaterials.fill(defaultMaterial);
+        transferWaited = 0;
         if (!vkInit::query_swapchain_support(physicalDevice, surface))
             return std::unexpected(EmptyErr{});
+        auto depth_format_res = vkUtil::find_depth_format(physicalDevice);
+        if (!depth_format_res)
+            return std::unexpected(EmptyErr{});
+        depthFormat = depth_format_res.value();
         if (!make_swapchain())
             return std::unexpected(EmptyErr{});
 
@@ -211,23 +393,25 @@ namespace vkl {
     }
     [[nodiscard]] std::expected<EmptyOk, EmptyErr>
         Engine::make_descriptor_set_layout() noexcept {
-        vkInit::DescriptorSetLayoutData bindings = {};
-        bindings.count = 2;
-
-        bindings.indices.push_back(0);
-        bindings.types.push_back(vk::DescriptorType::eUniformBuffer);
-        bindings.counts.push_back(1);
-        bindings.stages.push_back(vk::ShaderStageFlagBits::eVertex);
-
-        bindings.indices.push_back(1);
-        bindings.types.push_back(vk::DescriptorType::eStorageBuffer);
-        bindings.counts.push_back(1);
-        bindings.stages.push_back(vk::ShaderStageFlagBits::eVertex);
+        //the layouts are read from the shaders, a binding added to them needs no change here
+        const std::string shaders[] = { shader_variant("vertex", instanceFormat), "fragment.spv" };
+        auto reflection_res = vkInit::reflect_files(shaderLibrary, shaders);
+        if (!reflection_res)
+            return std::unexpected(EmptyErr{});
+        sceneReflection = std::move(reflection_res.value());
 
-        auto descriptor_set_layout_res = vkInit::make_descriptor_set_layout(device, bindings);
+        auto descriptor_set_layout_res = layoutCache.get(sceneReflection.set_layout(0));
         if (!descriptor_set_layout_res)
             return std::unexpected(EmptyErr{});
         descriptorSetLayout = descriptor_set_layout_res.value();
+
+        //per draw buffers, pushed into the command buffer with every draw that changes them
+        vkInit::DescriptorSetLayoutData drawBindings = sceneReflection.set_layout(vkInit::drawSet);
+        drawBindings.flags = vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR;
+        auto draw_set_layout_res = layoutCache.get(drawBindings);
+        if (!draw_set_layout_res)
+            return std::unexpected(EmptyErr{});
+        drawSetLayout = draw_set_layout_res.value();
         return EmptyOk{};
     }
 
@@ -247,6 +431,138 @@ namespace vkl {
         swapchainFrames = bundle.frames;
         swapchainFormat = bundle.format;
         maxFramesInFlight = static_cast<int>(swapchainFrames.size());
+        //the slots start out complete, recreation only happens with the queues idle
+        frameValues.assign(swapchainFrames.size(), graphicsTimeline.submitted());
+        imageValues.assign(swapchainFrames.size(), graphicsTimeline.submitted());
+        return make_render_graph();
+    }
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::make_render_graph() noexcept {
+        renderGraph.reset(device, physicalDevice);
+        colorTarget = renderGraph.import_image("swapchain", vk::ImageAspectFlagBits::eColor,
+            vk::PipelineStageFlagBits2::eColorAttachmentOutput);
+        renderGraph.export_resource(colorTarget, ResourceUsage::Present);
+        ImageDesc depthDesc = {};
+        depthDesc.extent = swapchainExtent;
+        depthDesc.format = depthFormat;
+        depthDesc.usage = vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled;
+        depthDesc.aspect = vk::ImageAspectFlagBits::eDepth;
+        depthTarget = renderGraph.create_image("depth", depthDesc);
+        //the culler's buffers, only their hazards are tracked
+        const uint32_t visibility = renderGraph.import_buffer("visibility");
+        const uint32_t drawList = renderGraph.import_buffer("draw list");
+        const uint32_t drawCommands = renderGraph.import_buffer("draw commands");
+        const uint32_t counters = renderGraph.import_buffer("counters");
+
+        vk::ClearValue clearValues[2] = {};
+        clearValues[0].color = vk::ClearColorValue(std::array<float, 4>{0.0f, 0.5f, 0.25f, 1.0f});
+        clearValues[1].depthStencil = vk::ClearDepthStencilValue(1.0f, 0);
+        auto draw = [this, clearValues](vk::CommandBuffer commandBuffer, bool late) {
+            //the late pass loads what the early pass drew, the graph moved both into attachment layouts
+            vk::RenderingAttachmentInfo colorAttachment = {};
+            colorAttachment.imageView = swapchainFrames[recording.imageIndex].view;
+            colorAttachment.imageLayout = vk::ImageLayout::eColorAttachmentOptimal;
+            colorAttachment.loadOp = late ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
+            colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+            colorAttachment.clearValue = clearValues[0];
+            vk::RenderingAttachmentInfo depthAttachment = {};
+            depthAttachment.imageView = renderGraph.view(depthTarget);
+            depthAttachment.imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+            depthAttachment.loadOp = late ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear;
+            depthAttachment.storeOp = vk::AttachmentStoreOp::eStore;
+            depthAttachment.clearValue = clearValues[1];
+
+            vk::RenderingInfo renderingInfo = {};
+            renderingInfo.renderArea.offset.x = 0;
+            renderingInfo.renderArea.offset.y = 0;
+            renderingInfo.renderArea.extent = swapchainExtent;
+            renderingInfo.layerCount = 1;
+            renderingInfo.colorAttachmentCount = 1;
+            renderingInfo.pColorAttachments = &colorAttachment;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+            //dynamic in every pipeline, so a resize only changes what is set here
+            auto [viewport, scissor] = vkInit::fillViewportScissor(swapchainExtent);
+            DrawTables tables = { recording.pipelines, recording.materials, recording.meshes, bindless.set(), &dldi };
+            auto [first, last] = drawQueue.pass_range(late ? latePass : earlyPass);
+            //a pass this small is only split when forced, so the secondary path is still exercised
+            const bool split = commandRecorder.chunk_count(last - first) > 1 || (forceSecondaries && last > first);
+            if (!split) {
+                commandBuffer.beginRendering(renderingInfo);
+                commandBuffer.setViewport(0, viewport);
+                commandBuffer.setScissor(0, scissor);
+                drawQueue.record(commandBuffer, late ? latePass : earlyPass, tables);
+                commandBuffer.endRendering();
+                return;
+            }
+
+            //big passes are split across threads into secondaries that start from nothing bound or set
+            renderingInfo.flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers;
+            commandBuffer.beginRendering(renderingInfo);
+            vk::CommandBufferInheritanceRenderingInfo inheritanceRendering = {};
+            inheritanceRendering.colorAttachmentCount = 1;
+            inheritanceRendering.pColorAttachmentFormats = &swapchainFormat;
+            inheritanceRendering.depthAttachmentFormat = depthFormat;
+            inheritanceRendering.rasterizationSamples = vk::SampleCountFlagBits::e1;
+            vk::CommandBufferInheritanceInfo inheritance = {};
+            inheritance.pNext = &inheritanceRendering;
+            chunkCounters.assign(commandRecorder.thread_count(), DrawCounters{});
+            auto recorded = commandRecorder.record(commandBuffer, inheritance, first, last,
+                [&](vk::CommandBuffer secondary, uint32_t chunk, uint32_t chunkFirst, uint32_t chunkLast) {
+                    secondary.setViewport(0, viewport);
+                    secondary.setScissor(0, scissor);
+                    drawQueue.record_range(secondary, tables, chunkFirst, chunkLast, chunkCounters[chunk]);
+                });
+            if (!recorded)
+                recording.failed = true;
+            for (const DrawCounters& counters : chunkCounters)
+                drawQueue.add_counters(counters);
+            commandBuffer.endRendering();
+        };
+
+        const uint32_t earlyCull = renderGraph.add_pass("early cull", [this](vk::CommandBuffer commandBuffer) {
+            occlusionCuller->record_early(commandBuffer, recording.imageIndex, frameNumber, recording.cullInput);
+        });
+        renderGraph.use(earlyCull, drawCommands, ResourceUsage::TransferWrite);
+        renderGraph.use(earlyCull, drawCommands, ResourceUsage::StorageWriteCompute);
+        renderGraph.use(earlyCull, counters, ResourceUsage::TransferWrite);
+        renderGraph.use(earlyCull, counters, ResourceUsage::StorageWriteCompute);
+        renderGraph.use(earlyCull, visibility, ResourceUsage::StorageReadCompute);
+        renderGraph.use(earlyCull, drawList, ResourceUsage::StorageWriteCompute);
+        renderGraph.keep(earlyCull);
+
+        const uint32_t earlyDraw = renderGraph.add_pass("early draw", [draw](vk::CommandBuffer commandBuffer) {
+            draw(commandBuffer, false);
+        });
+        renderGraph.use(earlyDraw, colorTarget, ResourceUsage::ColorAttachment);
+        renderGraph.use(earlyDraw, depthTarget, ResourceUsage::DepthAttachment);
+        renderGraph.use(earlyDraw, drawCommands, ResourceUsage::IndirectRead);
+        renderGraph.use(earlyDraw, drawList, ResourceUsage::VertexShaderRead);
+
+        const uint32_t depthPyramid = renderGraph.add_pass("depth pyramid", [this](vk::CommandBuffer commandBuffer) {
+            occlusionCuller->record_pyramid(commandBuffer);
+        });
+        //the pyramid itself stays inside the culler, it orders its own mips
+        renderGraph.use(depthPyramid, depthTarget, ResourceUsage::SampledCompute);
+        renderGraph.keep(depthPyramid);
+
+        const uint32_t lateCull = renderGraph.add_pass("late cull", [this](vk::CommandBuffer commandBuffer) {
+            occlusionCuller->record_late(commandBuffer, recording.imageIndex, frameNumber, recording.cullInput);
+        });
+        renderGraph.use(lateCull, visibility, ResourceUsage::StorageWriteCompute);
+        renderGraph.use(lateCull, drawList, ResourceUsage::StorageWriteCompute);
+        renderGraph.use(lateCull, drawCommands, ResourceUsage::StorageWriteCompute);
+        renderGraph.use(lateCull, counters, ResourceUsage::StorageWriteCompute);
+        renderGraph.keep(lateCull);
+
+        const uint32_t lateDraw = renderGraph.add_pass("late draw", [draw](vk::CommandBuffer commandBuffer) {
+            draw(commandBuffer, true);
+        });
+        renderGraph.use(lateDraw, colorTarget, ResourceUsage::ColorAttachment);
+        renderGraph.use(lateDraw, depthTarget, ResourceUsage::DepthAttachment);
+        renderGraph.use(lateDraw, drawCommands, ResourceUsage::IndirectRead);
+        renderGraph.use(lateDraw, drawList, ResourceUsage::VertexShaderRead);
+
+        if (!renderGraph.compile())
+            return std::unexpected(EmptyErr{});
         return EmptyOk{};
     }
     [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::recreate_swapchain() noexcept {
@@ -262,8 +578,11 @@ namespace vkl {
 
         if (!make_swapchain())
             return std::unexpected(EmptyErr{});
-        if (!make_framebuffers())
-            return std::unexpected(EmptyErr{});
+        //the extent is dynamic, only a format the scene pipeline was not built for needs a variant
+        if (swapchainFormat != sceneState.colorFormat) {
+            sceneState.colorFormat = swapchainFormat;
+            scenePipeline = pipelineRegistry.request(sceneState);
+        }
         if (!make_frame_resources())
             return std::unexpected(EmptyErr{});
         vkInit::CommandBufferInputBundle commandBufferInput = {
@@ -273,73 +592,75 @@ namespace vkl {
         if (!main_command_buffer_res)
             return std::unexpected(EmptyErr{});
         mainCommandBuffer = main_command_buffer_res.value();
-        if (!vkInit::make_frame_command_buffers(commandBufferInput))
+        //the image count may have changed, every frame needs its pools
+        if (!commandAllocator.make(device, graphicsQueue.queueFamilyIndex, static_cast<uint32_t>(maxFramesInFlight)))
+            return std::unexpected(EmptyErr{});
+        if (!asyncCompute.resize(static_cast<uint32_t>(maxFramesInFlight)))
             return std::unexpected(EmptyErr{});
         return EmptyOk{};
     }
-    [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::make_framebuffers() noexcept {
-        vkInit::FramebufferInput framebufferInput;
-        framebufferInput.device = device;
-        framebufferInput.renderPass = renderpass;
-        framebufferInput.swapchainExtent = swapchainExtent;
-        return vkInit::make_framebuffers(framebufferInput, swapchainFrames);
-    }
     [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::make_frame_resources() noexcept {
-        vkInit::DescriptorSetLayoutData bindings = {};
-        bindings.count = 2;
-        bindings.types.push_back(vk::DescriptorType::eUniformBuffer);
-        bindings.types.push_back(vk::DescriptorType::eStorageBuffer);
-        auto descriptor_pool_res = vkInit::make_descriptor_pool(device, static_cast<uint32_t>(swapchainFrames.size()), bindings);
-        if (!descriptor_pool_res)
-            return std::unexpected(EmptyErr{});
-        descriptorPool = descriptor_pool_res.value();
-
         for (vkInit::SwapchainFrame& frame : swapchainFrames) {
-            auto frame_in_flight_fence_res = vkInit::make_fence(device);
             auto frame_image_available_res = vkInit::make_semaphore(device);
             auto frame_render_finished_res = vkInit::make_semaphore(device);
 
-            if (!frame_in_flight_fence_res || !frame_image_available_res || !frame_render_finished_res)
+            if (!frame_image_available_res || !frame_render_finished_res)
                 return std::unexpected(EmptyErr{});
-            frame.inFlightFence = frame_in_flight_fence_res.value();
             frame.imageAvailable = frame_image_available_res.value();
             frame.renderFinished = frame_render_finished_res.value();
 
             if (!frame.make_descriptor_resources(device, physicalDevice))
                 return std::unexpected(EmptyErr{});
-            auto frame_descriptor_set_res = vkInit::allocate_descriptor_set(device, descriptorPool, descriptorSetLayout);
+            frame.drawListDescriptor = occlusionCuller->draw_list_descriptor();
+            auto frame_descriptor_set_res = descriptorAllocator.allocate(descriptorSetLayout);
             if (!frame_descriptor_set_res)
                 return std::unexpected(EmptyErr{});
             frame.descriptorSet = frame_descriptor_set_res.value();
+            frame.write_descriptor_set(descriptorCache);
         }
+        if (!occlusionCuller->make_frame_resources(swapchainFrames, renderGraph.view(depthTarget), swapchainExtent,
+            descriptorAllocator, descriptorCache))
+            return std::unexpected(EmptyErr{});
+        descriptorCache.flush();
         return EmptyOk{};
     }
 
     [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::make_pipeline() noexcept {
         vkInit::GraphicsPipelineBundle specs = {};
         specs.device = device;
-        specs.vertexFilepath = "vertex.spv";
+        specs.vertexFilepath = "vertex";
         specs.fragmentFilepath = "fragment.spv";
-        specs.extent = swapchainExtent;
+        specs.instanceFormat = instanceFormat;
         specs.swapchainImageFormat = swapchainFormat;
-        specs.descriptorSetLayout = descriptorSetLayout;
-        auto graphics_pipeline_res = vkInit::make_graphics_pipeline(specs);
+        specs.depthFormat = depthFormat;
+        specs.descriptorSetLayouts = { descriptorSetLayout, bindless.layout(), drawSetLayout };
+        specs.pushConstantRanges = sceneReflection.push_constant_ranges();
+        //the draw queue pushes the whole of ObjectData, its padding included
+        if (specs.pushConstantRanges.size() != 1 || specs.pushConstantRanges[0].size > sizeof(vkInit::ObjectData)) {
+            vkInit::errprintDebug("scene shaders' push constants do not fit ObjectData");
+            return std::unexpected(EmptyErr{});
+        }
+        specs.pushConstantRanges[0].size = sizeof(vkInit::ObjectData);
+        specs.vertexConstants.set_flag(vkInit::instanceColorsConstant, instanceColors);
+        specs.pipelineCache = &pipelineCache;
+        specs.shaderLibrary = &shaderLibrary;
+        //only the layout is made here, the rest of the set up
+        //runs while the workers compile the pipeline
+        auto graphics_pipeline_res = vkInit::make_graphics_pipeline(specs, false);
         if (!graphics_pipeline_res)
             return std::unexpected(EmptyErr{});
         vkInit::GraphicsPipelineOutBundle graphics_pipeline = graphics_pipeline_res.value();
 
-        pipeline = graphics_pipeline.pipeline;
-        renderpass = graphics_pipeline.renderpass;
+        sceneState = graphics_pipeline.state;
+        scenePipeline = pipelineRegistry.request(sceneState);
         layout = graphics_pipeline.layout;
         return {};
     }
 
     [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::finalize_set_up() noexcept {
-        if (!make_framebuffers())
-            return std::unexpected(EmptyErr{});
-
+        //frame work comes from the allocator, this pool only serves one off buffers
         auto graphics_pres_command_pool_res = vkInit::make_command_pool(device, physicalDevice, surface,
-            graphicsQueue.queueFamilyIndex);
+            graphicsQueue.queueFamilyIndex, vk::CommandPoolCreateFlags());
         if (!graphics_pres_command_pool_res)
             return std::unexpected(EmptyErr{});
         graphsPresCommandPool = graphics_pres_command_pool_res.value();
@@ -365,7 +686,14 @@ namespace vkl {
 
         transferCommandBuffer = transfer_command_buffer_res.value();
 
-        if (!vkInit::make_frame_command_buffers(gpCommandPoolInput))
+        if (!commandAllocator.make(device, graphicsQueue.queueFamilyIndex, static_cast<uint32_t>(maxFramesInFlight)))
+            return std::unexpected(EmptyErr{});
+        commandRecorder.make(&commandAllocator, jobs);
+        if (!asyncCompute.make(device, computeQueue, graphicsQueue.queueFamilyIndex, static_cast<uint32_t>(maxFramesInFlight)))
+            return std::unexpected(EmptyErr{});
+        occlusionCuller = new OcclusionCuller();
+        if (!occlusionCuller->make_pipelines(device, physicalDevice, static_cast<uint32_t>(maxFramesInFlight), instanceFormat, layoutCache, pipelineCache,
+            shaderLibrary, dldi))
             return std::unexpected(EmptyErr{});
         if (!make_frame_resources())
             return std::unexpected(EmptyErr{});
@@ -391,8 +719,9 @@ namespace vkl {
         vertexManager->consume(MeshType::TRIANGLE_R, triangle_r);
         //vertexManager->consume(MeshType::TRIANGLE_G, triangle_g);
         //vertexManager->consume(MeshType::TRIANGLE_B, triangle_b);
-        return vertexManager->finalize(device, physicalDevice, transferQueue.queue,
-            transferCommandBuffer);
+        const uint32_t vertexFamilies[] = { graphicsQueue.queueFamilyIndex, transferQueue.queueFamilyIndex };
+        return vertexManager->finalize(device, physicalDevice, transferQueue.queue, transferCommandBuffer, transferTimeline,
+            std::span<const uint32_t>(vertexFamilies, vertexFamilies[0] == vertexFamilies[1] ? 1 : 2));
 
         //materials
         //std::unordered_map<MeshType, const char*>filenames = {
@@ -402,7 +731,7 @@ namespace vkl {
     }
 
 
-    void Engine::prepare_frame(uint32_t imageIndex, const Scene& scene) noexcept {
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::prepare_frame(uint32_t imageIndex, const FrameSnapshot& snapshot) noexcept {
         vkInit::SwapchainFrame& _frame = swapchainFrames[imageIndex];
         /*glm::vec3 eye = {5.0f, 0.0f, -1.0f};
         glm::vec3 center = glm::vec3(0.0f);
@@ -416,75 +745,206 @@ namespace vkl {
         swapchainFrames[imageIndex].cameraData.projection = projection;
         swapchainFrames[imageIndex].cameraData.viewProjection = projection * view;*/
         //swapchainFrames[imageIndex].cameraData.viewProjection = glm::mat4(1.0f);
-        _frame.cameraData.viewProjection = camera.getViewProjection(swapchainExtent);
+        vkInit::Camera frameCamera = snapshot.camera;
+        _frame.cameraData.viewProjection = frameCamera.getViewProjection(swapchainExtent);
 
         //swapchainFrames[imageIndex].cameraData.viewProjection = glm::mat4(1.0f);
         memcpy(_frame.cameraDataWriteLocation,
             &(_frame.cameraData),
             sizeof(vkInit::UBO));
 
-        size_t i = 0;
-        _frame.modelTransforms[i++] = glm::translate(glm::mat4(1.0f), glm::vec3(0, -1, 0));
+        update_scene_bvh(snapshot);
+        visibleInstances.clear();
+        sceneBvh.query_frustum(make_frustum(_frame.cameraData.viewProjection), visibleInstances);
+        if (cpuOcclusion)
+            cpu_occlusion_cull(snapshot, _frame.cameraData.viewProjection);
 
-        /*
-        for (const glm::vec3& position : scene.triangleRPositions){
-            _frame.modelTransforms[i] = glm::translate(glm::mat4(1.0f),position);
-            i++;
-        }*/
-        memcpy(_frame.modelBufferWriteLocation, _frame.modelTransforms.data(), i * sizeof(glm::mat4));
-        _frame.write_descriptor_set(device);
+        const uint32_t instanceCount = static_cast<uint32_t>(visibleInstances.size());
+        const uint32_t sceneCount = static_cast<uint32_t>(snapshot.triangleRPositions.size());
+        if (!reserve_instances(imageIndex, instanceCount, sceneCount))
+            return std::unexpected(EmptyErr{});
+        const size_t words = instance_words(instanceFormat);
+        std::span<glm::vec4> instances = _frame.instances.span(instanceCount * words);
+        std::span<uint32_t> materialIds = _frame.materialIds.span(instanceCount);
+        //the slots are compacted, the gpu keys what it keeps between frames by scene index
+        std::span<uint32_t> sceneIds = _frame.sceneIds.span(instanceCount);
+        const uint32_t material = meshMaterials[static_cast<size_t>(MeshType::TRIANGLE_R)];
+        jobs->parallel_for(0, instanceCount, transformGrain, [&](uint32_t first, uint32_t last) {
+            for (uint32_t i = first; i < last; i++) {
+                encode_instance(instanceFormat, instances.subspan(i * words, words), snapshot.triangleRPositions[visibleInstances[i]]);
+                materialIds[i] = material;
+                sceneIds[i] = visibleInstances[i];
+            }
+        });
+        _frame.instanceCount = instanceCount;
+        return EmptyOk{};
     }
 
-
-    [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::prepare_scene(vk::CommandBuffer commandBuffer) noexcept {
-        vk::Buffer vertexBuffers[] = { vertexManager->vertexBuffer.buffer };
-        vk::DeviceSize offsets[] = { 0 };
-        commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
+    ///grows the frame's transforms and the culler's lists, descriptor sets are
+    ///only written again when one of them was replaced
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::reserve_instances(uint32_t imageIndex, uint32_t count,
+        uint32_t sceneCount) noexcept {
+        vkInit::SwapchainFrame& frame = swapchainFrames[imageIndex];
+        const size_t words = count * instance_words(instanceFormat);
+        if (words <= frame.instances.capacity() && count <= frame.materialIds.capacity() && count <= frame.sceneIds.capacity()
+            && count <= occlusionCuller->capacity() && sceneCount <= occlusionCuller->scene_capacity())
+            return EmptyOk{};
+        //frames in flight may still read the buffers being replaced and the sets being rewritten
+        if (!graphicsTimeline.wait(graphicsTimeline.submitted()))
+            return std::unexpected(EmptyErr{});
+        if (!frame.reserve_instances(words, count) || !occlusionCuller->reserve(count, sceneCount))
+            return std::unexpected(EmptyErr{});
+        for (vkInit::SwapchainFrame& other : swapchainFrames) {
+            other.drawListDescriptor = occlusionCuller->draw_list_descriptor();
+            other.write_descriptor_set(descriptorCache);
+        }
+        occlusionCuller->write_descriptor_sets(swapchainFrames, descriptorCache);
+        //only the bindings of the buffers that were replaced reach the driver
+        descriptorCache.flush();
         return EmptyOk{};
     }
 
-    [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::record_draw_buffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex,
-        const Scene& scene) noexcept {
-        vk::CommandBufferBeginInfo beginInfo = {};
-        if (commandBuffer.begin(beginInfo) != vk::Result::eSuccess)
-            return std::unexpected(EmptyErr{});
 
-        vk::RenderPassBeginInfo renderPassInfo = {};
-        renderPassInfo.renderPass = renderpass;
-        renderPassInfo.framebuffer = swapchainFrames[imageIndex].framebuffer;
-        renderPassInfo.renderArea.offset.x = 0;
-        renderPassInfo.renderArea.offset.y = 0;
-        renderPassInfo.renderArea.extent = swapchainExtent;
-        vk::ClearValue clearColor = { std::array<float, 4>{0.0f, 0.5f, 0.25f, 1.0f} };
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
+    void Engine::update_scene_bvh(const FrameSnapshot& snapshot) noexcept {
+        const glm::vec4 localSphere = vertexManager->bounds[static_cast<size_t>(MeshType::TRIANGLE_R)];
+        const std::vector<glm::vec3>& positions = snapshot.triangleRPositions;
+        instanceBoxes.resize(positions.size());
+        instanceMoved.resize(positions.size());
+        jobs->parallel_for(0, static_cast<uint32_t>(positions.size()), transformGrain, [&](uint32_t first, uint32_t last) {
+            for (uint32_t i = first; i < last; i++) {
+                const Aabb box = sphere_aabb(localSphere + glm::vec4(positions[i], 0.0f));
+                instanceMoved[i] = box.min != instanceBoxes[i].min || box.max != instanceBoxes[i].max;
+                instanceBoxes[i] = box;
+            }
+        });
+
+        if (sceneBvh.size() != instanceBoxes.size() || sceneBvh.needs_rebuild()) {
+            sceneBvh.build(instanceBoxes, *jobs);
+            return;
+        }
+        movedInstances.clear();
+        for (uint32_t i = 0; i < instanceMoved.size(); i++) {
+            if (instanceMoved[i])
+                movedInstances.push_back(i);
+        }
+        //a static scene leaves the tree as it is
+        if (movedInstances.empty())
+            return;
+        if (sceneBvh.prefers_updates(movedInstances.size())) {
+            for (uint32_t instance : movedInstances)
+                sceneBvh.update(instance, instanceBoxes[instance]);
+        }
+        else
+            sceneBvh.refit(instanceBoxes);
+    }
 
-        commandBuffer.beginRenderPass(&renderPassInfo, vk::SubpassContents::eInline);
+    ///drops the frustum visible instances hidden behind the ones nearest to the camera
+    void Engine::cpu_occlusion_cull(const FrameSnapshot& snapshot, const glm::mat4& viewProjection) noexcept {
+        const std::vector<glm::vec3>& positions = snapshot.triangleRPositions;
+        const glm::vec3 eye = snapshot.camera.eye;
+        occluderOrder.assign(visibleInstances.begin(), visibleInstances.end());
+        const size_t occluderCount = std::min(occluderOrder.size(), maxOccluders);
+        std::partial_sort(occluderOrder.begin(), occluderOrder.begin() + occluderCount, occluderOrder.end(),
+            [&](uint32_t a, uint32_t b) {
+                glm::vec3 toA = positions[a] - eye;
+                glm::vec3 toB = positions[b] - eye;
+                return glm::dot(toA, toA) < glm::dot(toB, toB);
+            });
 
-        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, swapchainFrames[imageIndex].descriptorSet, nullptr);
+        softwareOcclusion.clear();
+        std::span<const float> mesh = vertexManager->vertices(MeshType::TRIANGLE_R);
+        for (size_t i = 0; i < occluderCount; i++)
+            softwareOcclusion.add_occluder(mesh, viewProjection * glm::translate(glm::mat4(1.0f), positions[occluderOrder[i]]));
+        softwareOcclusion.rasterize(*jobs);
 
-        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+        occludeeBoxes.resize(visibleInstances.size());
+        occludeeVisibility.resize(visibleInstances.size());
+        for (size_t i = 0; i < visibleInstances.size(); i++)
+            occludeeBoxes[i] = instanceBoxes[visibleInstances[i]];
+        softwareOcclusion.test_boxes(occludeeBoxes, viewProjection, occludeeVisibility, *jobs);
 
-        if (!prepare_scene(commandBuffer))
+        size_t kept = 0;
+        for (size_t i = 0; i < visibleInstances.size(); i++)
+            if (occludeeVisibility[i])
+                visibleInstances[kept++] = visibleInstances[i];
+        visibleInstances.resize(kept);
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> Engine::record_draw_buffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex) noexcept {
+        vk::CommandBufferBeginInfo beginInfo = {};
+        if (commandBuffer.begin(beginInfo) != vk::Result::eSuccess)
             return std::unexpected(EmptyErr{});
 
-        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0, -1, 0));
-        vkInit::ObjectData objectData;
-        objectData.model = model;
-        /* commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0,
-                 sizeof(objectData), &objectData);*/
-        commandBuffer.draw(vertexManager->sizes[0], 3, vertexManager->offsets[0],
-            0);
+        const vkInit::SwapchainFrame& frame = swapchainFrames[imageIndex];
+        recording.imageIndex = imageIndex;
+        recording.failed = false;
+        recording.cullInput.viewProjection = frame.cameraData.viewProjection;
+        recording.cullInput.localSphere = vertexManager->bounds[static_cast<size_t>(MeshType::TRIANGLE_R)];
+        recording.cullInput.instanceCount = frame.instanceCount;
+        recording.cullInput.vertexCount = vertexManager->sizes[0];
+        recording.cullInput.firstVertex = vertexManager->offsets[0];
+
+        //every mesh lives in the same vertex buffer, draws pick theirs through firstVertex
+        recording.pipelines[0] = { pipelineRegistry.get(scenePipeline), layout };
+        recording.materials[0] = frame.descriptorSet;
+        recording.meshes.fill({ vertexManager->vertexBuffer.buffer, 0 });
+
+        drawQueue.clear();
+        //the graph still clears and culls while the scene pipeline compiles
+        if (recording.pipelines[0].pipeline) {
+            DrawPacket packet = {};
+            packet.indirectBuffer = occlusionCuller->draw_command_buffer();
+            //instances carry their own transforms and materials, the draw adds nothing to them
+            packet.constants.model = glm::mat4(1.0f);
+            packet.constants.material = vkInit::noMaterial;
+            packet.hasConstants = true;
+            packet.drawBuffer = frame.materialIdDescriptor;
+            packet.key = DrawQueue::make_key(earlyPass, 0, 0, static_cast<uint32_t>(MeshType::TRIANGLE_R), 0.0f);
+            packet.indirectOffset = OcclusionCuller::draw_command_offset(false);
+            drawQueue.push(packet);
+            packet.key = DrawQueue::make_key(latePass, 0, 0, static_cast<uint32_t>(MeshType::TRIANGLE_R), 0.0f);
+            packet.indirectOffset = OcclusionCuller::draw_command_offset(true);
+            packet.constants.drawIndex = 1;
+            drawQueue.push(packet);
+        }
+        drawQueue.sort(*jobs);
 
-        commandBuffer.endRenderPass();
+        bindless.record_pending(commandBuffer);
+        renderGraph.bind_image(colorTarget, frame.image);
+        renderGraph.execute(commandBuffer);
+        if (recording.failed)
+            return std::unexpected(EmptyErr{});
 
         if (commandBuffer.end() != vk::Result::eSuccess)
             return std::unexpected(EmptyErr{});
         return EmptyOk{};
     }
     std::expected<EmptyOk, EmptyErr> Engine::render(const Scene& scene, std::chrono::duration<float> delta) noexcept {
-        if (device.waitForFences(1, &swapchainFrames[frameNumber].inFlightFence,
-            VK_TRUE, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess)
+        camera.update(delta);
+        serialSnapshot.frame++;
+        serialSnapshot.camera = camera;
+        serialSnapshot.triangleRPositions.assign(scene.triangleRPositions.begin(), scene.triangleRPositions.end());
+        return render(serialSnapshot);
+    }
+
+    [[nodiscard]] vkInit::Camera Engine::camera_state() const noexcept {
+        return camera;
+    }
+
+    std::expected<EmptyOk, EmptyErr> Engine::render(const FrameSnapshot& snapshot) noexcept {
+        if (!graphicsTimeline.wait(frameValues[frameNumber]))
+            return std::unexpected(EmptyErr{});
+        if (!graphicsTimeline.collect() || !transferTimeline.collect())
+            return std::unexpected(EmptyErr{});
+        if (!asyncCompute.begin_frame(frameNumber))
+            return std::unexpected(EmptyErr{});
+        occlusionStats = occlusionCuller->stats(frameNumber);
+        reload_shaders();
+        //pipelines compiled at run time reach the disk without waiting for shutdown
+        (void)pipelineCache.save_if_stale(*jobs);
+        descriptorCache.begin_frame();
+        descriptorAllocator.begin_frame(frameNumber);
+        if (!commandAllocator.begin_frame(frameNumber))
             return std::unexpected(EmptyErr{});
         vk::ResultValue<uint32_t> imageIndex = device.acquireNextImageKHR(
             swapchain, std::numeric_limits<uint64_t>::max(),
@@ -504,44 +964,60 @@ namespace vkl {
             return std::unexpected(EmptyErr{});
         }
 
-        camera.update(delta);
-
-        vk::CommandBuffer commandBuffer = swapchainFrames[frameNumber].commandbuffer;
+        //the camera, instance and scene index buffers and the sets prepare_frame
+        //rewrites belong to the image, the frame slot's wait does not cover them
+        if (!graphicsTimeline.wait(imageValues[imageIndex.value]))
+            return std::unexpected(EmptyErr{});
 
-        if (commandBuffer.reset() != vk::Result::eSuccess);
+        //recycled from the frame's pool, which begin_frame reset as a whole
+        auto command_buffer_res = commandAllocator.allocate(0, vk::CommandBufferLevel::ePrimary);
+        if (!command_buffer_res)
+            return std::unexpected(EmptyErr{});
+        vk::CommandBuffer commandBuffer = command_buffer_res.value();
 
-        prepare_frame(imageIndex.value, scene);
+        if (!prepare_frame(imageIndex.value, snapshot))
+            return std::unexpected(EmptyErr{});
 
-        if (!record_draw_buffer(commandBuffer, imageIndex.value, scene)) {
+        if (!record_draw_buffer(commandBuffer, imageIndex.value)) {
             if constexpr (_DEBUG)
                 std::cerr << "failed to draw the command buffer.\n";
             return std::unexpected(EmptyErr{});
         }
-        vk::SubmitInfo submitInfo = {};
-        vk::Semaphore waitSemaphores[] = {
-            swapchainFrames[frameNumber].imageAvailable };
-        vk::PipelineStageFlags waitStages[] = {
-            vk::PipelineStageFlagBits::eColorAttachmentOutput };
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-        vk::Semaphore signalSemaphores[] = {
-            swapchainFrames[frameNumber].renderFinished };
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
-        if (device.resetFences(1, &swapchainFrames[frameNumber].inFlightFence) !=
-            vk::Result::eSuccess)
-            return std::unexpected(EmptyErr{});
-        if (graphicsQueue.queue.submit(submitInfo,
-            swapchainFrames[frameNumber].inFlightFence) !=
-            vk::Result::eSuccess)
+        std::array<vk::SemaphoreSubmitInfo, 3> waitInfos = {};
+        uint32_t waitCount = 0;
+        waitInfos[waitCount++] = vk::SemaphoreSubmitInfo(swapchainFrames[frameNumber].imageAvailable, 0,
+            vk::PipelineStageFlagBits2::eColorAttachmentOutput);
+        //uploads since the last frame are waited for on the gpu, the cpu never blocks on them
+        if (transferTimeline.submitted() > transferWaited) {
+            transferWaited = transferTimeline.submitted();
+            waitInfos[waitCount++] = transferTimeline.wait_info(transferWaited, vk::PipelineStageFlagBits2::eAllCommands);
+        }
+        //compute only joins where its results are read, the clears and copies before the cull go ahead
+        if (auto computeJoin = asyncCompute.join(vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect |
+            vk::PipelineStageFlagBits2::eVertexShader | vk::PipelineStageFlagBits2::eFragmentShader))
+            waitInfos[waitCount++] = computeJoin.value();
+        const uint64_t frameValue = graphicsTimeline.next();
+        std::array<vk::SemaphoreSubmitInfo, 2> signalInfos = {
+            vk::SemaphoreSubmitInfo(swapchainFrames[frameNumber].renderFinished, 0, vk::PipelineStageFlagBits2::eAllCommands),
+            graphicsTimeline.signal_info(frameValue, vk::PipelineStageFlagBits2::eAllCommands) };
+        vk::CommandBufferSubmitInfo commandInfo = {};
+        commandInfo.commandBuffer = commandBuffer;
+        vk::SubmitInfo2 submitInfo = {};
+        submitInfo.waitSemaphoreInfoCount = waitCount;
+        submitInfo.pWaitSemaphoreInfos = waitInfos.data();
+        submitInfo.commandBufferInfoCount = 1;
+        submitInfo.pCommandBufferInfos = &commandInfo;
+        submitInfo.signalSemaphoreInfoCount = static_cast<uint32_t>(signalInfos.size());
+        submitInfo.pSignalSemaphoreInfos = signalInfos.data();
+        if (graphicsQueue.queue.submit2(submitInfo, nullptr) != vk::Result::eSuccess)
             return std::unexpected(EmptyErr{});
+        graphicsTimeline.commit(frameValue);
+        frameValues[frameNumber] = frameValue;
+        imageValues[imageIndex.value] = frameValue;
 
         vk::PresentInfoKHR presentInfo = {};
         presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.pWaitSemaphores = &swapchainFrames[frameNumber].renderFinished;
         vk::SwapchainKHR swapchains[] = { swapchain };
         presentInfo.swapchainCount = 1;
         presentInfo.pSwapchains = swapchains;
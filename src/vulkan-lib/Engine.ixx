@@ -9,6 +9,10 @@ import <GLFW/glfw3.h>;
 import <unordered_map>;
 import <expected>;
 import <chrono>;
+import <vector>;
+import <array>;
+import <functional>;
+import <glm/glm.hpp>;
 
 import vulkan_lib.swapchainFrame;
 import vulkan_lib.vertexManager;
@@ -16,6 +20,27 @@ import vulkan_lib.queueFamilies;
 import vulkan_lib.camera3D;
 import vulkan_lib.scene;
 import vulkan_lib.image;
+import vulkan_lib.occlusion;
+import vulkan_lib.softwareOcclusion;
+import vulkan_lib.bounds;
+import vulkan_lib.bvh;
+import vulkan_lib.drawQueue;
+import vulkan_lib.instanceFormat;
+import vulkan_lib.renderGraph;
+import vulkan_lib.commandAllocator;
+import vulkan_lib.parallelRecorder;
+import vulkan_lib.jobSystem;
+import vulkan_lib.frameSnapshot;
+import vulkan_lib.timeline;
+import vulkan_lib.asyncCompute;
+import vulkan_lib.descriptorCache;
+import vulkan_lib.descriptorAllocator;
+import vulkan_lib.bindless;
+import vulkan_lib.pipelineCache;
+import vulkan_lib.pipelineRegistry;
+import vulkan_lib.reflection;
+import vulkan_lib.shaderLibrary;
+import vulkan_lib.fileWatcher;
 import vulkan_lib.result;
 
 ///my custom engine class
@@ -23,27 +48,85 @@ namespace vkl {
     export class Engine
     {
     public:
-        Engine(int width, int height, GLFWwindow* window);
+        ///instanceFormat picks the shader variants the pipelines are built with.
+        ///jobs runs the engine's parallel work and must outlive it
+        Engine(int width, int height, GLFWwindow* window, JobSystem& jobs, InstanceFormat instanceFormat = InstanceFormat::QuatScale);
         ~Engine();
+        ///moves the camera by delta and renders the scene as it is now
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> render(const Scene& scene, std::chrono::duration<float> delta) noexcept;
+        ///renders a snapshot produced on another thread, the engine's camera is not moved
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> render(const FrameSnapshot& snapshot) noexcept;
+        ///the camera with the movement keys held right now, for a simulation that moves its own copy
+        [[nodiscard]] vkInit::Camera camera_state() const noexcept;
         void engine_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+        ///occlusion counters of the last frame the gpu finished
+        [[nodiscard]] OcclusionStats occlusion_stats() const noexcept;
+        ///rejects occluded instances on the cpu before their transforms are written
+        void set_cpu_occlusion(bool enabled) noexcept;
+        ///tints the first instances, toggling switches to a specialized variant of the scene pipeline
+        void set_instance_colors(bool enabled) noexcept;
+        ///records every draw pass into secondary buffers even when it is too small to split.
+        ///the scene issues one indirect draw per pass, which never reaches the split threshold
+        void set_secondary_recording(bool forced) noexcept;
+        ///build and refit costs of the instance hierarchy
+        [[nodiscard]] BvhStats scene_bvh_stats() const noexcept;
+        ///binds and draws recorded for the last frame
+        [[nodiscard]] DrawCounters draw_counters() const noexcept;
+        ///passes, barriers and transient memory of the compiled frame graph
+        [[nodiscard]] RenderGraphStats render_graph_stats() const noexcept;
+        ///submitted and completed values and cpu waits of the graphics queue
+        [[nodiscard]] TimelineStats graphics_timeline_stats() const noexcept;
+        ///descriptor writes issued in the last frame and since startup
+        [[nodiscard]] DescriptorCacheStats descriptor_cache_stats() const noexcept;
+        ///pools created, recycled and exhausted by the descriptor allocator
+        [[nodiscard]] DescriptorAllocatorStats descriptor_allocator_stats() const noexcept;
+        ///pool resets and how many frame command buffers were reused
+        [[nodiscard]] CommandAllocatorStats command_allocator_stats() const noexcept;
+        ///whether startup found a usable cache on disk and how long pipelines took to compile
+        [[nodiscard]] PipelineCacheStats pipeline_cache_stats() const noexcept;
+        ///pipeline requests, how many were shared and how many still compile
+        [[nodiscard]] PipelineRegistryStats pipeline_registry_stats() const noexcept;
+        ///size of the mapped shader archive and how many modules were shared
+        [[nodiscard]] ShaderLibraryStats shader_library_stats() const noexcept;
+        ///records work that does not depend on the frame onto the compute queue, where it
+        ///overlaps the graphics queue. the next frame's compute and draws wait for it
+        [[nodiscard]] std::expected<uint64_t, EmptyErr> submit_compute(const std::function<void(vk::CommandBuffer)>& record) noexcept;
+        ///whether compute got its own family and how often graphics waited on it
+        [[nodiscard]] AsyncComputeStats async_compute_stats() const noexcept;
     private:
+        ///what the render graph passes record from, filled before it executes
+        struct FrameRecording {
+            uint32_t imageIndex;
+            ///set by a pass that failed, graph passes cannot return errors
+            bool failed;
+            CullInput cullInput;
+            PipelineState pipelines[1];
+            vk::DescriptorSet materials[1];
+            std::array<MeshState, static_cast<size_t>(MeshType::NUM)> meshes;
+        };
+
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_instance() noexcept;
         [[nodiscard]] std::expected<vk::DebugUtilsMessengerEXT, EmptyErr> make_debug_messanger() noexcept;
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_device() noexcept;
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_swapchain() noexcept;
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> recreate_swapchain() noexcept;
+        ///rereads changed shaders on a worker, recompiles their pipelines once the new archive
+        ///is in and swaps in the ones that finished, once per frame and never waiting
+        void reload_shaders() noexcept;
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_render_graph() noexcept;
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_descriptor_set_layout() noexcept;
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_pipeline() noexcept;
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> finalize_set_up() noexcept;
-        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_framebuffers() noexcept;
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_frame_resources() noexcept;
-        [[nodiscard]] std::expected<EmptyOk, EmptyErr> record_draw_buffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex, const Scene& scene) noexcept;
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> record_draw_buffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex) noexcept;
         [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_assets() noexcept;
-        [[nodiscard]] std::expected<EmptyOk, EmptyErr> prepare_scene(vk::CommandBuffer commandBuffer) noexcept;
 
         void set_glfw_input_callback()noexcept;
-        void prepare_frame(uint32_t imageIndex, const Scene& scene) noexcept;
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> prepare_frame(uint32_t imageIndex, const FrameSnapshot& snapshot) noexcept;
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> reserve_instances(uint32_t imageIndex, uint32_t count,
+            uint32_t sceneCount) noexcept;
+        void update_scene_bvh(const FrameSnapshot& snapshot) noexcept;
+        void cpu_occlusion_cull(const FrameSnapshot& snapshot, const glm::mat4& viewProjection) noexcept;
 
         void init_camera()noexcept;
 
@@ -52,6 +135,7 @@ namespace vkl {
         int width;
         int height;
         GLFWwindow* window;
+        JobSystem* jobs;
         //instance related
         vk::Instance instance;
         vk::DebugUtilsMessengerEXT debugMessenger{ nullptr };
@@ -64,16 +148,27 @@ namespace vkl {
         vkUtil::Queue graphicsQueue{ nullptr };
         vkUtil::Queue presentQueue{ nullptr };
         vkUtil::Queue transferQueue{ nullptr };
+        ///the graphics queue again on devices without a compute only family
+        vkUtil::Queue computeQueue{ nullptr };
 
         //swapchain related
         vk::SwapchainKHR swapchain;
         std::vector<vkInit::SwapchainFrame>swapchainFrames;
         vk::Format swapchainFormat;
         vk::Extent2D swapchainExtent;
+        vk::Format depthFormat;
+
+        //frame graph, the depth buffer is one of its transients
+        RenderGraph renderGraph;
+        uint32_t colorTarget;
+        uint32_t depthTarget;
+        FrameRecording recording;
 
         //pipeline related variables
-        vk::Pipeline pipeline;
-        vk::RenderPass renderpass;
+        ///compiled on the workers, frames draw nothing until it is ready
+        PipelineHandle scenePipeline;
+        ///what scenePipeline was requested with, a new swapchain format requests a variant
+        vkInit::GraphicsPipelineState sceneState;
         vk::PipelineLayout layout;
 
         //commands
@@ -81,18 +176,81 @@ namespace vkl {
         vk::CommandPool transferCommandPool;
         vk::CommandBuffer mainCommandBuffer;
         vk::CommandBuffer transferCommandBuffer;
+        ///per thread pools of every frame's buffers, indexed by frameNumber
+        CommandAllocator commandAllocator;
+        ParallelRecorder commandRecorder;
+        std::vector<DrawCounters> chunkCounters;
 
-        //sync objects
+        //sync objects, frame N is done once graphicsTimeline reaches N
         int maxFramesInFlight, frameNumber;
+        QueueTimeline graphicsTimeline;
+        QueueTimeline transferTimeline;
+        ///graphics value each frame slot last signaled, indexed by frameNumber.
+        ///guards the per frame pools, semaphores and counter slots
+        std::vector<uint64_t> frameValues;
+        ///graphics value of the last submission that read each swapchain image's
+        ///buffers and sets, indexed by image. acquire order does not follow frameNumber
+        std::vector<uint64_t> imageValues;
+        ///last transfer value a graphics submission waited on
+        uint64_t transferWaited;
+        ///submissions to computeQueue with their own timeline, joined by the next frame
+        AsyncCompute asyncCompute;
 
         //descriptor objects
+        ///bindings and push constants of the scene shaders, sets 0 and 2 are built from it
+        vkInit::ShaderReflection sceneReflection;
+        ///owned by layoutCache
         vk::DescriptorSetLayout descriptorSetLayout;
-        vk::DescriptorPool descriptorPool;
+        ///push descriptor layout of the per draw buffers, owned by layoutCache
+        vk::DescriptorSetLayout drawSetLayout;
+        DescriptorLayoutCache layoutCache;
+        ///persistent sets live until the swapchain is rebuilt, transient ones for a frame
+        DescriptorAllocator descriptorAllocator;
+        ///every set is written through it, unchanged bindings are never written twice
+        DescriptorWriteCache descriptorCache;
+        ///every texture and buffer the shaders index, bound at set 1
+        BindlessTable bindless;
+        //pipeline objects
+        ///every shader, mapped from one archive, with the modules made from it
+        ShaderLibrary shaderLibrary;
+        ///.spv files rewritten while running, their pipelines are rebuilt and swapped in
+        FileWatcher shaderWatcher;
+        ///changed since the archive being read now was started
+        std::vector<std::string> changedShaders;
+        ///whose pipelines are recompiled once the archive being read is swapped in
+        std::vector<std::string> reloadingShaders;
+        ///every pipeline is compiled through it, loaded from and saved to disk
+        PipelineCache pipelineCache;
+        PipelineRegistry pipelineRegistry;
         //assets
         VertexManager* vertexManager;
-        std::unordered_map<MeshType, Image*> materials;
+        ///material id every instance of a mesh is drawn with
+        std::array<uint32_t, static_cast<size_t>(MeshType::NUM)> meshMaterials;
+
+        //culling
+        OcclusionCuller* occlusionCuller;
+        OcclusionStats occlusionStats;
+        DrawQueue drawQueue;
+        ///layout the model buffer is written in, sceneState and the cull pipeline are requested for it
+        InstanceFormat instanceFormat;
+        Bvh sceneBvh;
+        std::vector<Aabb> instanceBoxes;
+        ///whether an instance's box changed since the last frame, moved ones are updated in the tree alone
+        std::vector<uint8_t> instanceMoved;
+        std::vector<uint32_t> movedInstances;
+        std::vector<uint32_t> visibleInstances;
+        bool cpuOcclusion;
+        bool instanceColors;
+        ///passes go through commandRecorder whatever their size
+        bool forceSecondaries;
+        SoftwareOcclusion softwareOcclusion;
+        std::vector<Aabb> occludeeBoxes;
+        std::vector<uint8_t> occludeeVisibility;
+        std::vector<uint32_t> occluderOrder;
 
         vkInit::Camera camera;
+        ///what render(scene, delta) copies the scene into
+        FrameSnapshot serialSnapshot;
     };
 
 }
@@ -0,0 +1,133 @@
+module;
+
+#include "vulkan-lib/Config.h"
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+module vulkan_lib.fileWatcher;
+
+import <algorithm>;
+import vulkan_lib.logging;
+
+namespace vkl {
+
+    FileWatcher::FileWatcher() : descriptor(-1), notification(nullptr) {
+    }
+
+    FileWatcher::~FileWatcher() {
+        destroy();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> FileWatcher::make(std::string directory, std::string extension) noexcept {
+        destroy();
+        this->directory = std::move(directory);
+        this->extension = std::move(extension);
+        changed.clear();
+#if defined(_WIN32)
+        HANDLE handle = FindFirstChangeNotificationA(this->directory.c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+        if (handle == INVALID_HANDLE_VALUE) {
+            vkInit::errprintDebug("failed to watch the shader directory");
+            return std::unexpected(EmptyErr{});
+        }
+        notification = handle;
+        //the times now are the baseline, only later writes are changes
+        scan_write_times();
+        changed.clear();
+#else
+        descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (descriptor < 0) {
+            vkInit::errprintDebug("failed to initialize inotify");
+            return std::unexpected(EmptyErr{});
+        }
+        //a file renamed into place counts as much as one written in place
+        if (inotify_add_watch(descriptor, this->directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            close(descriptor);
+            descriptor = -1;
+            vkInit::errprintDebug("failed to watch the shader directory");
+            return std::unexpected(EmptyErr{});
+        }
+#endif
+        return EmptyOk{};
+    }
+
+    void FileWatcher::destroy() noexcept {
+#if defined(_WIN32)
+        if (notification)
+            FindCloseChangeNotification(notification);
+#else
+        if (descriptor >= 0)
+            close(descriptor);
+#endif
+        notification = nullptr;
+        descriptor = -1;
+        writeTimes.clear();
+        changed.clear();
+    }
+
+    [[nodiscard]] std::vector<std::string> FileWatcher::poll() noexcept {
+#if defined(_WIN32)
+        if (!notification)
+            return {};
+        bool signaled = false;
+        while (WaitForSingleObject(notification, 0) == WAIT_OBJECT_0) {
+            signaled = true;
+            if (!FindNextChangeNotification(notification))
+                break;
+        }
+        if (signaled)
+            scan_write_times();
+#else
+        if (descriptor < 0)
+            return {};
+        alignas(inotify_event) char buffer[4096];
+        for (;;) {
+            const ssize_t length = read(descriptor, buffer, sizeof(buffer));
+            if (length <= 0)
+                break;
+            for (ssize_t at = 0; at < length;) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + at);
+                if (event->len > 0)
+                    note_change(event->name);
+                at += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+#endif
+        if (changed.empty() || std::chrono::steady_clock::now() - lastChange < settleTime)
+            return {};
+        std::vector<std::string> result = std::move(changed);
+        changed.clear();
+        return result;
+    }
+
+    void FileWatcher::note_change(const std::string& name) noexcept {
+        if (!name.ends_with(extension))
+            return;
+        lastChange = std::chrono::steady_clock::now();
+        if (std::find(changed.begin(), changed.end(), name) == changed.end())
+            changed.push_back(name);
+    }
+
+    void FileWatcher::scan_write_times() noexcept {
+        std::error_code error;
+        for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+            if (!entry.is_regular_file(error))
+                continue;
+            const std::string name = entry.path().filename().string();
+            const auto writeTime = entry.last_write_time(error);
+            if (error)
+                continue;
+            auto known = writeTimes.find(name);
+            if (known != writeTimes.end() && known->second == writeTime)
+                continue;
+            writeTimes[name] = writeTime;
+            note_change(name);
+        }
+    }
+}
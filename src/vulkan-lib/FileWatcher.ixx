@@ -0,0 +1,54 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.fileWatcher;
+
+import <chrono>;
+import <expected>;
+import <filesystem>;
+import <string>;
+import <unordered_map>;
+import <vector>;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    ///reports the files of one directory written since it was last asked.
+    ///
+    ///inotify on linux tells which files were closed after writing, windows only
+    ///signals that the directory changed and the files' write times are compared.
+    ///a compiler may write a file in pieces, so changes are only reported once
+    ///none came in for settleTime. poll never blocks, it belongs to one thread.
+    export class FileWatcher {
+    public:
+        static constexpr std::chrono::milliseconds settleTime{ 150 };
+
+        FileWatcher();
+        ~FileWatcher();
+        FileWatcher(const FileWatcher& ref) = delete;
+        FileWatcher& operator=(const FileWatcher& ref) = delete;
+
+        ///watches the files of directory ending in extension
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make(std::string directory, std::string extension = ".spv") noexcept;
+        void destroy() noexcept;
+
+        ///file names changed since the last call, empty until the changes settled
+        [[nodiscard]] std::vector<std::string> poll() noexcept;
+
+    private:
+        void note_change(const std::string& name) noexcept;
+        ///write times of the watched files, for platforms that do not name the changed file
+        void scan_write_times() noexcept;
+
+        std::string directory;
+        std::string extension;
+        ///inotify descriptor on linux, -1 when not watching
+        int descriptor;
+        ///change notification handle on windows
+        void* notification;
+        std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+        std::vector<std::string> changed;
+        std::chrono::steady_clock::time_point lastChange;
+    };
+}
@@ -0,0 +1,94 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.frameSnapshot;
+
+namespace vkl {
+
+    constexpr uint32_t noSlot = SnapshotQueue::slotCount;
+
+    SnapshotQueue::SnapshotQueue() : slots{}, sequence{}, writeSlot(noSlot), readSlot(noSlot), closed(false), statistics{} {
+        states.fill(SlotState::Free);
+    }
+
+    [[nodiscard]] FrameSnapshot* SnapshotQueue::begin_write() noexcept {
+        std::unique_lock<std::mutex> guard(lock);
+        auto free_slot = [this]() {
+            for (uint32_t slot = 0; slot < slotCount; slot++)
+                if (states[slot] == SlotState::Free)
+                    return slot;
+            return noSlot;
+        };
+        changed.wait(guard, [&]() { return closed || free_slot() != noSlot; });
+        if (closed)
+            return nullptr;
+        writeSlot = free_slot();
+        states[writeSlot] = SlotState::Writing;
+        return &slots[writeSlot];
+    }
+
+    void SnapshotQueue::publish() noexcept {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            states[writeSlot] = SlotState::Ready;
+            sequence[writeSlot] = ++statistics.published;
+            writeSlot = noSlot;
+        }
+        changed.notify_all();
+    }
+
+    [[nodiscard]] const FrameSnapshot* SnapshotQueue::begin_read() noexcept {
+        std::unique_lock<std::mutex> guard(lock);
+        auto any_ready = [this]() {
+            for (SlotState state : states)
+                if (state == SlotState::Ready)
+                    return true;
+            return false;
+        };
+        changed.wait(guard, [&]() { return closed || any_ready(); });
+        if (closed)
+            return nullptr;
+
+        readSlot = noSlot;
+        for (uint32_t slot = 0; slot < slotCount; slot++)
+            if (states[slot] == SlotState::Ready && (readSlot == noSlot || sequence[slot] > sequence[readSlot]))
+                readSlot = slot;
+        bool freed = false;
+        for (uint32_t slot = 0; slot < slotCount; slot++) {
+            if (states[slot] == SlotState::Ready && slot != readSlot) {
+                states[slot] = SlotState::Free;
+                statistics.dropped++;
+                freed = true;
+            }
+        }
+        states[readSlot] = SlotState::Reading;
+        guard.unlock();
+        if (freed)
+            changed.notify_all();
+        return &slots[readSlot];
+    }
+
+    void SnapshotQueue::end_read() noexcept {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            states[readSlot] = SlotState::Free;
+            readSlot = noSlot;
+            statistics.rendered++;
+        }
+        changed.notify_all();
+    }
+
+    void SnapshotQueue::close() noexcept {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            closed = true;
+        }
+        changed.notify_all();
+    }
+
+    [[nodiscard]] SnapshotQueueStats SnapshotQueue::stats() const noexcept {
+        std::lock_guard<std::mutex> guard(lock);
+        return statistics;
+    }
+}
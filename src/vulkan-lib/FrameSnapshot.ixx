@@ -0,0 +1,75 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.frameSnapshot;
+
+import <array>;
+import <condition_variable>;
+import <mutex>;
+import <vector>;
+import <glm/glm.hpp>;
+import vulkan_lib.camera3D;
+
+namespace vkl {
+
+    ///everything the renderer reads of one simulated frame, immutable once published
+    export struct FrameSnapshot {
+        uint64_t frame;
+        vkInit::Camera camera;
+        std::vector<glm::vec3> triangleRPositions;
+    };
+
+    export struct SnapshotQueueStats {
+        uint64_t published;
+        uint64_t rendered;
+        ///published snapshots a newer one replaced before the renderer got to them
+        uint64_t dropped;
+    };
+
+    ///hands snapshots from the simulation thread to the render thread.
+    ///
+    ///three slots, one being written, one being read and one ready in between,
+    ///so neither side waits on the other unless it is a whole frame ahead. the
+    ///reader always takes the newest ready snapshot and frees older ones, a
+    ///slow renderer shows the latest state instead of falling behind. slots are
+    ///reused, their vectors keep their capacity between frames.
+    export class SnapshotQueue {
+    public:
+        static constexpr uint32_t slotCount = 3;
+
+        SnapshotQueue();
+
+        ///a free slot to fill, blocks while every slot is taken, nullptr once closed
+        [[nodiscard]] FrameSnapshot* begin_write() noexcept;
+        ///makes the slot from begin_write readable
+        void publish() noexcept;
+        ///the newest published snapshot, blocks until there is one, nullptr once closed
+        [[nodiscard]] const FrameSnapshot* begin_read() noexcept;
+        ///frees the slot from begin_read
+        void end_read() noexcept;
+        ///wakes both sides, every later begin returns nullptr
+        void close() noexcept;
+
+        [[nodiscard]] SnapshotQueueStats stats() const noexcept;
+
+    private:
+        enum class SlotState {
+            Free,
+            Writing,
+            Ready,
+            Reading,
+        };
+
+        std::array<FrameSnapshot, slotCount> slots;
+        std::array<SlotState, slotCount> states;
+        ///publish order of the ready slots
+        std::array<uint64_t, slotCount> sequence;
+        uint32_t writeSlot;
+        uint32_t readSlot;
+        bool closed;
+        mutable std::mutex lock;
+        std::condition_variable changed;
+        SnapshotQueueStats statistics;
+    };
+}
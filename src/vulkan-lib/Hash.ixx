@@ -0,0 +1,24 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.hash;
+
+namespace vkl {
+
+    ///mixes value into seed, splitmix64 finalizer over the running seed
+    export [[nodiscard]] inline auto
+    hash_combine(uint64_t seed, uint64_t value) noexcept -> uint64_t {
+        uint64_t x = seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        return x ^ (x >> 31);
+    }
+
+    ///the raw handle of a vulkan-hpp handle, for hashing
+    export template<typename Handle>
+    [[nodiscard]] inline auto
+    handle_bits(Handle handle) noexcept -> uint64_t {
+        return (uint64_t)(static_cast<typename Handle::CType>(handle));
+    }
+}
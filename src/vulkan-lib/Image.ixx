@@ -5,6 +5,11 @@ module;
 export module vulkan_lib.image;
 
 import "stb_image.h";
+import <expected>;
+import <iostream>;
+import vulkan_lib.memory;
+import vulkan_lib.result;
+import vulkan_lib.logging;
 
 export namespace vkl {
     export struct ImageInputBundle{
@@ -40,3 +45,138 @@ export namespace vkl {
     };
 
 }
+
+export namespace vkUtil {
+
+    export struct ImageInput{
+        vk::Device device;
+        vk::PhysicalDevice physicalDevice;
+        vk::Extent2D extent;
+        uint32_t mipLevels = 1;
+        vk::Format format;
+        vk::ImageUsageFlags usage;
+        vk::ImageAspectFlags aspect;
+        vk::MemoryPropertyFlags properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    };
+
+    ///image, its memory and a view over the whole mip chain
+    export struct AllocatedImage{
+        vk::Image image;
+        vk::DeviceMemory imageMemory;
+        vk::ImageView view;
+        vk::Format format;
+        vk::Extent2D extent;
+        uint32_t mipLevels;
+    };
+
+    export [[nodiscard]] inline auto
+    make_image_view(vk::Device device, vk::Image image, vk::Format format, vk::ImageAspectFlags aspect, uint32_t baseMipLevel, uint32_t levelCount) noexcept -> std::expected<vk::ImageView, EmptyErr> {
+        vk::ImageViewCreateInfo createInfo = {};
+        createInfo.flags = vk::ImageViewCreateFlags();
+        createInfo.image = image;
+        createInfo.viewType = vk::ImageViewType::e2D;
+        createInfo.format = format;
+        createInfo.components.r = vk::ComponentSwizzle::eIdentity;
+        createInfo.components.g = vk::ComponentSwizzle::eIdentity;
+        createInfo.components.b = vk::ComponentSwizzle::eIdentity;
+        createInfo.components.a = vk::ComponentSwizzle::eIdentity;
+        createInfo.subresourceRange.aspectMask = aspect;
+        createInfo.subresourceRange.baseMipLevel = baseMipLevel;
+        createInfo.subresourceRange.levelCount = levelCount;
+        createInfo.subresourceRange.baseArrayLayer = 0;
+        createInfo.subresourceRange.layerCount = 1;
+
+        vk::ResultValue<vk::ImageView> viewR = device.createImageView(createInfo);
+        if (viewR.result != vk::Result::eSuccess){
+            errprintDebug("failed to create image view");
+            return std::unexpected(EmptyErr{});
+        }
+        return viewR.value;
+    }
+
+    export [[nodiscard]] inline auto
+    make_image(const ImageInput& input) noexcept -> std::expected<AllocatedImage, EmptyErr> {
+        vk::ImageCreateInfo imageInfo = {};
+        imageInfo.flags = vk::ImageCreateFlags();
+        imageInfo.imageType = vk::ImageType::e2D;
+        imageInfo.format = input.format;
+        imageInfo.extent = vk::Extent3D(input.extent.width, input.extent.height, 1);
+        imageInfo.mipLevels = input.mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.samples = vk::SampleCountFlagBits::e1;
+        imageInfo.tiling = vk::ImageTiling::eOptimal;
+        imageInfo.usage = input.usage;
+        imageInfo.sharingMode = vk::SharingMode::eExclusive;
+        imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+
+        AllocatedImage out = {};
+        out.format = input.format;
+        out.extent = input.extent;
+        out.mipLevels = input.mipLevels;
+
+        vk::ResultValue<vk::Image> imageR = input.device.createImage(imageInfo);
+        if (imageR.result != vk::Result::eSuccess){
+            errprintDebug("failed to create image");
+            return std::unexpected(EmptyErr{});
+        }
+        out.image = imageR.value;
+
+        vk::MemoryRequirements requirements = input.device.getImageMemoryRequirements(out.image);
+        auto memoryTypeIndexRes = findMemoryTypeIndex(input.physicalDevice, requirements.memoryTypeBits, input.properties);
+        if (!memoryTypeIndexRes){
+            input.device.destroyImage(out.image);
+            return std::unexpected(EmptyErr{});
+        }
+        vk::MemoryAllocateInfo allocInfo = {};
+        allocInfo.allocationSize = requirements.size;
+        allocInfo.memoryTypeIndex = memoryTypeIndexRes.value();
+        vk::ResultValue<vk::DeviceMemory> memoryR = input.device.allocateMemory(allocInfo);
+        if (memoryR.result != vk::Result::eSuccess){
+            errprintDebug("failed to allocate image memory");
+            input.device.destroyImage(out.image);
+            return std::unexpected(EmptyErr{});
+        }
+        out.imageMemory = memoryR.value;
+        if (input.device.bindImageMemory(out.image, out.imageMemory, 0) != vk::Result::eSuccess){
+            input.device.freeMemory(out.imageMemory);
+            input.device.destroyImage(out.image);
+            return std::unexpected(EmptyErr{});
+        }
+
+        auto viewRes = make_image_view(input.device, out.image, input.format, input.aspect, 0, input.mipLevels);
+        if (!viewRes){
+            input.device.freeMemory(out.imageMemory);
+            input.device.destroyImage(out.image);
+            return std::unexpected(EmptyErr{});
+        }
+        out.view = viewRes.value();
+        return out;
+    }
+
+    export inline auto
+    destroy_image(vk::Device device, AllocatedImage& image) noexcept -> void {
+        device.destroyImageView(image.view);
+        device.destroyImage(image.image);
+        device.freeMemory(image.imageMemory);
+        image = {};
+    }
+
+    ///returns the first depth only format usable both as attachment and as a sampled image.
+    ///formats with stencil are skipped so a single depth aspect view serves both uses
+    export [[nodiscard]] inline auto
+    find_depth_format(vk::PhysicalDevice physicalDevice) noexcept -> std::expected<vk::Format, EmptyErr> {
+        const vk::Format candidates[] = {
+            vk::Format::eD32Sfloat,
+            vk::Format::eD16Unorm,
+        };
+        const vk::FormatFeatureFlags required =
+            vk::FormatFeatureFlagBits::eDepthStencilAttachment | vk::FormatFeatureFlagBits::eSampledImage;
+        for (vk::Format format : candidates){
+            vk::FormatProperties properties = physicalDevice.getFormatProperties(format);
+            if ((properties.optimalTilingFeatures & required) == required)
+                return format;
+        }
+        errprintDebug("no supported depth format");
+        return std::unexpected(EmptyErr{});
+    }
+}
@@ -0,0 +1,75 @@
+export module vulkan_lib.instanceFormat;
+
+import <cstring>;
+import <span>;
+import <string>;
+import <glm/glm.hpp>;
+import <glm/gtc/packing.hpp>;
+import <glm/gtc/quaternion.hpp>;
+
+namespace vkl {
+
+    ///how one instance transform is stored in the model buffer. every format is
+    ///a whole number of vec4 words and is decoded by instance_transform() in
+    ///instance_format.glsl, the shaders of a pipeline are built for one of them.
+    export enum class InstanceFormat {
+        Matrix,        // 64 bytes, full mat4
+        Affine,        // 48 bytes, top three rows of the matrix
+        QuatScale,     // 32 bytes, position, uniform scale and rotation
+        QuatScaleHalf, // 16 bytes, the same as QuatScale in half floats
+    };
+
+    export [[nodiscard]] inline auto
+    instance_words(InstanceFormat format) noexcept -> size_t {
+        switch (format) {
+        case InstanceFormat::Matrix: return 4;
+        case InstanceFormat::Affine: return 3;
+        case InstanceFormat::QuatScale: return 2;
+        case InstanceFormat::QuatScaleHalf: return 1;
+        }
+        return 4;
+    }
+
+    ///suffix compile_shader.bat gives the variants of a shader built for format
+    export [[nodiscard]] inline auto
+    shader_variant(const std::string& name, InstanceFormat format) -> std::string {
+        switch (format) {
+        case InstanceFormat::Affine: return name + "_affine.spv";
+        case InstanceFormat::QuatScale: return name + "_quat.spv";
+        case InstanceFormat::QuatScaleHalf: return name + "_quat_half.spv";
+        default: return name + ".spv";
+        }
+    }
+
+    ///writes one instance into the instance_words(format) words of out
+    export inline void
+    encode_instance(InstanceFormat format, std::span<glm::vec4> out, const glm::vec3& position,
+        const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), float scale = 1.0f) noexcept {
+        switch (format) {
+        case InstanceFormat::Matrix:
+        case InstanceFormat::Affine: {
+            glm::mat4 model = glm::mat4_cast(rotation) * scale;
+            model[3] = glm::vec4(position, 1.0f);
+            if (format == InstanceFormat::Matrix) {
+                for (int column = 0; column < 4; column++)
+                    out[column] = model[column];
+                return;
+            }
+            glm::mat4 rows = glm::transpose(model);
+            for (int row = 0; row < 3; row++)
+                out[row] = rows[row];
+            return;
+        }
+        case InstanceFormat::QuatScale:
+            out[0] = glm::vec4(position, scale);
+            out[1] = glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w);
+            return;
+        case InstanceFormat::QuatScaleHalf: {
+            glm::uvec4 halves(glm::packHalf2x16(glm::vec2(position.x, position.y)), glm::packHalf2x16(glm::vec2(position.z, scale)),
+                glm::packHalf2x16(glm::vec2(rotation.x, rotation.y)), glm::packHalf2x16(glm::vec2(rotation.z, rotation.w)));
+            std::memcpy(&out[0], &halves, sizeof(halves));
+            return;
+        }
+        }
+    }
+}
@@ -0,0 +1,243 @@
+module vulkan_lib.jobSystem;
+
+import <algorithm>;
+
+namespace vkl {
+
+    //the queue the calling thread owns, threads outside the pool use the shared one
+    thread_local const JobSystem* currentSystem = nullptr;
+    thread_local uint32_t currentQueue = 0;
+
+    JobCounter::JobCounter() : pending(0) {
+    }
+
+    [[nodiscard]] bool JobCounter::done() const noexcept {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+    JobSystem::JobSystem(uint32_t workers) : queued(0), backgroundQueued(0), backgroundRunning(0), backgroundLimit(1),
+        stopping(false), executed(0), stolen(0), mainExecuted(0), backgroundExecuted(0) {
+        if (workers == 0)
+            workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        workers = std::max(1u, workers);
+        //the other half stays free for the frame's jobs
+        backgroundLimit = std::max(1u, workers / 2);
+        for (uint32_t i = 0; i <= workers; i++)
+            queues.push_back(std::make_unique<Queue>());
+        for (uint32_t i = 0; i < workers; i++)
+            threads.emplace_back([this, i]() { worker_loop(i); });
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+    }
+
+    void JobSystem::submit(Job job, JobCounter* counter) {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        push({ std::move(job), counter });
+    }
+
+    void JobSystem::submit_background(Job job, JobCounter* counter) {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> guard(background.lock);
+            background.tasks.push_back({ std::move(job), counter });
+        }
+        backgroundQueued.fetch_add(1, std::memory_order_release);
+        { std::lock_guard<std::mutex> guard(sleepLock); }
+        wake.notify_one();
+    }
+
+    void JobSystem::submit_after(JobCounter& dependency, Job job, JobCounter* counter) {
+        if (counter)
+            counter->pending.fetch_add(1, std::memory_order_relaxed);
+        Task task = { std::move(job), counter };
+        {
+            std::lock_guard<std::mutex> guard(dependency.lock);
+            if (dependency.pending.load(std::memory_order_acquire) != 0) {
+                //the counter is raised already, finish submits it without raising it again
+                dependency.continuations.push_back([this, task]() mutable { push(std::move(task)); });
+                return;
+            }
+        }
+        push(std::move(task));
+    }
+
+    void JobSystem::submit_main(Job job) {
+        std::lock_guard<std::mutex> guard(mainLock);
+        mainJobs.push_back(std::move(job));
+    }
+
+    void JobSystem::run_main_jobs() {
+        std::vector<Job> jobs;
+        {
+            std::lock_guard<std::mutex> guard(mainLock);
+            jobs.swap(mainJobs);
+        }
+        for (Job& job : jobs)
+            job();
+        mainExecuted.fetch_add(jobs.size(), std::memory_order_relaxed);
+    }
+
+    void JobSystem::wait(JobCounter& counter) {
+        while (!counter.done()) {
+            if (!run_one())
+                std::this_thread::yield();
+        }
+        //the last finish may still hold the lock, the counter is free once it let go
+        std::lock_guard<std::mutex> guard(counter.lock);
+    }
+
+    void JobSystem::parallel_for(uint32_t first, uint32_t last, uint32_t grain,
+        const std::function<void(uint32_t first, uint32_t last)>& body) {
+        if (last <= first)
+            return;
+        const uint32_t count = last - first;
+        if (grain == 0)
+            grain = std::max(1u, count / ((worker_count() + 1) * 4));
+        if (count <= grain) {
+            body(first, last);
+            return;
+        }
+
+        JobCounter pieces;
+        for (uint32_t begin = first + grain; begin < last; begin += grain) {
+            const uint32_t end = std::min(last, begin + grain);
+            submit([&body, begin, end]() { body(begin, end); }, &pieces);
+        }
+        //the caller takes the first piece instead of waiting idle
+        body(first, first + grain);
+        wait(pieces);
+    }
+
+    [[nodiscard]] uint32_t JobSystem::worker_count() const noexcept {
+        return static_cast<uint32_t>(threads.size());
+    }
+
+    [[nodiscard]] JobStats JobSystem::stats() const noexcept {
+        return { executed.load(), stolen.load(), mainExecuted.load(), backgroundExecuted.load() };
+    }
+
+    void JobSystem::push(Task task) {
+        const uint32_t shared = static_cast<uint32_t>(queues.size() - 1);
+        Queue& queue = *queues[currentSystem == this ? currentQueue : shared];
+        {
+            std::lock_guard<std::mutex> guard(queue.lock);
+            queue.tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        //taking the lock orders this with a worker between its check and its sleep
+        { std::lock_guard<std::mutex> guard(sleepLock); }
+        wake.notify_one();
+    }
+
+    [[nodiscard]] bool JobSystem::run_one() {
+        if (queued.load(std::memory_order_acquire) == 0)
+            return false;
+        const uint32_t queueCount = static_cast<uint32_t>(queues.size());
+        const uint32_t own = currentSystem == this ? currentQueue : queueCount - 1;
+        Task task = {};
+        bool found = false;
+        {
+            Queue& queue = *queues[own];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+                found = true;
+            }
+        }
+        for (uint32_t offset = 1; offset < queueCount && !found; offset++) {
+            Queue& queue = *queues[(own + offset) % queueCount];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                found = true;
+                stolen.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (!found)
+            return false;
+        queued.fetch_sub(1, std::memory_order_relaxed);
+
+        task.job();
+        executed.fetch_add(1, std::memory_order_relaxed);
+        finish(task.counter);
+        return true;
+    }
+
+    [[nodiscard]] bool JobSystem::run_background() {
+        if (!background_runnable())
+            return false;
+        //claim a slot first, a worker that loses the race goes back to the frame's jobs
+        uint32_t running = backgroundRunning.load(std::memory_order_relaxed);
+        do {
+            if (running >= backgroundLimit)
+                return false;
+        } while (!backgroundRunning.compare_exchange_weak(running, running + 1, std::memory_order_acq_rel));
+        Task task = {};
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> guard(background.lock);
+            if (!background.tasks.empty()) {
+                //oldest first, they are independent and were asked for in order
+                task = std::move(background.tasks.front());
+                background.tasks.pop_front();
+                found = true;
+            }
+        }
+        if (found) {
+            backgroundQueued.fetch_sub(1, std::memory_order_relaxed);
+            task.job();
+            executed.fetch_add(1, std::memory_order_relaxed);
+            backgroundExecuted.fetch_add(1, std::memory_order_relaxed);
+        }
+        backgroundRunning.fetch_sub(1, std::memory_order_acq_rel);
+        if (!found)
+            return false;
+        finish(task.counter);
+        return true;
+    }
+
+    [[nodiscard]] bool JobSystem::background_runnable() const noexcept {
+        return backgroundQueued.load(std::memory_order_acquire) != 0
+            && backgroundRunning.load(std::memory_order_acquire) < backgroundLimit;
+    }
+
+    void JobSystem::finish(JobCounter* counter) {
+        if (!counter)
+            return;
+        std::vector<Job> continuations;
+        {
+            std::lock_guard<std::mutex> guard(counter->lock);
+            if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+            continuations.swap(counter->continuations);
+        }
+        for (Job& continuation : continuations)
+            continuation();
+    }
+
+    void JobSystem::worker_loop(uint32_t index) {
+        currentSystem = this;
+        currentQueue = index;
+        while (true) {
+            //the frame's jobs first, background work only fills idle time
+            if (run_one() || run_background())
+                continue;
+            std::unique_lock<std::mutex> guard(sleepLock);
+            wake.wait(guard, [this]() { return stopping.load() || queued.load() != 0 || background_runnable(); });
+            if (stopping && queued == 0 && backgroundQueued == 0)
+                return;
+        }
+    }
+}
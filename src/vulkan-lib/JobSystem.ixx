@@ -0,0 +1,129 @@
+export module vulkan_lib.jobSystem;
+
+import <atomic>;
+import <condition_variable>;
+import <deque>;
+import <functional>;
+import <memory>;
+import <mutex>;
+import <thread>;
+import <vector>;
+
+namespace vkl {
+
+    export using Job = std::function<void()>;
+
+    ///jobs still running, waited on with JobSystem::wait.
+    ///jobs submitted after it run once it reaches zero. wait on it before it is
+    ///destroyed, the last job to finish still touches it right after the count drops.
+    export class JobCounter {
+    public:
+        JobCounter();
+        JobCounter(const JobCounter& ref) = delete;
+        JobCounter& operator=(const JobCounter& ref) = delete;
+
+        [[nodiscard]] bool done() const noexcept;
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<uint32_t> pending;
+        std::mutex lock;
+        std::vector<Job> continuations;
+    };
+
+    export struct JobStats {
+        uint64_t executed;
+        ///jobs a thread took from another thread's queue
+        uint64_t stolen;
+        uint64_t mainThread;
+        ///jobs that ran from the background queue
+        uint64_t background;
+    };
+
+    ///work stealing scheduler.
+    ///
+    ///every worker owns a deque, it pushes and pops its own jobs at the back and
+    ///steals from the front of the others when it runs dry, so a worker keeps
+    ///working on what it just split while the oldest and biggest pieces move to
+    ///idle threads. threads outside the pool push to a shared queue the workers
+    ///steal from. waiting never blocks a thread that could run jobs, wait runs
+    ///queued jobs until the counter drops, so jobs may wait on jobs they submit.
+    ///
+    ///jobs that must run on the thread that owns the window are queued apart
+    ///with submit_main and run when that thread calls run_main_jobs.
+    ///
+    ///long jobs nobody waits on within a frame, like pipeline compiles, go to
+    ///the background queue with submit_background. only idle workers take them,
+    ///at most half the pool at once, and wait and parallel_for never do, so a
+    ///thread waiting on a few short pieces does not end up running a compile.
+    export class JobSystem {
+    public:
+        ///workers of 0 leaves one hardware thread to the caller
+        explicit JobSystem(uint32_t workers = 0);
+        ~JobSystem();
+        JobSystem(const JobSystem& ref) = delete;
+        JobSystem& operator=(const JobSystem& ref) = delete;
+
+        ///counter, when given, is raised now and dropped once job ran
+        void submit(Job job, JobCounter* counter = nullptr);
+        ///queues job behind the frame's work, counter as for submit
+        void submit_background(Job job, JobCounter* counter = nullptr);
+        ///job is submitted once dependency reaches zero, right away if it already did
+        void submit_after(JobCounter& dependency, Job job, JobCounter* counter = nullptr);
+        ///runs job on the next run_main_jobs call
+        void submit_main(Job job);
+        ///runs the main thread jobs queued so far, only from the thread that owns the window
+        void run_main_jobs();
+        ///runs queued jobs on the calling thread until counter reaches zero.
+        ///background jobs are left to the workers, waiting on one only yields
+        void wait(JobCounter& counter);
+
+        ///calls body over [first, last) in pieces of grain items, grain 0 splits in
+        ///a few pieces per thread. returns once every piece ran, the caller runs some
+        void parallel_for(uint32_t first, uint32_t last, uint32_t grain, const std::function<void(uint32_t first, uint32_t last)>& body);
+
+        ///worker threads, the calling thread helps on top of them
+        [[nodiscard]] uint32_t worker_count() const noexcept;
+        [[nodiscard]] JobStats stats() const noexcept;
+
+    private:
+        struct Task {
+            Job job;
+            JobCounter* counter;
+        };
+
+        struct Queue {
+            std::mutex lock;
+            std::deque<Task> tasks;
+        };
+
+        void push(Task task);
+        [[nodiscard]] bool run_one();
+        [[nodiscard]] bool run_background();
+        [[nodiscard]] bool background_runnable() const noexcept;
+        void finish(JobCounter* counter);
+        void worker_loop(uint32_t index);
+
+        ///one per worker then the shared one
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> threads;
+        std::atomic<uint32_t> queued;
+        Queue background;
+        std::atomic<uint32_t> backgroundQueued;
+        std::atomic<uint32_t> backgroundRunning;
+        ///workers that may run background jobs at once
+        uint32_t backgroundLimit;
+        std::atomic<bool> stopping;
+        std::mutex sleepLock;
+        std::condition_variable wake;
+
+        std::mutex mainLock;
+        std::vector<Job> mainJobs;
+
+        std::atomic<uint64_t> executed;
+        std::atomic<uint64_t> stolen;
+        std::atomic<uint64_t> mainExecuted;
+        std::atomic<uint64_t> backgroundExecuted;
+    };
+}
@@ -5,8 +5,10 @@ module;
 export module vulkan_lib.memory;
 
 import vulkan_lib.result;
+import <algorithm>;
 import <expected>;
 import <iostream>;
+import <span>;
 
 export namespace vkUtil{
 
@@ -16,6 +18,9 @@ export namespace vkUtil{
         size_t size;
         vk::BufferUsageFlags usage;
         vk::MemoryPropertyFlags properties;
+        ///distinct families that use the buffer. with more than one it is shared
+        ///concurrently and needs no ownership transfer, else it stays exclusive
+        std::span<const uint32_t> queueFamilies;
     };
 
 
@@ -48,6 +53,9 @@ export namespace vkUtil{
         vk::Buffer dstBuffer;
         vk::Buffer srcBuffer;
         vk::BufferCopy region;
+        ///the queue's timeline semaphore, signaled to signalValue once the copy is done
+        vk::Semaphore timeline;
+        uint64_t signalValue;
     };
 
     export [[nodiscard]] inline std::expected<uint32_t, EmptyErr > findMemoryTypeIndex(vk::PhysicalDevice physicalDevice,  uint32_t supportedMemoryIndices, vk::MemoryPropertyFlags requestedProperties)noexcept{
@@ -102,6 +110,11 @@ export namespace vkUtil{
         bufferInfo.size = bufferInput.size;
         bufferInfo.usage = bufferInput.usage;
         bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+        if (bufferInput.queueFamilies.size() > 1) {
+            bufferInfo.sharingMode = vk::SharingMode::eConcurrent;
+            bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(bufferInput.queueFamilies.size());
+            bufferInfo.pQueueFamilyIndices = bufferInput.queueFamilies.data();
+        }
 
         Buffer buffer = Buffer::init();
         if (bufferInput.device.createBuffer(&bufferInfo,nullptr, &buffer.buffer) != vk::Result::eSuccess){
@@ -129,6 +142,91 @@ export namespace vkUtil{
     }
 
 
+    ///host visible storage for an array of T that grows geometrically on demand.
+    ///stays mapped over its whole range so producers write straight into it
+    ///through span(). growing drops the contents, the caller has to make sure
+    ///the gpu is done with the old buffer.
+    export template<typename T>
+    class GrowableBuffer {
+    public:
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make(vk::Device device, vk::PhysicalDevice physicalDevice,
+            vk::BufferUsageFlags usage, size_t capacity) noexcept {
+            this->device = device;
+            this->physicalDevice = physicalDevice;
+            this->usage = usage;
+            return allocate(capacity);
+        }
+
+        ///true when the buffer was replaced and descriptors pointing at it are stale
+        [[nodiscard]] std::expected<bool, EmptyErr> reserve(size_t count) noexcept {
+            if (count <= elementCapacity)
+                return false;
+            size_t grown = std::max(count, elementCapacity * 2);
+            destroy();
+            if (!allocate(grown))
+                return std::unexpected(EmptyErr{});
+            return true;
+        }
+
+        [[nodiscard]] std::span<T> span(size_t count) const noexcept {
+            return std::span<T>(writeLocation, std::min(count, elementCapacity));
+        }
+
+        [[nodiscard]] vk::DescriptorBufferInfo descriptor() const noexcept {
+            return vk::DescriptorBufferInfo(buffer.buffer, 0, elementCapacity * sizeof(T));
+        }
+
+        [[nodiscard]] size_t capacity() const noexcept {
+            return elementCapacity;
+        }
+
+        void destroy() noexcept {
+            if (!buffer.buffer)
+                return;
+            device.unmapMemory(buffer.bufferMemory);
+            device.freeMemory(buffer.bufferMemory);
+            device.destroyBuffer(buffer.buffer);
+            buffer = {};
+            writeLocation = nullptr;
+            elementCapacity = 0;
+        }
+
+    private:
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> allocate(size_t capacity) noexcept {
+            BufferInput input = {};
+            input.device = device;
+            input.physicalDevice = physicalDevice;
+            input.size = capacity * sizeof(T);
+            input.usage = usage;
+            input.properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+            auto bufferRes = createBuffer(input);
+            if (!bufferRes)
+                return std::unexpected(EmptyErr{});
+            buffer = bufferRes.value();
+
+            vk::ResultValue<void *> memoryLocationR = device.mapMemory(buffer.bufferMemory, 0, input.size);
+            if (memoryLocationR.result != vk::Result::eSuccess){
+                if constexpr(_DEBUG)
+                    std::cerr << "failed to map memory\n";
+                device.freeMemory(buffer.bufferMemory);
+                device.destroyBuffer(buffer.buffer);
+                buffer = {};
+                return std::unexpected(EmptyErr{});
+            }
+            writeLocation = static_cast<T*>(memoryLocationR.value);
+            elementCapacity = capacity;
+            return EmptyOk{};
+        }
+
+        vk::Device device;
+        vk::PhysicalDevice physicalDevice;
+        vk::BufferUsageFlags usage;
+        Buffer buffer = {};
+        T* writeLocation = nullptr;
+        size_t elementCapacity = 0;
+    };
+
+    ///submits the copy without waiting for it, cmdBuffer must not be pending
     export [[nodiscard]] inline auto
     copyBuffer(CopyBufferInput input) -> std::expected<EmptyOk, EmptyErr> {
         if (input.cmdBuffer.reset() != vk::Result::eSuccess){
@@ -147,19 +245,19 @@ export namespace vkUtil{
         input.cmdBuffer.copyBuffer(input.srcBuffer, input.dstBuffer, 1, &input.region); 
         if (input.cmdBuffer.end() != vk::Result::eSuccess)
             return std::unexpected(EmptyErr{});
-        vk::SubmitInfo submitInfo ={};
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &input.cmdBuffer;
-        if (input.queue.submit(1, &submitInfo, nullptr) != vk::Result::eSuccess){
+        vk::CommandBufferSubmitInfo commandInfo = {};
+        commandInfo.commandBuffer = input.cmdBuffer;
+        vk::SemaphoreSubmitInfo signalInfo(input.timeline, input.signalValue, vk::PipelineStageFlagBits2::eCopy);
+        vk::SubmitInfo2 submitInfo = {};
+        submitInfo.commandBufferInfoCount = 1;
+        submitInfo.pCommandBufferInfos = &commandInfo;
+        submitInfo.signalSemaphoreInfoCount = 1;
+        submitInfo.pSignalSemaphoreInfos = &signalInfo;
+        if (input.queue.submit2(submitInfo, nullptr) != vk::Result::eSuccess){
             if constexpr (_DEBUG)
                 std::cerr << "failed to submit cmdbuffer\n";
             return std::unexpected(EmptyErr{});
         }
-        if (input.queue.waitIdle() != vk::Result::eSuccess){
-            if constexpr(_DEBUG)
-                std::cerr << "failed to wait for transfer queue to finish\n";
-            return std::unexpected(EmptyErr{});
-        }
         return EmptyOk{};
     }
 }
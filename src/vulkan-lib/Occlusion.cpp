@@ -0,0 +1,294 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.occlusion;
+
+import <algorithm>;
+import <cstring>;
+import <string>;
+import <vector>;
+import vulkan_lib.descriptors;
+import vulkan_lib.logging;
+import vulkan_lib.pipeline;
+import vulkan_lib.reflection;
+
+namespace vkl {
+
+    constexpr uint32_t groupSize = 64;
+    ///constant_id of local_size_x in occlusion_cull.comp
+    constexpr uint32_t groupSizeConstant = 0;
+    constexpr uint32_t earlyPhase = 0;
+    constexpr uint32_t latePhase = 1;
+
+    OcclusionCuller::OcclusionCuller() : framesInFlight(0), instanceCapacity(0), sceneCapacity(0), counterReadLocation(nullptr) {
+    }
+
+    OcclusionCuller::~OcclusionCuller() {
+        destroy_frame_resources();
+        device.destroyPipeline(pipeline);
+        device.destroyPipelineLayout(layout);
+
+        device.unmapMemory(counterBuffer.bufferMemory);
+        destroy_instance_buffers();
+        for (vkUtil::Buffer* buffer : { &drawCommandBuffer, &counterBuffer }) {
+            device.destroyBuffer(buffer->buffer);
+            device.freeMemory(buffer->bufferMemory);
+        }
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> OcclusionCuller::make_pipelines(vk::Device device,
+        vk::PhysicalDevice physicalDevice, uint32_t framesInFlight, InstanceFormat instanceFormat, DescriptorLayoutCache& layouts,
+        PipelineCache& pipelineCache, ShaderLibrary& shaders, const vk::detail::DispatchLoaderDynamic& dispatch) noexcept {
+        this->device = device;
+        this->physicalDevice = physicalDevice;
+        this->framesInFlight = framesInFlight;
+
+        //model transforms, visibility of last frame, draw list, indirect draw commands,
+        //counters, the depth pyramid and the scene indices, as the shader declares them
+        const std::string filepath = shader_variant("occlusion_cull", instanceFormat);
+        auto reflection_res = vkInit::reflect_file(shaders, filepath);
+        if (!reflection_res)
+            return std::unexpected(EmptyErr{});
+        if (reflection_res.value().pushConstantSize > sizeof(PushConstants)) {
+            vkInit::errprintDebug("occlusion cull shader reads more push constants than are pushed");
+            return std::unexpected(EmptyErr{});
+        }
+        const vkInit::DescriptorSetLayoutData bindings = reflection_res.value().set_layout(0);
+        auto descriptor_set_layout_res = layouts.get(bindings);
+        if (!descriptor_set_layout_res)
+            return std::unexpected(EmptyErr{});
+        descriptorSetLayout = descriptor_set_layout_res.value();
+
+        vkInit::ComputePipelineBundle specs = {};
+        specs.device = device;
+        specs.filepath = filepath;
+        specs.descriptorSetLayout = descriptorSetLayout;
+        specs.pushConstantSize = sizeof(PushConstants);
+        specs.constants.set(groupSizeConstant, groupSize);
+        specs.pipelineCache = &pipelineCache;
+        specs.shaderLibrary = &shaders;
+        auto compute_pipeline_res = vkInit::make_compute_pipeline(specs);
+        if (!compute_pipeline_res)
+            return std::unexpected(EmptyErr{});
+        pipeline = compute_pipeline_res.value().pipeline;
+        layout = compute_pipeline_res.value().layout;
+
+        if (!pyramid.make_pipeline(device, layouts, pipelineCache, shaders, dispatch))
+            return std::unexpected(EmptyErr{});
+
+        if (!make_draw_list(initialCapacity) || !make_visibility(initialCapacity))
+            return std::unexpected(EmptyErr{});
+
+        vkUtil::BufferInput input = {};
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+
+        input.size = sizeof(vk::DrawIndirectCommand) * 2;
+        input.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eTransferDst;
+        auto draw_command_res = vkUtil::createBuffer(input);
+        if (!draw_command_res)
+            return std::unexpected(EmptyErr{});
+        drawCommandBuffer = draw_command_res.value();
+
+        input.properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        input.size = sizeof(OcclusionStats) * framesInFlight;
+        input.usage = vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst;
+        auto counter_res = vkUtil::createBuffer(input);
+        if (!counter_res)
+            return std::unexpected(EmptyErr{});
+        counterBuffer = counter_res.value();
+        vk::ResultValue<void*> counterMapR = device.mapMemory(counterBuffer.bufferMemory, 0, input.size);
+        if (counterMapR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("Failed to map memory");
+            return std::unexpected(EmptyErr{});
+        }
+        counterReadLocation = static_cast<OcclusionStats*>(counterMapR.value);
+        memset(counterReadLocation, 0, input.size);
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> OcclusionCuller::make_frame_resources(std::vector<vkInit::SwapchainFrame>& frames,
+        vk::ImageView depthView, vk::Extent2D depthExtent, DescriptorAllocator& descriptors, DescriptorWriteCache& descriptorCache) noexcept {
+        if (!pyramid.make_resources(physicalDevice, depthView, depthExtent))
+            return std::unexpected(EmptyErr{});
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            auto descriptor_set_res = descriptors.allocate(descriptorSetLayout);
+            if (!descriptor_set_res)
+                return std::unexpected(EmptyErr{});
+            descriptorSets.push_back(descriptor_set_res.value());
+        }
+        write_descriptor_sets(frames, descriptorCache);
+        return EmptyOk{};
+    }
+
+    void OcclusionCuller::write_descriptor_sets(const std::vector<vkInit::SwapchainFrame>& frames, DescriptorWriteCache& descriptorCache) noexcept {
+        vk::DescriptorBufferInfo visibilityInfo(visibilityBuffer.buffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo drawListInfo(drawListBuffer.buffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo drawCommandInfo(drawCommandBuffer.buffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo counterInfo(counterBuffer.buffer, 0, VK_WHOLE_SIZE);
+        vk::DescriptorImageInfo pyramidInfo(pyramid.sampler, pyramid.image.view, vk::ImageLayout::eGeneral);
+
+        for (size_t frameIndex = 0; frameIndex < frames.size(); frameIndex++) {
+            vk::DescriptorSet set = descriptorSets[frameIndex];
+            const vk::DescriptorBufferInfo* bufferInfos[] = {
+                &frames[frameIndex].modelBufferDescriptor, &visibilityInfo, &drawListInfo, &drawCommandInfo, &counterInfo
+            };
+            for (uint32_t i = 0; i < 5; i++)
+                descriptorCache.write_buffer(set, i, vk::DescriptorType::eStorageBuffer, *bufferInfos[i]);
+            descriptorCache.write_image(set, 5, vk::DescriptorType::eCombinedImageSampler, pyramidInfo);
+            descriptorCache.write_buffer(set, 6, vk::DescriptorType::eStorageBuffer, frames[frameIndex].sceneIdDescriptor);
+        }
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> OcclusionCuller::make_draw_list(uint32_t capacity) noexcept {
+        vkUtil::BufferInput input = {};
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+        input.size = capacity * sizeof(uint32_t) * 2;
+        input.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+        auto draw_list_res = vkUtil::createBuffer(input);
+        if (!draw_list_res)
+            return std::unexpected(EmptyErr{});
+        drawListBuffer = draw_list_res.value();
+        instanceCapacity = capacity;
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> OcclusionCuller::make_visibility(uint32_t capacity) noexcept {
+        //nothing new was visible before, the late phase draws it
+        std::vector<uint32_t> visible(capacity, 0);
+        if (visibilityBuffer.buffer) {
+            const vk::DeviceSize kept = sceneCapacity * sizeof(uint32_t);
+            vk::ResultValue<void*> mapped = device.mapMemory(visibilityBuffer.bufferMemory, 0, kept);
+            if (mapped.result != vk::Result::eSuccess) {
+                vkInit::errprintDebug("Failed to map memory");
+                return std::unexpected(EmptyErr{});
+            }
+            memcpy(visible.data(), mapped.value, kept);
+            device.unmapMemory(visibilityBuffer.bufferMemory);
+            device.destroyBuffer(visibilityBuffer.buffer);
+            device.freeMemory(visibilityBuffer.bufferMemory);
+            visibilityBuffer = {};
+        }
+
+        vkUtil::BufferInput input = {};
+        input.device = device;
+        input.physicalDevice = physicalDevice;
+        input.properties = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        input.size = capacity * sizeof(uint32_t);
+        input.usage = vk::BufferUsageFlagBits::eStorageBuffer;
+        auto visibility_res = vkUtil::createBuffer(input);
+        if (!visibility_res)
+            return std::unexpected(EmptyErr{});
+        visibilityBuffer = visibility_res.value();
+        if (!vkUtil::mapBuffer(device, visibilityBuffer, visible.data(), 0, static_cast<uint32_t>(input.size)))
+            return std::unexpected(EmptyErr{});
+        sceneCapacity = capacity;
+        return EmptyOk{};
+    }
+
+    void OcclusionCuller::destroy_instance_buffers() noexcept {
+        for (vkUtil::Buffer* buffer : { &visibilityBuffer, &drawListBuffer }) {
+            device.destroyBuffer(buffer->buffer);
+            device.freeMemory(buffer->bufferMemory);
+            *buffer = {};
+        }
+        instanceCapacity = 0;
+        sceneCapacity = 0;
+    }
+
+    [[nodiscard]] std::expected<bool, EmptyErr> OcclusionCuller::reserve(uint32_t count, uint32_t sceneCount) noexcept {
+        bool replaced = false;
+        if (count > instanceCapacity) {
+            device.destroyBuffer(drawListBuffer.buffer);
+            device.freeMemory(drawListBuffer.bufferMemory);
+            drawListBuffer = {};
+            if (!make_draw_list(std::max(count, instanceCapacity * 2)))
+                return std::unexpected(EmptyErr{});
+            replaced = true;
+        }
+        if (sceneCount > sceneCapacity) {
+            if (!make_visibility(std::max(sceneCount, sceneCapacity * 2)))
+                return std::unexpected(EmptyErr{});
+            replaced = true;
+        }
+        return replaced;
+    }
+
+    [[nodiscard]] uint32_t OcclusionCuller::capacity() const noexcept {
+        return instanceCapacity;
+    }
+
+    [[nodiscard]] uint32_t OcclusionCuller::scene_capacity() const noexcept {
+        return sceneCapacity;
+    }
+
+    void OcclusionCuller::destroy_frame_resources() noexcept {
+        descriptorSets.clear();
+        pyramid.destroy_resources();
+    }
+
+    void OcclusionCuller::dispatch(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameNumber,
+        const CullInput& input, uint32_t phase) noexcept {
+        PushConstants constants = {};
+        constants.viewProjection = input.viewProjection;
+        constants.localSphere = input.localSphere;
+        constants.instanceCount = std::min(input.instanceCount, instanceCapacity);
+        constants.phase = phase;
+        constants.counterSlot = frameNumber % framesInFlight;
+        constants.lateListOffset = instanceCapacity;
+        constants.pyramidSize = glm::vec2(pyramid.image.extent.width, pyramid.image.extent.height);
+
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, layout, 0, descriptorSets[imageIndex], nullptr);
+        commandBuffer.pushConstants(layout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(PushConstants), &constants);
+        commandBuffer.dispatch((constants.instanceCount + groupSize - 1) / groupSize, 1, 1);
+    }
+
+    void OcclusionCuller::record_early(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameNumber,
+        const CullInput& input) noexcept {
+        vk::DrawIndirectCommand commands[2] = {};
+        commands[0] = vk::DrawIndirectCommand(input.vertexCount, 0, input.firstVertex, 0);
+        commands[1] = vk::DrawIndirectCommand(input.vertexCount, 0, input.firstVertex, instanceCapacity);
+        commandBuffer.updateBuffer(drawCommandBuffer.buffer, 0, sizeof(commands), commands);
+        commandBuffer.fillBuffer(counterBuffer.buffer, (frameNumber % framesInFlight) * sizeof(OcclusionStats), sizeof(OcclusionStats), 0);
+
+        vk::MemoryBarrier cleared = {};
+        cleared.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        cleared.dstAccessMask = vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite;
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(), cleared, nullptr, nullptr);
+
+        dispatch(commandBuffer, imageIndex, frameNumber, input, earlyPhase);
+    }
+
+    void OcclusionCuller::record_pyramid(vk::CommandBuffer commandBuffer) noexcept {
+        pyramid.record_build(commandBuffer);
+    }
+
+    void OcclusionCuller::record_late(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameNumber,
+        const CullInput& input) noexcept {
+        dispatch(commandBuffer, imageIndex, frameNumber, input, latePhase);
+    }
+
+    [[nodiscard]] vk::Buffer OcclusionCuller::draw_command_buffer() const noexcept {
+        return drawCommandBuffer.buffer;
+    }
+
+    [[nodiscard]] vk::DeviceSize OcclusionCuller::draw_command_offset(bool late) noexcept {
+        return late ? sizeof(vk::DrawIndirectCommand) : 0;
+    }
+
+    [[nodiscard]] OcclusionStats OcclusionCuller::stats(uint32_t frameNumber) const noexcept {
+        return counterReadLocation[frameNumber % framesInFlight];
+    }
+
+    [[nodiscard]] vk::DescriptorBufferInfo OcclusionCuller::draw_list_descriptor() const noexcept {
+        return vk::DescriptorBufferInfo(drawListBuffer.buffer, 0, VK_WHOLE_SIZE);
+    }
+}
@@ -0,0 +1,132 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.occlusion;
+
+import <expected>;
+import <vector>;
+import <glm/glm.hpp>;
+import vulkan_lib.depthPyramid;
+import vulkan_lib.instanceFormat;
+import vulkan_lib.memory;
+import vulkan_lib.swapchainFrame;
+import vulkan_lib.descriptorCache;
+import vulkan_lib.descriptorAllocator;
+import vulkan_lib.pipelineCache;
+import vulkan_lib.shaderLibrary;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    ///gpu counters of one cull, read back once the frame's timeline value completed
+    export struct OcclusionStats {
+        uint32_t tested;
+        uint32_t frustumRejected;
+        uint32_t occlusionRejected;
+        uint32_t earlyDrawn;
+        uint32_t lateDrawn;
+    };
+
+    ///what is culled this frame: instanceCount transforms from the frame's
+    ///model buffer, all drawing the same mesh
+    export struct CullInput {
+        glm::mat4 viewProjection;
+        glm::vec4 localSphere;
+        uint32_t instanceCount;
+        uint32_t vertexCount;
+        uint32_t firstVertex;
+    };
+
+    ///two phase hierarchical z culling.
+    ///early: instances visible last frame are frustum tested and drawn.
+    ///the depth they leave is reduced into the pyramid.
+    ///late: every instance is tested against the new pyramid, the ones that
+    ///became visible are drawn on top and the visibility is kept for next frame.
+    ///
+    ///both phases append instance indices to one draw list read by the vertex
+    ///shader through gl_InstanceIndex, the late list starts at capacity() so
+    ///it only differs from the early one by firstInstance.
+    ///
+    ///the model buffer only holds the instances that passed the frustum test,
+    ///in a different order every frame. visibility is kept per scene instance,
+    ///looked up through the frame's scene index buffer, so it is sized by the
+    ///scene and not by the instances culled.
+    export class OcclusionCuller {
+    public:
+        static constexpr uint32_t initialCapacity = 1024;
+
+        OcclusionCuller();
+        ~OcclusionCuller();
+        OcclusionCuller(const OcclusionCuller& ref) = delete;
+        OcclusionCuller& operator=(const OcclusionCuller& ref) = delete;
+
+        ///the cull shader reads transforms stored in instanceFormat, dispatch
+        ///pushes the pyramid's descriptors
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_pipelines(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t framesInFlight,
+            InstanceFormat instanceFormat, DescriptorLayoutCache& layouts, PipelineCache& pipelineCache,
+            ShaderLibrary& shaders, const vk::detail::DispatchLoaderDynamic& dispatch) noexcept;
+        ///per swapchain image sets and the pyramid, rebuilt with the swapchain.
+        ///the sets come from descriptors and go when it is reset
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_frame_resources(std::vector<vkInit::SwapchainFrame>& frames, vk::ImageView depthView, vk::Extent2D depthExtent,
+            DescriptorAllocator& descriptors, DescriptorWriteCache& descriptorCache) noexcept;
+        void destroy_frame_resources() noexcept;
+        ///grows the draw list to hold count instances and the visibility to hold sceneCount,
+        ///true when either was replaced. the gpu must be done with them and every set written
+        ///again after it. the visibility of instances already in the scene is kept
+        [[nodiscard]] std::expected<bool, EmptyErr> reserve(uint32_t count, uint32_t sceneCount) noexcept;
+        void write_descriptor_sets(const std::vector<vkInit::SwapchainFrame>& frames, DescriptorWriteCache& descriptorCache) noexcept;
+        [[nodiscard]] uint32_t capacity() const noexcept;
+        [[nodiscard]] uint32_t scene_capacity() const noexcept;
+
+        ///the phases only synchronize inside themselves, the render graph orders them
+        ///against each other and against the draws
+        void record_early(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameNumber, const CullInput& input) noexcept;
+        ///builds the pyramid from the depth buffer, which must be in shader read only layout
+        void record_pyramid(vk::CommandBuffer commandBuffer) noexcept;
+        void record_late(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameNumber, const CullInput& input) noexcept;
+        ///the vk::DrawIndirectCommand each phase writes, early then late
+        [[nodiscard]] vk::Buffer draw_command_buffer() const noexcept;
+        [[nodiscard]] static vk::DeviceSize draw_command_offset(bool late) noexcept;
+
+        ///counters of the last submission that used frameNumber, only valid once its timeline value completed
+        [[nodiscard]] OcclusionStats stats(uint32_t frameNumber) const noexcept;
+        [[nodiscard]] vk::DescriptorBufferInfo draw_list_descriptor() const noexcept;
+
+    private:
+        struct PushConstants {
+            glm::mat4 viewProjection;
+            glm::vec4 localSphere;
+            uint32_t instanceCount;
+            uint32_t phase;
+            uint32_t counterSlot;
+            uint32_t lateListOffset;
+            glm::vec2 pyramidSize;
+        };
+
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_draw_list(uint32_t capacity) noexcept;
+        ///copies what the old buffer held, the instances added are hidden
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make_visibility(uint32_t capacity) noexcept;
+        void destroy_instance_buffers() noexcept;
+        void dispatch(vk::CommandBuffer commandBuffer, uint32_t imageIndex, uint32_t frameNumber, const CullInput& input, uint32_t phase) noexcept;
+
+        vk::Device device;
+        vk::PhysicalDevice physicalDevice;
+        uint32_t framesInFlight;
+        uint32_t instanceCapacity;
+        uint32_t sceneCapacity;
+
+        vk::DescriptorSetLayout descriptorSetLayout;
+        vk::PipelineLayout layout;
+        vk::Pipeline pipeline;
+        std::vector<vk::DescriptorSet> descriptorSets;
+
+        vkUtil::Buffer visibilityBuffer;
+        vkUtil::Buffer drawListBuffer;
+        vkUtil::Buffer drawCommandBuffer;
+        vkUtil::Buffer counterBuffer;
+        OcclusionStats* counterReadLocation;
+
+        DepthPyramid pyramid;
+    };
+}
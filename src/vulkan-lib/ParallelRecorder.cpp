@@ -0,0 +1,72 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.parallelRecorder;
+
+import <algorithm>;
+import <atomic>;
+import vulkan_lib.logging;
+
+namespace vkl {
+
+    ParallelRecorder::ParallelRecorder() : allocator(nullptr), jobs(nullptr) {
+    }
+
+    void ParallelRecorder::make(CommandAllocator* allocator, JobSystem* jobs) noexcept {
+        this->allocator = allocator;
+        this->jobs = jobs;
+    }
+
+    [[nodiscard]] uint32_t ParallelRecorder::chunk_count(uint32_t count) const noexcept {
+        return std::clamp(count / minItemsPerThread, 1u, allocator->thread_count());
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> ParallelRecorder::record(vk::CommandBuffer primary,
+        const vk::CommandBufferInheritanceInfo& inheritance, uint32_t first, uint32_t last, const RecordRange& record) noexcept {
+        const uint32_t count = last - first;
+        const uint32_t chunks = chunk_count(count);
+        const uint32_t chunkSize = (count + chunks - 1) / chunks;
+
+        //taken up front on this thread, the jobs only record into them
+        secondaries.resize(chunks);
+        for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+            auto buffer_res = allocator->allocate(chunk, vk::CommandBufferLevel::eSecondary);
+            if (!buffer_res)
+                return std::unexpected(EmptyErr{});
+            secondaries[chunk] = buffer_res.value();
+        }
+
+        auto record_chunk = [&](uint32_t chunk) -> bool {
+            vk::CommandBufferBeginInfo beginInfo = {};
+            beginInfo.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue | vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+            beginInfo.pInheritanceInfo = &inheritance;
+            vk::CommandBuffer commandBuffer = secondaries[chunk];
+            if (commandBuffer.begin(beginInfo) != vk::Result::eSuccess)
+                return false;
+            const uint32_t chunkFirst = std::min(last, first + chunk * chunkSize);
+            const uint32_t chunkLast = std::min(last, chunkFirst + chunkSize);
+            record(commandBuffer, chunk, chunkFirst, chunkLast);
+            return commandBuffer.end() == vk::Result::eSuccess;
+        };
+
+        //the ranges are disjoint, each chunk and its pool is recorded by one job only
+        std::atomic<bool> recorded = true;
+        jobs->parallel_for(0, chunks, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+            for (uint32_t chunk = firstChunk; chunk < lastChunk; chunk++)
+                if (!record_chunk(chunk))
+                    recorded = false;
+        });
+        if (!recorded) {
+            vkInit::errprintDebug("failed to record a secondary command buffer");
+            return std::unexpected(EmptyErr{});
+        }
+
+        primary.executeCommands(static_cast<uint32_t>(secondaries.size()), secondaries.data());
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] uint32_t ParallelRecorder::thread_count() const noexcept {
+        return allocator->thread_count();
+    }
+}
@@ -0,0 +1,53 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.parallelRecorder;
+
+import <expected>;
+import <functional>;
+import <vector>;
+import vulkan_lib.commandAllocator;
+import vulkan_lib.jobSystem;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    ///records the inside of a render pass on several threads.
+    ///
+    ///a range of work is split in contiguous chunks, each recorded into a
+    ///secondary buffer taken from the allocator pool with the chunk's index, and
+    ///the secondaries are executed into the primary in chunk order so the result
+    ///is the same as recording the range on one thread.
+    ///
+    ///the jobs may land on any worker or on the caller. what keeps the pools
+    ///externally synchronized is that each chunk, and so each pool, is recorded
+    ///by exactly one job and the caller does not record its primary until all
+    ///of them finished. a record function must not allocate from the allocator.
+    export class ParallelRecorder {
+    public:
+        ///below this many items per thread the split costs more than it saves
+        static constexpr uint32_t minItemsPerThread = 512;
+
+        ///records items [first, last) of chunk into a secondary buffer that continues the render pass
+        using RecordRange = std::function<void(vk::CommandBuffer commandBuffer, uint32_t chunk, uint32_t first, uint32_t last)>;
+
+        ParallelRecorder();
+
+        ///one chunk per allocator pool at most, chunks are recorded as jobs
+        void make(CommandAllocator* allocator, JobSystem* jobs) noexcept;
+
+        ///chunks a range of count items is split in, 1 means recording it inline is cheaper
+        [[nodiscard]] uint32_t chunk_count(uint32_t count) const noexcept;
+        ///records [first, last) and executes the secondaries into primary. the rendering
+        ///described by inheritance must have been begun with eContentsSecondaryCommandBuffers
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> record(vk::CommandBuffer primary, const vk::CommandBufferInheritanceInfo& inheritance,
+            uint32_t first, uint32_t last, const RecordRange& record) noexcept;
+        [[nodiscard]] uint32_t thread_count() const noexcept;
+
+    private:
+        CommandAllocator* allocator;
+        JobSystem* jobs;
+        std::vector<vk::CommandBuffer> secondaries;
+    };
+}
@@ -4,46 +4,165 @@ module;
 
 export module vulkan_lib.pipeline;
 
+import <algorithm>;
+import <bit>;
+import <cstddef>;
 import <expected>;
+import <optional>;
+import <span>;
+import <string>;
+import <vector>;
 import <iostream>;
-import vulkan_lib.mesh;
 import vulkan_lib.renderStructs;
 import vulkan_lib.result;
 import vulkan_lib.shader;
 import vulkan_lib.logging;
+import vulkan_lib.instanceFormat;
+import vulkan_lib.pipelineCache;
+import vulkan_lib.reflection;
+import vulkan_lib.shaderLibrary;
 
 namespace vkInit {
 
+    export struct SpecializationConstant {
+        uint32_t id;
+        uint32_t value;
+
+        bool operator==(const SpecializationConstant& other) const = default;
+    };
+
+    ///values of a stage's constant_id constants, one spir-v module builds a
+    ///variant per map. every constant is 32 bits, bools are VK_TRUE or VK_FALSE.
+    ///kept sorted by id so two maps setting the same values compare equal
+    export struct SpecializationMap {
+        std::vector<SpecializationConstant> constants;
+
+        void set(uint32_t id, uint32_t value) {
+            auto found = std::lower_bound(constants.begin(), constants.end(), id,
+                [](const SpecializationConstant& constant, uint32_t id) { return constant.id < id; });
+            if (found != constants.end() && found->id == id)
+                found->value = value;
+            else
+                constants.insert(found, { id, value });
+        }
+        void set_flag(uint32_t id, bool value) {
+            set(id, value ? VK_TRUE : VK_FALSE);
+        }
+        void set_float(uint32_t id, float value) {
+            set(id, std::bit_cast<uint32_t>(value));
+        }
+
+        bool operator==(const SpecializationMap& other) const = default;
+    };
+
+    ///entries are written into entries, the info points at them and into map
+    export [[nodiscard]] inline auto
+    fill_specialization(const SpecializationMap& map, std::vector<vk::SpecializationMapEntry>& entries) -> vk::SpecializationInfo {
+        entries.clear();
+        for (size_t i = 0; i < map.constants.size(); i++) {
+            entries.emplace_back(map.constants[i].id,
+                static_cast<uint32_t>(i * sizeof(SpecializationConstant) + offsetof(SpecializationConstant, value)),
+                sizeof(uint32_t));
+        }
+        vk::SpecializationInfo info = {};
+        info.mapEntryCount = static_cast<uint32_t>(entries.size());
+        info.pMapEntries = entries.data();
+        info.dataSize = map.constants.size() * sizeof(SpecializationConstant);
+        info.pData = map.constants.data();
+        return info;
+    }
+
     export struct GraphicsPipelineBundle {
         vk::Device device;
+        ///without the format suffix when instanceFormat is set
         std::string vertexFilepath;
         std::string fragmentFilepath;
-        vk::Extent2D extent;
+        ///layout of the model buffer the vertex shader decodes, picks its variant
+        std::optional<vkl::InstanceFormat> instanceFormat;
         vk::Format swapchainImageFormat;
-        vk::DescriptorSetLayout descriptorSetLayout;
+        vk::Format depthFormat;
+        ///one per set, in set order
+        std::vector<vk::DescriptorSetLayout> descriptorSetLayouts;
+        std::vector<vk::PushConstantRange> pushConstantRanges;
+        SpecializationMap vertexConstants;
+        SpecializationMap fragmentConstants;
+        ///shared by every pipeline, compiles and times their creation
+        vkl::PipelineCache* pipelineCache;
+        ///the shaders are read and their modules made through it
+        vkl::ShaderLibrary* shaderLibrary;
+    };
+
+    ///everything a graphics pipeline is built from. two equal states build
+    ///the same pipeline, the registry hashes all of it. viewport and scissor
+    ///are dynamic and the attachments are given by format, so neither a resize
+    ///nor a new swapchain asks for another pipeline
+    export struct GraphicsPipelineState {
+        ///without the format suffix when instanceFormat is set, vertex_file names the spir-v
+        std::string vertexFilepath;
+        std::string fragmentFilepath;
+        ///layout of the model buffer the vertex shader decodes. pipelines of one shader
+        ///built for different formats are different states, none for shaders reading no instances
+        std::optional<vkl::InstanceFormat> instanceFormat;
+        vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+        vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+        vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+        vk::FrontFace frontFace = vk::FrontFace::eClockwise;
+        bool depthTest = true;
+        bool depthWrite = true;
+        vk::CompareOp depthCompare = vk::CompareOp::eLess;
+        ///source alpha over what was drawn
+        bool blend = false;
+        vk::Format colorFormat;
+        vk::Format depthFormat;
+        vk::PipelineLayout layout;
+        ///what the vertex shader reads, reflected from it and packed into binding 0
+        std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+        uint32_t vertexStride = 0;
+        ///a variant of the same shaders, branches on the constants are compiled out
+        SpecializationMap vertexConstants;
+        SpecializationMap fragmentConstants;
+
+        [[nodiscard]] std::string vertex_file() const {
+            return instanceFormat ? vkl::shader_variant(vertexFilepath, *instanceFormat) : vertexFilepath;
+        }
+
+        bool operator==(const GraphicsPipelineState& other) const = default;
     };
 
     export struct GraphicsPipelineOutBundle {
         vk::PipelineLayout layout;
-        vk::RenderPass renderpass;
+        ///null when the bundle was made without compiling
+        vk::Pipeline pipeline;
+        ///what the pipeline is built from, to request variants of it
+        GraphicsPipelineState state;
+    };
+
+    export struct ComputePipelineBundle {
+        vk::Device device;
+        std::string filepath;
+        vk::DescriptorSetLayout descriptorSetLayout;
+        uint32_t pushConstantSize;
+        SpecializationMap constants;
+        vkl::PipelineCache* pipelineCache;
+        vkl::ShaderLibrary* shaderLibrary;
+    };
+
+    export struct ComputePipelineOutBundle {
+        vk::PipelineLayout layout;
         vk::Pipeline pipeline;
     };
 
 
 
 export [[nodiscard]] inline auto 
-make_pipeline_layout(vk::Device device, vk::DescriptorSetLayout descriptorSetLayout) noexcept -> std::expected<vk::PipelineLayout, EmptyErr> {
+make_pipeline_layout(vk::Device device, std::span<const vk::DescriptorSetLayout> descriptorSetLayouts,
+    std::span<const vk::PushConstantRange> pushConstantRanges = {}) noexcept -> std::expected<vk::PipelineLayout, EmptyErr> {
     vk::PipelineLayoutCreateInfo layoutInfo = {};
     layoutInfo.flags = vk::PipelineLayoutCreateFlags();
-    layoutInfo.setLayoutCount = 1;
-    layoutInfo.pSetLayouts = &descriptorSetLayout;
-    
-    layoutInfo.pushConstantRangeCount = 0;
-    /*vk::PushConstantRange pushConstantInfo = {};
-    pushConstantInfo.offset = 0;
-    pushConstantInfo.size = sizeof(vkInit::ObjectData);
-    pushConstantInfo.stageFlags = vk::ShaderStageFlagBits::eVertex;
-    layoutInfo.pPushConstantRanges = &pushConstantInfo;*/
+    layoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+    layoutInfo.pSetLayouts = descriptorSetLayouts.data();
+    layoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    layoutInfo.pPushConstantRanges = pushConstantRanges.data();
     vk::ResultValue<vk::PipelineLayout> layoutR =
         device.createPipelineLayout(layoutInfo);
     if (layoutR.result != vk::Result::eSuccess) {
@@ -55,88 +174,21 @@ make_pipeline_layout(vk::Device device, vk::DescriptorSetLayout descriptorSetLay
 }
 
 export [[nodiscard]] inline auto
-make_render_pass(vk::Device device, vk::Format swapchainImageFormat) noexcept -> std::expected<vk::RenderPass, EmptyErr> {
-  vk::AttachmentDescription colorAttachment = {};
-  colorAttachment.flags = vk::AttachmentDescriptionFlags();
-  colorAttachment.format = swapchainImageFormat;
-  colorAttachment.samples = vk::SampleCountFlagBits::e1;
-  colorAttachment.loadOp = vk::AttachmentLoadOp::eClear;
-  colorAttachment.storeOp = vk::AttachmentStoreOp::eStore;
-  colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-  colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-  colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-  colorAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
-
-  vk::AttachmentReference colorAttachmentRef = {};
-  colorAttachmentRef.attachment = 0;
-  colorAttachmentRef.layout = vk::ImageLayout::eColorAttachmentOptimal;
-
-  vk::SubpassDescription subpass = {};
-  subpass.flags = vk::SubpassDescriptionFlags();
-  subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-  subpass.colorAttachmentCount = 1;
-  subpass.pColorAttachments = &colorAttachmentRef;
-
-  vk::RenderPassCreateInfo renderpassInfo = {};
-  renderpassInfo.flags = vk::RenderPassCreateFlags();
-  renderpassInfo.attachmentCount = 1;
-  renderpassInfo.pAttachments = &colorAttachment;
-  renderpassInfo.subpassCount = 1;
-  renderpassInfo.pSubpasses = &subpass;
-
-  vk::ResultValue<vk::RenderPass> renderpassR =
-      device.createRenderPass(renderpassInfo);
-  if (renderpassR.result != vk::Result::eSuccess) {
-    if constexpr (_DEBUG)
-      std::cerr << "failed to make render pass\n";
-    return std::unexpected(EmptyErr{});
-  }
-  return renderpassR.value;
-}
-export [[nodiscard]] inline auto
-fillVertexInputStateCreateInfo() noexcept -> vk::PipelineVertexInputStateCreateInfo {
-  vk::VertexInputBindingDescription bindingDescription =
-      vkMesh::getPosColorBindingDescription();
-  std::vector<vk::VertexInputAttributeDescription> attributeDescription =
-      vkMesh::getPosColorAttributeDescriptions();
-
-  vk::PipelineVertexInputStateCreateInfo vertexInputInfo = {};
-  vertexInputInfo.flags = vk::PipelineVertexInputStateCreateFlags();
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
-  vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-  vertexInputInfo.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(attributeDescription.size());
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescription.data();
-  return vertexInputInfo;
-}
-
-export [[nodiscard]] inline auto
-fillViewportScissor(GraphicsPipelineBundle &specifications) -> std::pair<vk::Viewport, vk::Rect2D> {
+fillViewportScissor(vk::Extent2D extent) -> std::pair<vk::Viewport, vk::Rect2D> {
   vk::Viewport viewport = {};
   viewport.x = 0.0f;
   viewport.y = 0.0f;
-  viewport.width = static_cast<float>(specifications.extent.width);
-  viewport.height = static_cast<float>(specifications.extent.height);
+  viewport.width = static_cast<float>(extent.width);
+  viewport.height = static_cast<float>(extent.height);
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
   vk::Rect2D scissor = {};
   scissor.offset.x = 0;
   scissor.offset.y = 0;
-  scissor.extent = specifications.extent;
+  scissor.extent = extent;
   return {viewport, scissor};
 }
 
-export [[nodiscard]] inline auto
-fillViewPortState(std::pair<vk::Viewport, vk::Rect2D> &viewportScissor) -> vk::PipelineViewportStateCreateInfo {
-  vk::PipelineViewportStateCreateInfo viewPortState = {};
-  viewPortState.flags = vk::PipelineViewportStateCreateFlags();
-  viewPortState.viewportCount = 1;
-  viewPortState.pViewports = &viewportScissor.first;
-  viewPortState.scissorCount = 1;
-  viewPortState.pScissors = &viewportScissor.second;
-  return viewPortState;
-}
-
 export [[nodiscard]] inline auto 
 fillColorBlendAttachment(vk::PipelineColorBlendAttachmentState *colorBlendAttachment) -> vk::PipelineColorBlendStateCreateInfo {
   vk::PipelineColorBlendStateCreateInfo colorBlending = {};
@@ -167,7 +219,21 @@ fillRasterizer() -> vk::PipelineRasterizationStateCreateInfo {
 }
 
 export [[nodiscard]] inline auto
-make_graphics_pipeline(GraphicsPipelineBundle &specifications) noexcept -> std::expected<GraphicsPipelineOutBundle, EmptyErr> {
+fillDepthStencil() -> vk::PipelineDepthStencilStateCreateInfo {
+  vk::PipelineDepthStencilStateCreateInfo depthStencil = {};
+  depthStencil.flags = vk::PipelineDepthStencilStateCreateFlags();
+  depthStencil.depthTestEnable = VK_TRUE;
+  depthStencil.depthWriteEnable = VK_TRUE;
+  depthStencil.depthCompareOp = vk::CompareOp::eLess;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.stencilTestEnable = VK_FALSE;
+  return depthStencil;
+}
+
+///builds the pipeline state describes through cache, the shader modules are shared through shaders
+export [[nodiscard]] inline auto
+compile_graphics_pipeline(vk::Device device, const GraphicsPipelineState &state, vkl::PipelineCache &cache,
+    vkl::ShaderLibrary &shaders) noexcept -> std::expected<vk::Pipeline, EmptyErr> {
   // main pipeline
   vk::GraphicsPipelineCreateInfo pipelineCreateInfo = {};
   pipelineCreateInfo.flags = vk::PipelineCreateFlags();
@@ -175,74 +241,77 @@ make_graphics_pipeline(GraphicsPipelineBundle &specifications) noexcept -> std::
   // a list of all the shader stages
   std::vector<vk::PipelineShaderStageCreateInfo> shaderStages;
 
-  // VERTEX shader input
-  vk::VertexInputBindingDescription bindingDescription =
-      vkMesh::getPosColorBindingDescription();
-  std::vector<vk::VertexInputAttributeDescription> attributeDescription =
-      vkMesh::getPosColorAttributeDescriptions();
+  // VERTEX shader input, no binding when the shader reads nothing from buffers
+  vk::VertexInputBindingDescription bindingDescription = {};
+  bindingDescription.binding = 0;
+  bindingDescription.stride = state.vertexStride;
+  bindingDescription.inputRate = vk::VertexInputRate::eVertex;
 
   vk::PipelineVertexInputStateCreateInfo vertexInputInfo = {};
   vertexInputInfo.flags = vk::PipelineVertexInputStateCreateFlags();
-  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.vertexBindingDescriptionCount = state.vertexAttributes.empty() ? 0 : 1;
   vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
   vertexInputInfo.vertexAttributeDescriptionCount =
-      static_cast<uint32_t>(attributeDescription.size());
-  vertexInputInfo.pVertexAttributeDescriptions = attributeDescription.data();
-
-  // vk::PipelineVertexInputStateCreateInfo vertexInputInfo =
-  // fillVertexInputStateCreateInfo();
+      static_cast<uint32_t>(state.vertexAttributes.size());
+  vertexInputInfo.pVertexAttributeDescriptions = state.vertexAttributes.data();
   pipelineCreateInfo.pVertexInputState = &vertexInputInfo;
 
   vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo = {};
   inputAssemblyInfo.flags = vk::PipelineInputAssemblyStateCreateFlags();
-  inputAssemblyInfo.topology = vk::PrimitiveTopology::eTriangleList;
+  inputAssemblyInfo.topology = state.topology;
   pipelineCreateInfo.pInputAssemblyState = &inputAssemblyInfo;
 
   // Vertex shader
-  printDebug("creating vertex shader module...");
-
-  
-  auto vertexShaderModRes = vkInit::create_module(specifications.vertexFilepath,
-                            specifications.device);
+  auto vertexShaderModRes = shaders.module(state.vertex_file());
   if (!vertexShaderModRes) {
       return std::unexpected(EmptyErr{});
   }
   vk::ShaderModule vertexShader = vertexShaderModRes.value();
+  std::vector<vk::SpecializationMapEntry> vertexEntries;
+  vk::SpecializationInfo vertexSpecialization = fill_specialization(state.vertexConstants, vertexEntries);
   vk::PipelineShaderStageCreateInfo vertexShaderInfo = {};
   vertexShaderInfo.flags = vk::PipelineShaderStageCreateFlags();
   vertexShaderInfo.stage = vk::ShaderStageFlagBits::eVertex;
   vertexShaderInfo.module = vertexShader;
   vertexShaderInfo.pName = "main";
+  vertexShaderInfo.pSpecializationInfo = &vertexSpecialization;
   shaderStages.push_back(vertexShaderInfo);
 
-  // viewport and scissor
-
-  std::pair<vk::Viewport, vk::Rect2D> viewportScissor =
-      fillViewportScissor(specifications);
-
-  vk::PipelineViewportStateCreateInfo viewPortState =
-      fillViewPortState(viewportScissor);
+  // viewport and scissor, set while recording so the extent is not part of the pipeline
+  vk::PipelineViewportStateCreateInfo viewPortState = {};
+  viewPortState.flags = vk::PipelineViewportStateCreateFlags();
+  viewPortState.viewportCount = 1;
+  viewPortState.scissorCount = 1;
   pipelineCreateInfo.pViewportState = &viewPortState;
+  const vk::DynamicState dynamicStates[] = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+  vk::PipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.flags = vk::PipelineDynamicStateCreateFlags();
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
+  pipelineCreateInfo.pDynamicState = &dynamicState;
 
   // RASTERIZER
   vk::PipelineRasterizationStateCreateInfo rasterizer = fillRasterizer();
+  rasterizer.polygonMode = state.polygonMode;
+  rasterizer.cullMode = state.cullMode;
+  rasterizer.frontFace = state.frontFace;
   pipelineCreateInfo.pRasterizationState = &rasterizer;
 
   // Fragment shader
-  printDebug("Creating fragment shader module...");
-
-  auto fragmentShaderRes = vkInit::create_module(specifications.fragmentFilepath,
-      specifications.device);
+  auto fragmentShaderRes = shaders.module(state.fragmentFilepath);
   if (!fragmentShaderRes) {
       return std::unexpected(EmptyErr{});
   }
   vk::ShaderModule fragmentShader = fragmentShaderRes.value();
-  
+  std::vector<vk::SpecializationMapEntry> fragmentEntries;
+  vk::SpecializationInfo fragmentSpecialization = fill_specialization(state.fragmentConstants, fragmentEntries);
+
   vk::PipelineShaderStageCreateInfo fragmentShaderInfo = {};
   fragmentShaderInfo.flags = vk::PipelineShaderStageCreateFlags();
   fragmentShaderInfo.stage = vk::ShaderStageFlagBits::eFragment;
   fragmentShaderInfo.module = fragmentShader;
   fragmentShaderInfo.pName = "main";
+  fragmentShaderInfo.pSpecializationInfo = &fragmentSpecialization;
   shaderStages.push_back(fragmentShaderInfo);
 
   pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
@@ -255,51 +324,136 @@ make_graphics_pipeline(GraphicsPipelineBundle &specifications) noexcept -> std::
   multisampling.rasterizationSamples = vk::SampleCountFlagBits::e1;
   pipelineCreateInfo.pMultisampleState = &multisampling;
 
+  // depth
+  vk::PipelineDepthStencilStateCreateInfo depthStencil = fillDepthStencil();
+  depthStencil.depthTestEnable = state.depthTest;
+  depthStencil.depthWriteEnable = state.depthWrite;
+  depthStencil.depthCompareOp = state.depthCompare;
+  pipelineCreateInfo.pDepthStencilState = &depthStencil;
+
   // color blend
   vk::PipelineColorBlendAttachmentState colorBlendAttachment = {};
   colorBlendAttachment.colorWriteMask =
       vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
       vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
-  colorBlendAttachment.blendEnable = VK_FALSE;
+  colorBlendAttachment.blendEnable = state.blend;
+  colorBlendAttachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+  colorBlendAttachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+  colorBlendAttachment.colorBlendOp = vk::BlendOp::eAdd;
+  colorBlendAttachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+  colorBlendAttachment.dstAlphaBlendFactor = vk::BlendFactor::eZero;
+  colorBlendAttachment.alphaBlendOp = vk::BlendOp::eAdd;
   vk::PipelineColorBlendStateCreateInfo colorBlending =
       fillColorBlendAttachment(&colorBlendAttachment);
   pipelineCreateInfo.pColorBlendState = &colorBlending;
 
+  // attachments, drawn with dynamic rendering instead of a render pass
+  vk::PipelineRenderingCreateInfo renderingInfo = {};
+  renderingInfo.colorAttachmentCount = 1;
+  renderingInfo.pColorAttachmentFormats = &state.colorFormat;
+  renderingInfo.depthAttachmentFormat = state.depthFormat;
+  pipelineCreateInfo.pNext = &renderingInfo;
+
+  pipelineCreateInfo.layout = state.layout;
+  pipelineCreateInfo.renderPass = nullptr;
+  pipelineCreateInfo.basePipelineHandle = nullptr;
+
+  printDebug("making pipeline ...");
+  return cache.compile(pipelineCreateInfo);
+}
+
+///the layout of the bundle, the pipeline itself is compiled right away when
+///compile is set, otherwise left to whoever requests its state
+export [[nodiscard]] inline auto
+make_graphics_pipeline(GraphicsPipelineBundle &specifications, bool compile = true) noexcept -> std::expected<GraphicsPipelineOutBundle, EmptyErr> {
+  // vertex input, read from the shader so it never drifts from the vertex buffers' layout
+  const std::string vertexFile = specifications.instanceFormat
+      ? vkl::shader_variant(specifications.vertexFilepath, *specifications.instanceFormat) : specifications.vertexFilepath;
+  auto reflection_res = reflect_file(*specifications.shaderLibrary, vertexFile);
+  if (!reflection_res) {
+      return std::unexpected(EmptyErr{});
+  }
+
   // Pipeline Layout
   printDebug("making pipeline layout...");
-  auto layoutRes = make_pipeline_layout(specifications.device, specifications.descriptorSetLayout);
+  auto layoutRes = make_pipeline_layout(specifications.device, specifications.descriptorSetLayouts,
+      specifications.pushConstantRanges);
   if (!layoutRes) {
       return std::unexpected(EmptyErr{});
   }
-  pipelineCreateInfo.layout = layoutRes.value();
-
-  // renderpass
-  printDebug("making renderpass ...");
-  auto renderpassRes = make_render_pass(specifications.device,
-                       specifications.swapchainImageFormat);
-  if (!renderpassRes) {
-      return  std::unexpected(EmptyErr{});
+
+  GraphicsPipelineOutBundle output = {};
+  output.layout = layoutRes.value();
+  output.state.vertexFilepath = specifications.vertexFilepath;
+  output.state.fragmentFilepath = specifications.fragmentFilepath;
+  output.state.instanceFormat = specifications.instanceFormat;
+  output.state.colorFormat = specifications.swapchainImageFormat;
+  output.state.depthFormat = specifications.depthFormat;
+  output.state.layout = output.layout;
+  output.state.vertexAttributes = std::move(reflection_res.value().vertexAttributes);
+  output.state.vertexStride = reflection_res.value().vertexStride;
+  output.state.vertexConstants = specifications.vertexConstants;
+  output.state.fragmentConstants = specifications.fragmentConstants;
+  if (!compile)
+      return output;
+
+  auto pipelineRes = compile_graphics_pipeline(specifications.device, output.state, *specifications.pipelineCache,
+      *specifications.shaderLibrary);
+  if (!pipelineRes) {
+      return std::unexpected(EmptyErr{});
   }
-  pipelineCreateInfo.renderPass = renderpassRes.value();
+  output.pipeline = pipelineRes.value();
+  return output;
+}
 
-  // Extra stuff
-  pipelineCreateInfo.basePipelineHandle = nullptr;
-  printDebug("making pipeline ...");
-  vk::ResultValue<vk::Pipeline> pipelineR =
-      specifications.device.createGraphicsPipeline(nullptr, pipelineCreateInfo);
-  if (pipelineR.result != vk::Result::eSuccess) {
-    errprintDebug("failed to create graphics pipeline");
+export [[nodiscard]] inline auto
+make_compute_pipeline(ComputePipelineBundle &specifications) noexcept -> std::expected<ComputePipelineOutBundle, EmptyErr> {
+  auto shaderRes = specifications.shaderLibrary->module(specifications.filepath);
+  if (!shaderRes) {
+      return std::unexpected(EmptyErr{});
+  }
+  vk::ShaderModule computeShader = shaderRes.value();
+
+  vk::PushConstantRange pushConstantInfo = {};
+  pushConstantInfo.offset = 0;
+  pushConstantInfo.size = specifications.pushConstantSize;
+  pushConstantInfo.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+  vk::PipelineLayoutCreateInfo layoutInfo = {};
+  layoutInfo.flags = vk::PipelineLayoutCreateFlags();
+  layoutInfo.setLayoutCount = 1;
+  layoutInfo.pSetLayouts = &specifications.descriptorSetLayout;
+  layoutInfo.pushConstantRangeCount = specifications.pushConstantSize > 0 ? 1 : 0;
+  layoutInfo.pPushConstantRanges = &pushConstantInfo;
+  vk::ResultValue<vk::PipelineLayout> layoutR =
+      specifications.device.createPipelineLayout(layoutInfo);
+  if (layoutR.result != vk::Result::eSuccess) {
+    errprintDebug("failed to create compute pipeline layout");
     return std::unexpected(EmptyErr{});
   }
 
-  GraphicsPipelineOutBundle output = {};
-  output.pipeline = pipelineR.value;
-  output.renderpass = renderpassRes.value();
-  output.layout = layoutRes.value();
+  vk::ComputePipelineCreateInfo pipelineCreateInfo = {};
+  pipelineCreateInfo.flags = vk::PipelineCreateFlags();
+  pipelineCreateInfo.stage.flags = vk::PipelineShaderStageCreateFlags();
+  pipelineCreateInfo.stage.stage = vk::ShaderStageFlagBits::eCompute;
+  pipelineCreateInfo.stage.module = computeShader;
+  pipelineCreateInfo.stage.pName = "main";
+  std::vector<vk::SpecializationMapEntry> entries;
+  vk::SpecializationInfo specialization = fill_specialization(specifications.constants, entries);
+  pipelineCreateInfo.stage.pSpecializationInfo = &specialization;
+  pipelineCreateInfo.layout = layoutR.value;
+  pipelineCreateInfo.basePipelineHandle = nullptr;
+
+  printDebug("making compute pipeline ...");
+  auto pipelineRes = specifications.pipelineCache->compile(pipelineCreateInfo);
+  if (!pipelineRes) {
+    specifications.device.destroyPipelineLayout(layoutR.value);
+    return std::unexpected(EmptyErr{});
+  }
 
-  // after all is set up clean up the modules
-  specifications.device.destroyShaderModule(vertexShader);
-  specifications.device.destroyShaderModule(fragmentShader);
+  ComputePipelineOutBundle output = {};
+  output.layout = layoutR.value;
+  output.pipeline = pipelineRes.value();
   return output;
 }
 } // namespace vkInit
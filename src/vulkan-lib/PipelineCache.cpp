@@ -0,0 +1,245 @@
+module;
+
+#include "vulkan-lib/Config.h"
+#include <cstdio>
+#include <cstring>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+module vulkan_lib.pipelineCache;
+
+import <algorithm>;
+import <filesystem>;
+import <vector>;
+import vulkan_lib.logging;
+import vulkan_lib.shader;
+
+namespace vkl {
+
+    PipelineCache::PipelineCache() : properties{}, jobs(nullptr), saveRunning(false), warm(false), loadedBytes(0), savedBytes(0), saves(0),
+        pipelinesCompiled(0), savedPipelines(0), compileMicroseconds(0) {
+    }
+
+    PipelineCache::~PipelineCache() {
+        destroy();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> PipelineCache::make(vk::Device device, vk::PhysicalDevice physicalDevice,
+        std::string path) noexcept {
+        destroy();
+        this->device = device;
+        this->path = std::move(path);
+        properties = physicalDevice.getProperties();
+        warm = false;
+        loadedBytes = 0;
+
+        //a missing or foreign file only costs the warm start
+        std::vector<char> data;
+        std::error_code error;
+        if (std::filesystem::exists(this->path, error)) {
+            auto file_res = vkInit::read_file(this->path);
+            if (file_res && matches_device(file_res.value()))
+                data = std::move(file_res.value());
+            else
+                vkInit::errprintDebug("pipeline cache on disk does not match the device, starting cold");
+        }
+
+        vk::PipelineCacheCreateInfo createInfo = {};
+        createInfo.flags = vk::PipelineCacheCreateFlags();
+        createInfo.initialDataSize = data.size();
+        createInfo.pInitialData = data.data();
+        vk::ResultValue<vk::PipelineCache> cacheR = device.createPipelineCache(createInfo);
+        if (cacheR.result != vk::Result::eSuccess && !data.empty()) {
+            //the driver may still refuse data whose header it wrote
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            data.clear();
+            cacheR = device.createPipelineCache(createInfo);
+        }
+        if (cacheR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to create pipeline cache");
+            return std::unexpected(EmptyErr{});
+        }
+        pipelineCache = cacheR.value;
+        warm = !data.empty();
+        loadedBytes = data.size();
+        lastSave = std::chrono::steady_clock::now();
+        return EmptyOk{};
+    }
+
+    void PipelineCache::destroy() noexcept {
+        wait_save();
+        if (!pipelineCache)
+            return;
+        device.destroyPipelineCache(pipelineCache);
+        pipelineCache = nullptr;
+    }
+
+    [[nodiscard]] std::expected<vk::Pipeline, EmptyErr> PipelineCache::compile(const vk::GraphicsPipelineCreateInfo& createInfo) noexcept {
+        const auto start = std::chrono::steady_clock::now();
+        vk::ResultValue<vk::Pipeline> pipelineR = device.createGraphicsPipeline(pipelineCache, createInfo);
+        if (pipelineR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to create graphics pipeline");
+            return std::unexpected(EmptyErr{});
+        }
+        record_compile(start);
+        return pipelineR.value;
+    }
+
+    [[nodiscard]] std::expected<vk::Pipeline, EmptyErr> PipelineCache::compile(const vk::ComputePipelineCreateInfo& createInfo) noexcept {
+        const auto start = std::chrono::steady_clock::now();
+        vk::ResultValue<vk::Pipeline> pipelineR = device.createComputePipeline(pipelineCache, createInfo);
+        if (pipelineR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to create compute pipeline");
+            return std::unexpected(EmptyErr{});
+        }
+        record_compile(start);
+        return pipelineR.value;
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> PipelineCache::save() noexcept {
+        wait_save();
+        lastSave = std::chrono::steady_clock::now();
+        return write();
+    }
+
+    bool PipelineCache::save_if_stale(JobSystem& jobs) noexcept {
+        if (saveRunning && !saving.done())
+            return false;
+        saveRunning = false;
+        if (!pipelineCache || pipelinesCompiled.load() == savedPipelines.load())
+            return false;
+        if (std::chrono::steady_clock::now() - lastSave < saveInterval)
+            return false;
+        //a failed save is retried once saveInterval passed again
+        lastSave = std::chrono::steady_clock::now();
+        this->jobs = &jobs;
+        saveRunning = true;
+        jobs.submit_background([this]() { (void)write(); }, &saving);
+        return true;
+    }
+
+    void PipelineCache::wait_save() noexcept {
+        if (!saveRunning)
+            return;
+        jobs->wait(saving);
+        saveRunning = false;
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> PipelineCache::write() noexcept {
+        if (!pipelineCache)
+            return EmptyOk{};
+        const uint32_t compiled = pipelinesCompiled.load();
+        vk::ResultValue<std::vector<uint8_t>> dataR = device.getPipelineCacheData(pipelineCache);
+        if (dataR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to read pipeline cache data");
+            return std::unexpected(EmptyErr{});
+        }
+        if (!write_durably(path, dataR.value))
+            return std::unexpected(EmptyErr{});
+        savedBytes = dataR.value.size();
+        saves++;
+        savedPipelines = compiled;
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> PipelineCache::write_durably(const std::string& path,
+        std::span<const uint8_t> data) noexcept {
+        //the old cache stays in place until the new one is on the disk
+        const std::string temporary = path + ".tmp";
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            vkInit::errprintDebug("failed to write pipeline cache");
+            return std::unexpected(EmptyErr{});
+        }
+        size_t written = 0;
+        bool good = true;
+        while (good && written < data.size()) {
+            const DWORD chunk = static_cast<DWORD>(std::min<size_t>(data.size() - written, 1u << 30));
+            DWORD count = 0;
+            good = WriteFile(file, data.data() + written, chunk, &count, nullptr) && count > 0;
+            written += count;
+        }
+        good = good && FlushFileBuffers(file);
+        CloseHandle(file);
+        //write through returns once the rename itself reached the disk
+        good = good && MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+        const int file = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (file < 0) {
+            vkInit::errprintDebug("failed to write pipeline cache");
+            return std::unexpected(EmptyErr{});
+        }
+        size_t written = 0;
+        bool good = true;
+        while (good && written < data.size()) {
+            const ssize_t count = ::write(file, data.data() + written, data.size() - written);
+            good = count > 0;
+            if (good)
+                written += static_cast<size_t>(count);
+        }
+        //without the sync the rename may reach the disk before the data and leave an empty file
+        good = fsync(file) == 0 && good;
+        good = close(file) == 0 && good;
+        good = good && std::rename(temporary.c_str(), path.c_str()) == 0;
+        if (good) {
+            //the rename is only durable once the directory entry is
+            std::filesystem::path directory = std::filesystem::path(path).parent_path();
+            if (directory.empty())
+                directory = ".";
+            const int directoryFile = open(directory.c_str(), O_RDONLY);
+            if (directoryFile >= 0) {
+                (void)fsync(directoryFile);
+                close(directoryFile);
+            }
+        }
+#endif
+        if (!good) {
+            vkInit::errprintDebug("failed to replace pipeline cache");
+            std::error_code error;
+            std::filesystem::remove(temporary, error);
+            return std::unexpected(EmptyErr{});
+        }
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] vk::PipelineCache PipelineCache::cache() const noexcept {
+        return pipelineCache;
+    }
+
+    [[nodiscard]] PipelineCacheStats PipelineCache::stats() const noexcept {
+        PipelineCacheStats result = {};
+        result.warm = warm;
+        result.loadedBytes = loadedBytes;
+        result.savedBytes = savedBytes.load();
+        result.saves = saves.load();
+        result.pipelinesCompiled = pipelinesCompiled.load();
+        result.compileMilliseconds = static_cast<float>(compileMicroseconds.load()) / 1000.0f;
+        return result;
+    }
+
+    [[nodiscard]] bool PipelineCache::matches_device(const std::vector<char>& data) const noexcept {
+        vk::PipelineCacheHeaderVersionOne header;
+        if (data.size() < sizeof(header))
+            return false;
+        std::memcpy(&header, data.data(), sizeof(header));
+        return header.headerSize >= sizeof(header) && header.headerSize <= data.size()
+            && header.headerVersion == vk::PipelineCacheHeaderVersion::eOne
+            && header.vendorID == properties.vendorID
+            && header.deviceID == properties.deviceID
+            && std::memcmp(header.pipelineCacheUUID.data(), properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+    }
+
+    void PipelineCache::record_compile(std::chrono::steady_clock::time_point start) noexcept {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        compileMicroseconds += static_cast<uint64_t>(elapsed.count());
+        pipelinesCompiled++;
+    }
+}
@@ -0,0 +1,93 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.pipelineCache;
+
+import <atomic>;
+import <chrono>;
+import <expected>;
+import <span>;
+import <string>;
+import <vector>;
+import vulkan_lib.jobSystem;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    export struct PipelineCacheStats {
+        ///the file on disk was accepted and seeded the cache
+        bool warm;
+        uint64_t loadedBytes;
+        uint64_t savedBytes;
+        uint32_t saves;
+        uint32_t pipelinesCompiled;
+        ///time spent inside pipeline creation, what a warm cache shortens
+        float compileMilliseconds;
+    };
+
+    ///the driver's pipeline cache, kept on disk between runs.
+    ///
+    ///make seeds it from the file when its header matches the device's vendor,
+    ///device and cache uuid, anything else starts cold. every pipeline of the
+    ///engine is created through compile so they all share it and the time the
+    ///driver spends on them is measured. save writes to a temporary file first,
+    ///flushes it to the disk and renames it over the old one, a crash or power
+    ///loss mid write never leaves a truncated cache behind. save_if_stale does
+    ///the same on the job system's background queue, the frame never waits on
+    ///the driver serializing the cache or on the disk.
+    export class PipelineCache {
+    public:
+        static constexpr std::chrono::seconds saveInterval{ 30 };
+
+        PipelineCache();
+        ~PipelineCache();
+        PipelineCache(const PipelineCache& ref) = delete;
+        PipelineCache& operator=(const PipelineCache& ref) = delete;
+
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make(vk::Device device, vk::PhysicalDevice physicalDevice,
+            std::string path = "pipeline_cache.bin") noexcept;
+        void destroy() noexcept;
+
+        ///thread safe, the driver synchronizes the cache itself
+        [[nodiscard]] std::expected<vk::Pipeline, EmptyErr> compile(const vk::GraphicsPipelineCreateInfo& createInfo) noexcept;
+        [[nodiscard]] std::expected<vk::Pipeline, EmptyErr> compile(const vk::ComputePipelineCreateInfo& createInfo) noexcept;
+
+        ///waits for a save still running on a worker and saves now
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> save() noexcept;
+        ///starts a save on a worker when pipelines were compiled since the last one, saveInterval
+        ///passed and none is running. returns whether one was started
+        bool save_if_stale(JobSystem& jobs) noexcept;
+
+        [[nodiscard]] vk::PipelineCache cache() const noexcept;
+        [[nodiscard]] PipelineCacheStats stats() const noexcept;
+
+    private:
+        ///true when data starts with a header written by this device's driver
+        [[nodiscard]] bool matches_device(const std::vector<char>& data) const noexcept;
+        void record_compile(std::chrono::steady_clock::time_point start) noexcept;
+        ///reads the cache from the driver and writes it, from any thread
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> write() noexcept;
+        void wait_save() noexcept;
+        ///data in a temporary file synced to the disk, then renamed over path
+        [[nodiscard]] static std::expected<EmptyOk, EmptyErr> write_durably(const std::string& path,
+            std::span<const uint8_t> data) noexcept;
+
+        vk::Device device;
+        vk::PhysicalDeviceProperties properties;
+        vk::PipelineCache pipelineCache;
+        std::string path;
+        ///when the last save started
+        std::chrono::steady_clock::time_point lastSave;
+        JobSystem* jobs;
+        JobCounter saving;
+        bool saveRunning;
+        bool warm;
+        uint64_t loadedBytes;
+        std::atomic<uint64_t> savedBytes;
+        std::atomic<uint32_t> saves;
+        std::atomic<uint32_t> pipelinesCompiled;
+        std::atomic<uint32_t> savedPipelines;
+        std::atomic<uint64_t> compileMicroseconds;
+    };
+}
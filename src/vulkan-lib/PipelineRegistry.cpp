@@ -0,0 +1,234 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.pipelineRegistry;
+
+import <algorithm>;
+import <string_view>;
+import vulkan_lib.hash;
+
+namespace vkl {
+
+    PipelineRegistry::PipelineRegistry() : cache(nullptr), shaders(nullptr), jobs(nullptr), requests(0), deduplicated(0),
+        compiled(0), failed(0), reloaded(0), reloadsFailed(0) {
+    }
+
+    PipelineRegistry::~PipelineRegistry() {
+        destroy();
+    }
+
+    void PipelineRegistry::make(vk::Device device, PipelineCache& cache, ShaderLibrary& shaders, JobSystem& jobs) noexcept {
+        destroy();
+        this->device = device;
+        this->cache = &cache;
+        this->shaders = &shaders;
+        this->jobs = &jobs;
+        requests = 0;
+        deduplicated = 0;
+        compiled = 0;
+        failed = 0;
+        reloaded = 0;
+        reloadsFailed = 0;
+    }
+
+    void PipelineRegistry::destroy() noexcept {
+        for (std::unique_ptr<Entry>& entry : entries) {
+            jobs->wait(entry->compiling);
+            if (entry->pipeline)
+                device.destroyPipeline(entry->pipeline);
+            if (entry->reload.load() == Reload::Ready)
+                device.destroyPipeline(entry->replacement);
+        }
+        entries.clear();
+        lookup.clear();
+    }
+
+    [[nodiscard]] PipelineHandle PipelineRegistry::request(const vkInit::GraphicsPipelineState& state, PipelineHandle fallback) {
+        requests++;
+        std::vector<PipelineHandle>& candidates = lookup[hash(state)];
+        for (PipelineHandle candidate : candidates) {
+            if (entries[candidate]->state == state) {
+                deduplicated++;
+                return candidate;
+            }
+        }
+
+        const PipelineHandle handle = static_cast<PipelineHandle>(entries.size());
+        entries.push_back(std::make_unique<Entry>());
+        Entry* entry = entries.back().get();
+        entry->state = state;
+        entry->fallback = fallback;
+        entry->status = Status::Pending;
+        entry->reload = Reload::None;
+        entry->reloadAgain = false;
+        candidates.push_back(handle);
+
+        jobs->submit_background([this, entry]() {
+            auto pipeline_res = vkInit::compile_graphics_pipeline(device, entry->state, *cache, *shaders);
+            if (pipeline_res) {
+                entry->pipeline = pipeline_res.value();
+                compiled++;
+                entry->status.store(Status::Ready, std::memory_order_release);
+            }
+            else {
+                failed++;
+                entry->status.store(Status::Failed, std::memory_order_release);
+            }
+        }, &entry->compiling);
+        return handle;
+    }
+
+    [[nodiscard]] vk::Pipeline PipelineRegistry::get(PipelineHandle handle) const noexcept {
+        //a fallback may itself still be compiling, follow the chain to what is ready
+        for (uint32_t depth = 0; handle < entries.size() && depth < entries.size(); depth++) {
+            const Entry& entry = *entries[handle];
+            if (entry.status.load(std::memory_order_acquire) == Status::Ready)
+                return entry.pipeline;
+            handle = entry.fallback;
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] bool PipelineRegistry::ready(PipelineHandle handle) const noexcept {
+        return handle < entries.size() && entries[handle]->status.load(std::memory_order_acquire) == Status::Ready;
+    }
+
+    [[nodiscard]] std::expected<vk::Pipeline, EmptyErr> PipelineRegistry::wait(PipelineHandle handle) noexcept {
+        if (handle >= entries.size())
+            return std::unexpected(EmptyErr{});
+        Entry& entry = *entries[handle];
+        jobs->wait(entry.compiling);
+        if (entry.status.load(std::memory_order_acquire) != Status::Ready)
+            return std::unexpected(EmptyErr{});
+        return entry.pipeline;
+    }
+
+    [[nodiscard]] bool PipelineRegistry::idle() const noexcept {
+        return std::all_of(entries.begin(), entries.end(),
+            [](const std::unique_ptr<Entry>& entry) { return entry->compiling.done(); });
+    }
+
+    [[nodiscard]] bool PipelineRegistry::uses(std::string_view filename) const noexcept {
+        return std::any_of(entries.begin(), entries.end(), [filename](const std::unique_ptr<Entry>& entry) {
+            return filename == entry->state.vertex_file() || filename == entry->state.fragmentFilepath;
+        });
+    }
+
+    uint32_t PipelineRegistry::reload(std::span<const std::string> filenames) {
+        uint32_t submitted = 0;
+        for (std::unique_ptr<Entry>& owned : entries) {
+            Entry* entry = owned.get();
+            const bool changed = std::any_of(filenames.begin(), filenames.end(), [entry](const std::string& filename) {
+                return filename == entry->state.vertex_file() || filename == entry->state.fragmentFilepath;
+            });
+            if (!changed)
+                continue;
+            //a compile still running may already have made its modules from the old archive
+            if (!entry->compiling.done()) {
+                entry->reloadAgain = true;
+                continue;
+            }
+            //a replacement never swapped in was never drawn with, the new one outdates it
+            if (entry->reload.load(std::memory_order_acquire) == Reload::Ready)
+                device.destroyPipeline(entry->replacement);
+            submit_reload(entry);
+            submitted++;
+        }
+        return submitted;
+    }
+
+    void PipelineRegistry::submit_reload(Entry* entry) {
+        entry->reloadAgain = false;
+        entry->replacement = nullptr;
+        entry->reload.store(Reload::Pending, std::memory_order_release);
+        jobs->submit_background([this, entry]() {
+            auto pipeline_res = vkInit::compile_graphics_pipeline(device, entry->state, *cache, *shaders);
+            if (pipeline_res) {
+                entry->replacement = pipeline_res.value();
+                entry->reload.store(Reload::Ready, std::memory_order_release);
+            }
+            else
+                entry->reload.store(Reload::Failed, std::memory_order_release);
+        }, &entry->compiling);
+    }
+
+    uint32_t PipelineRegistry::swap(const std::function<void(vk::Pipeline)>& retire) {
+        uint32_t swapped = 0;
+        for (std::unique_ptr<Entry>& owned : entries) {
+            Entry* entry = owned.get();
+            //a shader changed under the compile that just finished. a finished replacement is
+            //still newer than what draws now, it is swapped in below and compiled again after
+            if (entry->reloadAgain && entry->compiling.done()) {
+                const Reload previous = entry->reload.load(std::memory_order_acquire);
+                if (previous == Reload::Failed) {
+                    reloadsFailed++;
+                    entry->reload.store(Reload::None, std::memory_order_relaxed);
+                }
+                if (previous != Reload::Ready)
+                    submit_reload(entry);
+            }
+            const Reload reload = entry->reload.load(std::memory_order_acquire);
+            if (reload == Reload::Failed) {
+                //the old pipeline keeps drawing until the shader is fixed
+                reloadsFailed++;
+                entry->reload.store(Reload::None, std::memory_order_relaxed);
+                continue;
+            }
+            if (reload != Reload::Ready)
+                continue;
+            if (entry->status.load(std::memory_order_acquire) == Status::Ready)
+                retire(entry->pipeline);
+            else {
+                //a pipeline that failed its first compile recovers once its shaders are fixed
+                failed--;
+                compiled++;
+            }
+            entry->pipeline = entry->replacement;
+            entry->replacement = nullptr;
+            entry->status.store(Status::Ready, std::memory_order_release);
+            entry->reload.store(Reload::None, std::memory_order_relaxed);
+            reloaded++;
+            swapped++;
+            if (entry->reloadAgain)
+                submit_reload(entry);
+        }
+        return swapped;
+    }
+
+    [[nodiscard]] PipelineRegistryStats PipelineRegistry::stats() const noexcept {
+        PipelineRegistryStats result = {};
+        result.requests = requests;
+        result.deduplicated = deduplicated;
+        result.compiled = compiled.load();
+        result.failed = failed.load();
+        result.pending = static_cast<uint32_t>(entries.size()) - result.compiled - result.failed;
+        result.reloaded = reloaded;
+        result.reloadsFailed = reloadsFailed;
+        return result;
+    }
+
+    [[nodiscard]] uint64_t PipelineRegistry::hash(const vkInit::GraphicsPipelineState& state) noexcept {
+        uint64_t seed = std::hash<std::string_view>{}(state.vertexFilepath);
+        seed = hash_combine(seed, std::hash<std::string_view>{}(state.fragmentFilepath));
+        seed = hash_combine(seed, state.instanceFormat ? static_cast<uint64_t>(*state.instanceFormat) + 1 : 0);
+        seed = hash_combine(seed, static_cast<uint64_t>(state.topology));
+        seed = hash_combine(seed, static_cast<uint64_t>(state.polygonMode));
+        seed = hash_combine(seed, static_cast<uint64_t>(static_cast<VkCullModeFlags>(state.cullMode)));
+        seed = hash_combine(seed, static_cast<uint64_t>(state.frontFace));
+        seed = hash_combine(seed, (uint64_t(state.depthTest) << 2) | (uint64_t(state.depthWrite) << 1) | uint64_t(state.blend));
+        seed = hash_combine(seed, static_cast<uint64_t>(state.depthCompare));
+        seed = hash_combine(seed, static_cast<uint64_t>(state.colorFormat));
+        seed = hash_combine(seed, static_cast<uint64_t>(state.depthFormat));
+        for (const vk::VertexInputAttributeDescription& attribute : state.vertexAttributes)
+            seed = hash_combine(seed, (uint64_t(attribute.location) << 48) | (uint64_t(attribute.format) << 16) | attribute.offset);
+        seed = hash_combine(seed, state.vertexStride);
+        //variants of one module differ only here
+        for (const vkInit::SpecializationMap* map : { &state.vertexConstants, &state.fragmentConstants }) {
+            seed = hash_combine(seed, map->constants.size());
+            for (const vkInit::SpecializationConstant& constant : map->constants)
+                seed = hash_combine(seed, (uint64_t(constant.id) << 32) | constant.value);
+        }
+        return hash_combine(seed, handle_bits(state.layout));
+    }
+}
@@ -0,0 +1,133 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.pipelineRegistry;
+
+import <atomic>;
+import <deque>;
+import <expected>;
+import <functional>;
+import <span>;
+import <string>;
+import <string_view>;
+import <memory>;
+import <unordered_map>;
+import <vector>;
+import vulkan_lib.jobSystem;
+import vulkan_lib.pipeline;
+import vulkan_lib.pipelineCache;
+import vulkan_lib.result;
+import vulkan_lib.shaderLibrary;
+
+namespace vkl {
+
+    ///names a requested pipeline, valid until the registry is destroyed
+    export using PipelineHandle = uint32_t;
+    export constexpr PipelineHandle noPipeline = 0xFFFFFFFF;
+
+    export struct PipelineRegistryStats {
+        uint32_t requests;
+        ///requests answered with a pipeline requested before
+        uint32_t deduplicated;
+        uint32_t compiled;
+        uint32_t failed;
+        ///compiles still running on the workers
+        uint32_t pending;
+        ///pipelines rebuilt from changed shaders and swapped in
+        uint32_t reloaded;
+        uint32_t reloadsFailed;
+    };
+
+    ///every graphics pipeline of the engine, one per distinct state.
+    ///
+    ///request hashes the whole vkInit::GraphicsPipelineState, specialization
+    ///constants included, and hands back the handle of an equal state asked for
+    ///before, so variants are only built once. misses compile on the job
+    ///system's background queue while the caller goes on, so the frame's own
+    ///waits never end up running a driver compile. get returns null or the
+    ///fallback named in the request until the pipeline is ready, and wait
+    ///blocks on it when a frame cannot go without.
+    ///
+    ///reload recompiles the pipelines built from changed shaders in the
+    ///background, the old pipelines keep drawing until swap puts the new ones in
+    ///place at a frame boundary and hands the old ones over to be retired. a
+    ///pipeline whose shaders change while it compiles is compiled again by the
+    ///first swap after that compile finished, so no edit is lost.
+    ///
+    ///request, get, wait, reload and swap belong to one thread, the workers only
+    ///touch the entry they compile.
+    export class PipelineRegistry {
+    public:
+        PipelineRegistry();
+        ~PipelineRegistry();
+        PipelineRegistry(const PipelineRegistry& ref) = delete;
+        PipelineRegistry& operator=(const PipelineRegistry& ref) = delete;
+
+        void make(vk::Device device, PipelineCache& cache, ShaderLibrary& shaders, JobSystem& jobs) noexcept;
+        ///waits for the compiles still running and destroys every pipeline
+        void destroy() noexcept;
+
+        ///fallback is drawn with while the pipeline compiles, noPipeline draws nothing
+        [[nodiscard]] PipelineHandle request(const vkInit::GraphicsPipelineState& state,
+            PipelineHandle fallback = noPipeline);
+        ///the pipeline when ready, else the fallback's, else null
+        [[nodiscard]] vk::Pipeline get(PipelineHandle handle) const noexcept;
+        [[nodiscard]] bool ready(PipelineHandle handle) const noexcept;
+        ///blocks until the compile of handle finished, null if it failed
+        [[nodiscard]] std::expected<vk::Pipeline, EmptyErr> wait(PipelineHandle handle) noexcept;
+        ///no compile is running, never blocks
+        [[nodiscard]] bool idle() const noexcept;
+        ///a requested pipeline is built from the shader filename
+        [[nodiscard]] bool uses(std::string_view filename) const noexcept;
+
+        ///recompiles every pipeline with a shader in filenames, returns how many were submitted
+        uint32_t reload(std::span<const std::string> filenames);
+        ///puts the pipelines reload finished in place, retire gets each one they replace.
+        ///frames still in flight may draw with those, retire has to wait for them.
+        ///pipelines changed during their compile are submitted again
+        uint32_t swap(const std::function<void(vk::Pipeline)>& retire);
+
+        [[nodiscard]] PipelineRegistryStats stats() const noexcept;
+
+    private:
+        enum class Status : uint32_t { Pending, Ready, Failed };
+        ///state of a recompile, None when none was asked for since the last swap
+        enum class Reload : uint32_t { None, Pending, Ready, Failed };
+
+        struct Entry {
+            vkInit::GraphicsPipelineState state;
+            PipelineHandle fallback;
+            vk::Pipeline pipeline;
+            std::atomic<Status> status;
+            ///compiled by reload, swapped in for pipeline
+            vk::Pipeline replacement;
+            std::atomic<Reload> reload;
+            ///a shader changed while a compile was running, that compile may have read the
+            ///old code. swap recompiles once it finished, only touched by the owning thread
+            bool reloadAgain;
+            ///the first compile and every reload
+            JobCounter compiling;
+        };
+
+        ///recompiles entry from the shaders as they are now, nothing may be compiling it
+        void submit_reload(Entry* entry);
+
+        [[nodiscard]] static uint64_t hash(const vkInit::GraphicsPipelineState& state) noexcept;
+
+        vk::Device device;
+        PipelineCache* cache;
+        ShaderLibrary* shaders;
+        JobSystem* jobs;
+        ///indexed by handle, entries never move while their compile runs
+        std::deque<std::unique_ptr<Entry>> entries;
+        ///by hash of the state, equal hashes are told apart by comparing states
+        std::unordered_map<uint64_t, std::vector<PipelineHandle>> lookup;
+        uint32_t requests;
+        uint32_t deduplicated;
+        std::atomic<uint32_t> compiled;
+        std::atomic<uint32_t> failed;
+        uint32_t reloaded;
+        uint32_t reloadsFailed;
+    };
+}
@@ -15,11 +15,21 @@ export namespace vkUtil {
     export struct QueueFamilyIndices{
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        ///a family without graphics when the device has one, else the graphics family
+        std::optional<uint32_t> computeFamily;
+        ///a copy only family when the device has one, else the least busy one that copies
         std::optional<uint32_t> transferFamily;
 
-        ///check if both are presenst
+        ///check if every family was found
         bool is_complete() {
-            return graphicsFamily.has_value() && presentFamily.has_value() && transferFamily.has_value();
+            return graphicsFamily.has_value() && presentFamily.has_value() && computeFamily.has_value() && transferFamily.has_value();
+        }
+        ///compute submitted to computeFamily can run while the graphics queue is busy
+        bool dedicated_compute() const {
+            return computeFamily.has_value() && computeFamily != graphicsFamily;
+        }
+        bool dedicated_transfer() const {
+            return transferFamily.has_value() && transferFamily != graphicsFamily;
         }
     };
 
@@ -28,37 +38,87 @@ export namespace vkUtil {
         uint32_t queueFamilyIndex;
     };
 
+    ///how well a family with flags fits work that needs wanted, -1 when it cannot
+    ///do it. a family scores higher the less else it can do, so work lands on the
+    ///hardware queue built for it and leaves the graphics queue alone. graphics
+    ///and compute families copy as well, even when they do not say so
+    export [[nodiscard]] inline auto
+    score_queue_family(vk::QueueFlags flags, vk::QueueFlags wanted) noexcept -> int {
+        vk::QueueFlags capable = flags;
+        if (flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))
+            capable |= vk::QueueFlagBits::eTransfer;
+        if ((capable & wanted) != wanted)
+            return -1;
+        int score = 8;
+        if ((flags & vk::QueueFlagBits::eGraphics) && !(wanted & vk::QueueFlagBits::eGraphics))
+            score -= 4;
+        if ((flags & vk::QueueFlagBits::eCompute) && !(wanted & vk::QueueFlagBits::eCompute))
+            score -= 2;
+        return score;
+    }
+
     export [[nodiscard]] inline auto
     find_queue_families(vk::PhysicalDevice &device, vk::SurfaceKHR surface) noexcept -> QueueFamilyIndices {
         QueueFamilyIndices indices;
-        
+
         std::vector<vk::QueueFamilyProperties> queueFamilies;
         queueFamilies = device.getQueueFamilyProperties();
-       
+
         if (_DEBUG)
             std::cout << "Physical device supports " << queueFamilies.size() << " queue families.\n";
-        uint32_t i = 0;
-        indices.transferFamily = 1;
-        for (auto queueFamily : queueFamilies){
-            if (queueFamily.queueFlags & vk::QueueFlagBits::eGraphics){
-                indices.graphicsFamily = i;
-                if constexpr (_DEBUG){
-                    std::cout << "family queue index " << i << " supports graphics\n";
-                }
-            }
+        std::vector<bool> presents(queueFamilies.size(), false);
+        for (uint32_t i = 0; i < queueFamilies.size(); i++){
             //bool support;
             auto result = device.getSurfaceSupportKHR(i, surface);
-
             if (result.result != vk::Result::eSuccess)
                 continue;
-            if (result.value){
-                indices.presentFamily = i;
-                if constexpr(_DEBUG)
+            presents[i] = result.value;
+            if constexpr(_DEBUG)
+                if (result.value)
                     std::cout << "queue family " << i << "supports presenting.\n";
+        }
+
+        //a graphics family that presents saves handing the image between queues
+        for (uint32_t i = 0; i < queueFamilies.size(); i++){
+            if (!(queueFamilies[i].queueFlags & vk::QueueFlagBits::eGraphics))
+                continue;
+            if constexpr (_DEBUG){
+                std::cout << "family queue index " << i << " supports graphics\n";
+            }
+            if (!indices.graphicsFamily.has_value() || (presents[i] && !presents[indices.graphicsFamily.value()]))
+                indices.graphicsFamily = i;
+        }
+        if (indices.graphicsFamily.has_value() && presents[indices.graphicsFamily.value()])
+            indices.presentFamily = indices.graphicsFamily;
+        for (uint32_t i = 0; i < queueFamilies.size() && !indices.presentFamily.has_value(); i++)
+            if (presents[i])
+                indices.presentFamily = i;
+
+        //the best scoring family wins, ties go to the family not taken yet and then
+        //to the lower index. with one family, as on lavapipe, everything shares it
+        auto pick = [&](vk::QueueFlags wanted, std::optional<uint32_t> taken) -> std::optional<uint32_t> {
+            std::optional<uint32_t> best;
+            int bestScore = -1;
+            for (uint32_t i = 0; i < queueFamilies.size(); i++){
+                int score = score_queue_family(queueFamilies[i].queueFlags, wanted);
+                if (score < 0)
+                    continue;
+                score = score * 2 + (taken == i ? 0 : 1);
+                if (score > bestScore){
+                    best = i;
+                    bestScore = score;
+                }
             }
-            if (indices.is_complete())
-                return indices;
-            i++;
+            return best;
+        };
+        indices.computeFamily = pick(vk::QueueFlagBits::eCompute, indices.graphicsFamily);
+        indices.transferFamily = pick(vk::QueueFlagBits::eTransfer, indices.computeFamily);
+        if constexpr (_DEBUG){
+            if (indices.computeFamily.has_value())
+                std::cout << "compute runs on family " << indices.computeFamily.value()
+                    << (indices.dedicated_compute() ? ", next to graphics\n" : ", shared with graphics\n");
+            if (indices.transferFamily.has_value())
+                std::cout << "transfers run on family " << indices.transferFamily.value() << "\n";
         }
         return indices;
     }
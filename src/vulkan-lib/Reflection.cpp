@@ -0,0 +1,529 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.reflection;
+
+import <algorithm>;
+import <iostream>;
+import <unordered_map>;
+import vulkan_lib.logging;
+
+namespace vkInit {
+
+    namespace {
+        constexpr uint32_t spirvMagic = 0x07230203;
+
+        //the opcodes, decorations and storage classes of the spir-v spec this reads
+        enum Op : uint32_t {
+            OpEntryPoint = 15,
+            OpExecutionMode = 16,
+            OpTypeInt = 21,
+            OpTypeFloat = 22,
+            OpTypeVector = 23,
+            OpTypeMatrix = 24,
+            OpTypeImage = 25,
+            OpTypeSampler = 26,
+            OpTypeSampledImage = 27,
+            OpTypeArray = 28,
+            OpTypeRuntimeArray = 29,
+            OpTypeStruct = 30,
+            OpTypePointer = 32,
+            OpConstant = 43,
+            OpConstantComposite = 44,
+            OpSpecConstant = 50,
+            OpSpecConstantComposite = 51,
+            OpVariable = 59,
+            OpDecorate = 71,
+            OpMemberDecorate = 72,
+            OpTypeAccelerationStructureKHR = 5341,
+        };
+
+        enum Decoration : uint32_t {
+            DecorationSpecId = 1,
+            DecorationBlock = 2,
+            DecorationBufferBlock = 3,
+            DecorationArrayStride = 6,
+            DecorationBuiltIn = 11,
+            DecorationLocation = 30,
+            DecorationBinding = 33,
+            DecorationDescriptorSet = 34,
+            DecorationOffset = 35,
+        };
+
+        enum StorageClass : uint32_t {
+            StorageUniformConstant = 0,
+            StorageInput = 1,
+            StorageUniform = 2,
+            StoragePushConstant = 9,
+            StorageStorageBuffer = 12,
+        };
+
+        constexpr uint32_t executionModeLocalSize = 17;
+        constexpr uint32_t executionModeLocalSizeId = 38;
+        constexpr uint32_t builtInWorkgroupSize = 25;
+
+        constexpr uint32_t dimBuffer = 5;
+        constexpr uint32_t dimSubpassData = 6;
+
+        struct Decorations {
+            uint32_t set = 0;
+            uint32_t binding = 0;
+            uint32_t location = 0;
+            uint32_t arrayStride = 0;
+            uint32_t builtInKind = 0;
+            uint32_t specId = noSpecialization;
+            bool hasBinding = false;
+            bool hasLocation = false;
+            bool builtIn = false;
+            bool bufferBlock = false;
+        };
+
+        struct Type {
+            uint32_t opcode;
+            ///the operands after the result id
+            std::vector<uint32_t> operands;
+        };
+
+        struct Variable {
+            uint32_t id;
+            uint32_t pointerType;
+            uint32_t storageClass;
+        };
+
+        ///the instructions of one module indexed by result id
+        struct Module {
+            vk::ShaderStageFlags stage;
+            std::unordered_map<uint32_t, Type> types;
+            std::unordered_map<uint32_t, uint32_t> constants;
+            std::unordered_map<uint32_t, Decorations> decorations;
+            std::unordered_map<uint32_t, std::vector<uint32_t>> memberOffsets;
+            std::vector<Variable> variables;
+            ///constituents of composite constants, gl_WorkGroupSize is one
+            std::unordered_map<uint32_t, std::vector<uint32_t>> composites;
+            ///LocalSize literals, or the ids of LocalSizeId
+            uint32_t localSize[3] = { 1, 1, 1 };
+            bool localSizeIsId = false;
+
+            [[nodiscard]] const Type* type(uint32_t id) const {
+                auto found = types.find(id);
+                return found == types.end() ? nullptr : &found->second;
+            }
+
+            ///bytes a value of the type takes in a block, 0 for runtime arrays
+            [[nodiscard]] uint32_t size_of(uint32_t id) const {
+                const Type* t = type(id);
+                if (!t)
+                    return 0;
+                switch (t->opcode) {
+                case OpTypeInt:
+                case OpTypeFloat:
+                    return t->operands[0] / 8;
+                case OpTypeVector:
+                    return size_of(t->operands[0]) * t->operands[1];
+                case OpTypeMatrix: {
+                    //columns are laid out like vec4 when they have three components
+                    const Type* column = type(t->operands[0]);
+                    uint32_t columnSize = size_of(t->operands[0]);
+                    if (column && column->opcode == OpTypeVector && column->operands[1] == 3)
+                        columnSize = columnSize / 3 * 4;
+                    return columnSize * t->operands[1];
+                }
+                case OpTypeArray: {
+                    auto length = constants.find(t->operands[1]);
+                    auto decoration = decorations.find(id);
+                    const uint32_t stride = decoration != decorations.end() && decoration->second.arrayStride
+                        ? decoration->second.arrayStride : size_of(t->operands[0]);
+                    return length == constants.end() ? 0 : stride * length->second;
+                }
+                case OpTypeStruct: {
+                    auto offsets = memberOffsets.find(id);
+                    uint32_t size = 0;
+                    for (size_t member = 0; member < t->operands.size(); member++) {
+                        const uint32_t offset = offsets != memberOffsets.end() && member < offsets->second.size()
+                            ? offsets->second[member] : size;
+                        size = std::max(size, offset + size_of(t->operands[member]));
+                    }
+                    return size;
+                }
+                default:
+                    return 0;
+                }
+            }
+        };
+
+        [[nodiscard]] vk::ShaderStageFlags stage_of(uint32_t executionModel) {
+            switch (executionModel) {
+            case 0: return vk::ShaderStageFlagBits::eVertex;
+            case 1: return vk::ShaderStageFlagBits::eTessellationControl;
+            case 2: return vk::ShaderStageFlagBits::eTessellationEvaluation;
+            case 3: return vk::ShaderStageFlagBits::eGeometry;
+            case 4: return vk::ShaderStageFlagBits::eFragment;
+            case 5: return vk::ShaderStageFlagBits::eCompute;
+            default: return vk::ShaderStageFlags();
+            }
+        }
+
+        ///operands after the result id a type instruction needs for what this reads of it
+        [[nodiscard]] size_t min_operands(uint32_t opcode) {
+            switch (opcode) {
+            case OpTypeFloat: case OpTypeSampledImage: case OpTypeRuntimeArray: return 1;
+            case OpTypeInt: case OpTypeVector: case OpTypeMatrix: case OpTypeArray: case OpTypePointer: return 2;
+            case OpTypeImage: return 7;
+            default: return 0;
+            }
+        }
+
+        [[nodiscard]] std::expected<Module, EmptyErr> parse(std::span<const uint32_t> code) {
+            if (code.size() < 5 || code[0] != spirvMagic) {
+                errprintDebug("not a spir-v module");
+                return std::unexpected(EmptyErr{});
+            }
+            Module result;
+            size_t at = 5;
+            while (at < code.size()) {
+                const uint32_t wordCount = code[at] >> 16;
+                const uint32_t opcode = code[at] & 0xFFFF;
+                if (wordCount == 0 || at + wordCount > code.size()) {
+                    errprintDebug("truncated spir-v instruction");
+                    return std::unexpected(EmptyErr{});
+                }
+                std::span<const uint32_t> words = code.subspan(at + 1, wordCount - 1);
+                at += wordCount;
+
+                switch (opcode) {
+                case OpEntryPoint:
+                    //execution model, function id and at least one word of the name
+                    if (words.size() < 3) {
+                        errprintDebug("spir-v entry point is too short");
+                        return std::unexpected(EmptyErr{});
+                    }
+                    result.stage |= stage_of(words[0]);
+                    break;
+                case OpTypeInt: case OpTypeFloat: case OpTypeVector: case OpTypeMatrix:
+                case OpTypeImage: case OpTypeSampler: case OpTypeSampledImage: case OpTypeArray:
+                case OpTypeRuntimeArray: case OpTypeStruct: case OpTypePointer: case OpTypeAccelerationStructureKHR:
+                    //the helpers below index the operands of every type they meet without checking
+                    if (words.size() < 1 + min_operands(opcode)) {
+                        errprintDebug("spir-v type instruction is missing operands");
+                        return std::unexpected(EmptyErr{});
+                    }
+                    result.types[words[0]] = { opcode, std::vector<uint32_t>(words.begin() + 1, words.end()) };
+                    break;
+                case OpConstant:
+                case OpSpecConstant:
+                    if (words.size() >= 3)
+                        result.constants[words[1]] = words[2];
+                    break;
+                case OpConstantComposite:
+                case OpSpecConstantComposite:
+                    if (words.size() >= 2)
+                        result.composites[words[1]] = std::vector<uint32_t>(words.begin() + 2, words.end());
+                    break;
+                case OpExecutionMode:
+                    if (words.size() >= 5 && (words[1] == executionModeLocalSize || words[1] == executionModeLocalSizeId)) {
+                        result.localSizeIsId = words[1] == executionModeLocalSizeId;
+                        for (int axis = 0; axis < 3; axis++)
+                            result.localSize[axis] = words[2 + axis];
+                    }
+                    break;
+                case OpVariable:
+                    if (words.size() >= 3)
+                        result.variables.push_back({ words[1], words[0], words[2] });
+                    break;
+                case OpDecorate: {
+                    if (words.size() < 2)
+                        break;
+                    Decorations& decorations = result.decorations[words[0]];
+                    const uint32_t literal = words.size() > 2 ? words[2] : 0;
+                    switch (words[1]) {
+                    case DecorationDescriptorSet: decorations.set = literal; break;
+                    case DecorationBinding: decorations.binding = literal; decorations.hasBinding = true; break;
+                    case DecorationLocation: decorations.location = literal; decorations.hasLocation = true; break;
+                    case DecorationArrayStride: decorations.arrayStride = literal; break;
+                    case DecorationBuiltIn: decorations.builtIn = true; decorations.builtInKind = literal; break;
+                    case DecorationSpecId: decorations.specId = literal; break;
+                    case DecorationBufferBlock: decorations.bufferBlock = true; break;
+                    default: break;
+                    }
+                    break;
+                }
+                case OpMemberDecorate:
+                    if (words.size() >= 4 && words[2] == DecorationOffset) {
+                        std::vector<uint32_t>& offsets = result.memberOffsets[words[0]];
+                        if (offsets.size() <= words[1])
+                            offsets.resize(words[1] + 1, 0);
+                        offsets[words[1]] = words[3];
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+            return result;
+        }
+
+        ///the descriptor a resource variable takes, its arrays multiplied into count
+        [[nodiscard]] bool descriptor_of(const Module& module, const Variable& variable, vk::DescriptorType& type, uint32_t& count) {
+            const Type* pointer = module.type(variable.pointerType);
+            if (!pointer || pointer->opcode != OpTypePointer)
+                return false;
+            uint32_t id = pointer->operands[1];
+            count = 1;
+            const Type* t = module.type(id);
+            while (t && (t->opcode == OpTypeArray || t->opcode == OpTypeRuntimeArray)) {
+                if (t->opcode == OpTypeRuntimeArray)
+                    count = 0;
+                else {
+                    auto length = module.constants.find(t->operands[1]);
+                    count *= length == module.constants.end() ? 1 : length->second;
+                }
+                id = t->operands[0];
+                t = module.type(id);
+            }
+            if (!t)
+                return false;
+
+            switch (variable.storageClass) {
+            case StorageStorageBuffer:
+                type = vk::DescriptorType::eStorageBuffer;
+                return true;
+            case StorageUniform: {
+                auto decoration = module.decorations.find(id);
+                const bool bufferBlock = decoration != module.decorations.end() && decoration->second.bufferBlock;
+                type = bufferBlock ? vk::DescriptorType::eStorageBuffer : vk::DescriptorType::eUniformBuffer;
+                return true;
+            }
+            case StorageUniformConstant:
+                switch (t->opcode) {
+                case OpTypeSampledImage:
+                    type = vk::DescriptorType::eCombinedImageSampler;
+                    return true;
+                case OpTypeSampler:
+                    type = vk::DescriptorType::eSampler;
+                    return true;
+                case OpTypeAccelerationStructureKHR:
+                    type = vk::DescriptorType::eAccelerationStructureKHR;
+                    return true;
+                case OpTypeImage: {
+                    const uint32_t dim = t->operands[1];
+                    const bool storage = t->operands[5] == 2;
+                    if (dim == dimBuffer)
+                        type = storage ? vk::DescriptorType::eStorageTexelBuffer : vk::DescriptorType::eUniformTexelBuffer;
+                    else if (dim == dimSubpassData)
+                        type = vk::DescriptorType::eInputAttachment;
+                    else
+                        type = storage ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage;
+                    return true;
+                }
+                default:
+                    return false;
+                }
+            default:
+                return false;
+            }
+        }
+
+        ///the format of a vertex input of scalar or vector type
+        [[nodiscard]] vk::Format format_of(const Module& module, uint32_t id) {
+            const Type* t = module.type(id);
+            uint32_t components = 1;
+            if (t && t->opcode == OpTypeVector) {
+                components = t->operands[1];
+                t = module.type(t->operands[0]);
+            }
+            if (!t || (t->opcode != OpTypeFloat && t->opcode != OpTypeInt) || t->operands[0] != 32
+                || components < 1 || components > 4)
+                return vk::Format::eUndefined;
+            static constexpr vk::Format floats[] = { vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat,
+                vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat };
+            static constexpr vk::Format sints[] = { vk::Format::eR32Sint, vk::Format::eR32G32Sint,
+                vk::Format::eR32G32B32Sint, vk::Format::eR32G32B32A32Sint };
+            static constexpr vk::Format uints[] = { vk::Format::eR32Uint, vk::Format::eR32G32Uint,
+                vk::Format::eR32G32B32Uint, vk::Format::eR32G32B32A32Uint };
+            if (t->opcode == OpTypeFloat)
+                return floats[components - 1];
+            if (t->opcode == OpTypeInt)
+                return t->operands[1] ? sints[components - 1] : uints[components - 1];
+            return vk::Format::eUndefined;
+        }
+
+        [[nodiscard]] bool binding_order(const ReflectedBinding& a, const ReflectedBinding& b) {
+            return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+        }
+    }
+
+    [[nodiscard]] DescriptorSetLayoutData ShaderReflection::set_layout(uint32_t set) const {
+        DescriptorSetLayoutData layout = {};
+        layout.count = 0;
+        for (const ReflectedBinding& binding : bindings) {
+            if (binding.set != set)
+                continue;
+            layout.indices.push_back(static_cast<int>(binding.binding));
+            layout.types.push_back(binding.type);
+            layout.counts.push_back(static_cast<int>(binding.count));
+            layout.stages.push_back(binding.stages);
+            layout.count++;
+        }
+        return layout;
+    }
+
+    [[nodiscard]] std::vector<vk::PushConstantRange> ShaderReflection::push_constant_ranges() const {
+        if (pushConstantSize == 0)
+            return {};
+        return { vk::PushConstantRange(pushConstantStages, 0, pushConstantSize) };
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> ShaderReflection::merge(const ShaderReflection& other) {
+        stages |= other.stages;
+        for (const ReflectedBinding& binding : other.bindings) {
+            auto found = std::lower_bound(bindings.begin(), bindings.end(), binding, binding_order);
+            if (found == bindings.end() || found->set != binding.set || found->binding != binding.binding) {
+                bindings.insert(found, binding);
+                continue;
+            }
+            if (found->type != binding.type) {
+                errprintDebug("stages disagree on the type of a binding");
+                return std::unexpected(EmptyErr{});
+            }
+            found->stages |= binding.stages;
+            //a runtime array in any stage keeps the binding unbounded
+            found->count = found->count == 0 || binding.count == 0 ? 0 : std::max(found->count, binding.count);
+        }
+        if (other.pushConstantSize > 0) {
+            pushConstantSize = std::max(pushConstantSize, other.pushConstantSize);
+            pushConstantStages |= other.pushConstantStages;
+        }
+        if (other.stages & vk::ShaderStageFlagBits::eCompute) {
+            workgroupSize = other.workgroupSize;
+            workgroupSizeIds = other.workgroupSizeIds;
+        }
+        if (!other.vertexAttributes.empty()) {
+            vertexAttributes = other.vertexAttributes;
+            vertexStride = other.vertexStride;
+        }
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] auto
+    reflect_shader(std::span<const uint32_t> code) noexcept -> std::expected<ShaderReflection, EmptyErr> {
+        auto module_res = parse(code);
+        if (!module_res)
+            return std::unexpected(EmptyErr{});
+        const Module& module = module_res.value();
+
+        ShaderReflection reflection = {};
+        reflection.stages = module.stage;
+        struct Input {
+            uint32_t location;
+            vk::Format format;
+        };
+        std::vector<Input> inputs;
+        for (const Variable& variable : module.variables) {
+            auto decoration = module.decorations.find(variable.id);
+            const Decorations decorations = decoration == module.decorations.end() ? Decorations{} : decoration->second;
+
+            if (variable.storageClass == StoragePushConstant) {
+                const Type* pointer = module.type(variable.pointerType);
+                if (pointer && pointer->opcode == OpTypePointer) {
+                    reflection.pushConstantSize = std::max(reflection.pushConstantSize, module.size_of(pointer->operands[1]));
+                    reflection.pushConstantStages = module.stage;
+                }
+                continue;
+            }
+            if (variable.storageClass == StorageInput) {
+                //only what the vertex stage reads from buffers, not what earlier stages pass on
+                if (!(module.stage & vk::ShaderStageFlagBits::eVertex) || decorations.builtIn || !decorations.hasLocation)
+                    continue;
+                const Type* pointer = module.type(variable.pointerType);
+                const vk::Format format = pointer && pointer->opcode == OpTypePointer
+                    ? format_of(module, pointer->operands[1]) : vk::Format::eUndefined;
+                if (format == vk::Format::eUndefined) {
+                    errprintDebug("vertex input of a type no vertex format holds");
+                    return std::unexpected(EmptyErr{});
+                }
+                inputs.push_back({ decorations.location, format });
+                continue;
+            }
+            if (!decorations.hasBinding)
+                continue;
+            ReflectedBinding binding = {};
+            binding.set = decorations.set;
+            binding.binding = decorations.binding;
+            binding.stages = module.stage;
+            if (!descriptor_of(module, variable, binding.type, binding.count))
+                continue;
+            reflection.bindings.push_back(binding);
+        }
+        std::sort(reflection.bindings.begin(), reflection.bindings.end(), binding_order);
+
+        //a gl_WorkGroupSize composite overrides the execution mode, its
+        //constituents are specialization constants with local_size_x_id
+        std::vector<uint32_t> sizeIds;
+        for (const auto& [id, decorations] : module.decorations) {
+            if (decorations.builtIn && decorations.builtInKind == builtInWorkgroupSize && module.composites.contains(id))
+                sizeIds = module.composites.at(id);
+        }
+        if (sizeIds.empty() && module.localSizeIsId)
+            sizeIds.assign(module.localSize, module.localSize + 3);
+        for (uint32_t axis = 0; axis < 3; axis++) {
+            reflection.workgroupSize[axis] = module.localSize[axis];
+            reflection.workgroupSizeIds[axis] = noSpecialization;
+            if (axis >= sizeIds.size())
+                continue;
+            auto value = module.constants.find(sizeIds[axis]);
+            reflection.workgroupSize[axis] = value == module.constants.end() ? 1 : value->second;
+            auto decoration = module.decorations.find(sizeIds[axis]);
+            if (decoration != module.decorations.end())
+                reflection.workgroupSizeIds[axis] = decoration->second.specId;
+        }
+
+        //attributes are packed in location order, as the vertex buffers are filled
+        std::sort(inputs.begin(), inputs.end(), [](const Input& a, const Input& b) { return a.location < b.location; });
+        for (const Input& input : inputs) {
+            vk::VertexInputAttributeDescription attribute = {};
+            attribute.binding = 0;
+            attribute.location = input.location;
+            attribute.format = input.format;
+            attribute.offset = reflection.vertexStride;
+            reflection.vertexAttributes.push_back(attribute);
+            uint32_t components = 1;
+            switch (input.format) {
+            case vk::Format::eR32G32Sfloat: case vk::Format::eR32G32Sint: case vk::Format::eR32G32Uint:
+                components = 2; break;
+            case vk::Format::eR32G32B32Sfloat: case vk::Format::eR32G32B32Sint: case vk::Format::eR32G32B32Uint:
+                components = 3; break;
+            case vk::Format::eR32G32B32A32Sfloat: case vk::Format::eR32G32B32A32Sint: case vk::Format::eR32G32B32A32Uint:
+                components = 4; break;
+            default:
+                break;
+            }
+            reflection.vertexStride += components * 4;
+        }
+        return reflection;
+    }
+
+    [[nodiscard]] auto
+    reflect_file(const vkl::ShaderLibrary& shaders, const std::string& filename) noexcept -> std::expected<ShaderReflection, EmptyErr> {
+        auto code_res = shaders.code(filename);
+        if (!code_res)
+            return std::unexpected(EmptyErr{});
+        auto reflection_res = reflect_shader(code_res.value());
+        if constexpr (_DEBUG) {
+            if (!reflection_res)
+                std::cerr << "failed to reflect " << filename << '\n';
+        }
+        return reflection_res;
+    }
+
+    [[nodiscard]] auto
+    reflect_files(const vkl::ShaderLibrary& shaders, std::span<const std::string> filenames) noexcept -> std::expected<ShaderReflection, EmptyErr> {
+        ShaderReflection merged = {};
+        for (const std::string& filename : filenames) {
+            auto reflection_res = reflect_file(shaders, filename);
+            if (!reflection_res || !merged.merge(reflection_res.value()))
+                return std::unexpected(EmptyErr{});
+        }
+        return merged;
+    }
+}
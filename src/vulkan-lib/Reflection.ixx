@@ -0,0 +1,67 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.reflection;
+
+import <array>;
+import <expected>;
+import <span>;
+import <string>;
+import <vector>;
+import vulkan_lib.descriptors;
+import vulkan_lib.result;
+import vulkan_lib.shaderLibrary;
+
+namespace vkInit {
+
+    ///marks a workgroup size that is not a specialization constant
+    export constexpr uint32_t noSpecialization = 0xFFFFFFFF;
+
+    export struct ReflectedBinding {
+        uint32_t set;
+        uint32_t binding;
+        vk::DescriptorType type;
+        ///0 for runtime arrays, their size is chosen when the layout is made
+        uint32_t count;
+        vk::ShaderStageFlags stages;
+    };
+
+    ///what a pipeline needs to know about its shaders, read from their spir-v.
+    ///
+    ///reflecting every stage and merging them gives the bindings of every set
+    ///with the stages that use them, one push constant range covering every
+    ///stage's block and the vertex input of the vertex stage, packed in
+    ///location order into binding 0.
+    export struct ShaderReflection {
+        vk::ShaderStageFlags stages;
+        ///sorted by set then binding
+        std::vector<ReflectedBinding> bindings;
+        uint32_t pushConstantSize;
+        vk::ShaderStageFlags pushConstantStages;
+        std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+        uint32_t vertexStride;
+        ///local size of a compute stage as compiled, 1 1 1 for other stages
+        std::array<uint32_t, 3> workgroupSize;
+        ///constant_id overriding each axis of workgroupSize, or noSpecialization
+        std::array<uint32_t, 3> workgroupSizeIds;
+
+        ///the bindings of set, for the layout cache
+        [[nodiscard]] DescriptorSetLayoutData set_layout(uint32_t set) const;
+        ///empty when no stage declares push constants
+        [[nodiscard]] std::vector<vk::PushConstantRange> push_constant_ranges() const;
+        ///fails when both declare a binding with different types
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> merge(const ShaderReflection& other);
+    };
+
+    export [[nodiscard]] auto
+    reflect_shader(std::span<const uint32_t> code) noexcept -> std::expected<ShaderReflection, EmptyErr>;
+
+    ///reflects the code shaders maps for filename
+    export [[nodiscard]] auto
+    reflect_file(const vkl::ShaderLibrary& shaders, const std::string& filename) noexcept -> std::expected<ShaderReflection, EmptyErr>;
+
+    ///reflects every file and merges them
+    export [[nodiscard]] auto
+    reflect_files(const vkl::ShaderLibrary& shaders, std::span<const std::string> filenames) noexcept -> std::expected<ShaderReflection, EmptyErr>;
+}
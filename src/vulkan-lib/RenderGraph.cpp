@@ -0,0 +1,430 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.renderGraph;
+
+import <algorithm>;
+import <limits>;
+import vulkan_lib.image;
+import vulkan_lib.logging;
+import vulkan_lib.memory;
+
+namespace vkl {
+
+    constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+
+    constexpr vk::AccessFlags2 writeAccessMask = vk::AccessFlagBits2::eColorAttachmentWrite |
+        vk::AccessFlagBits2::eDepthStencilAttachmentWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+        vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eMemoryWrite;
+
+    struct UsageInfo {
+        vk::PipelineStageFlags2 stages;
+        vk::AccessFlags2 access;
+        vk::ImageLayout layout;
+        bool writes;
+    };
+
+    UsageInfo usage_info(ResourceUsage usage) noexcept {
+        switch (usage) {
+        case ResourceUsage::ColorAttachment:
+            return { vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+                vk::ImageLayout::eColorAttachmentOptimal, true };
+        case ResourceUsage::DepthAttachment:
+            return { vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                vk::AccessFlagBits2::eDepthStencilAttachmentRead | vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+                vk::ImageLayout::eDepthStencilAttachmentOptimal, true };
+        case ResourceUsage::SampledCompute:
+            return { vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead,
+                vk::ImageLayout::eShaderReadOnlyOptimal, false };
+        case ResourceUsage::StorageReadCompute:
+            return { vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageRead,
+                vk::ImageLayout::eGeneral, false };
+        case ResourceUsage::StorageWriteCompute:
+            return { vk::PipelineStageFlagBits2::eComputeShader,
+                vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite,
+                vk::ImageLayout::eGeneral, true };
+        case ResourceUsage::TransferWrite:
+            return { vk::PipelineStageFlagBits2::eAllTransfer, vk::AccessFlagBits2::eTransferWrite,
+                vk::ImageLayout::eTransferDstOptimal, true };
+        case ResourceUsage::IndirectRead:
+            return { vk::PipelineStageFlagBits2::eDrawIndirect, vk::AccessFlagBits2::eIndirectCommandRead,
+                vk::ImageLayout::eUndefined, false };
+        case ResourceUsage::VertexShaderRead:
+            return { vk::PipelineStageFlagBits2::eVertexShader, vk::AccessFlagBits2::eShaderStorageRead,
+                vk::ImageLayout::eUndefined, false };
+        case ResourceUsage::Present:
+            return { vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone,
+                vk::ImageLayout::ePresentSrcKHR, false };
+        }
+        return {};
+    }
+
+    //a layout transition counts as a write at the stages of the use
+    void RenderGraph::advance(State& state, const Use& use, bool transitioned) noexcept {
+        if (use.writes)
+            state = { use.stages, use.access & writeAccessMask, vk::PipelineStageFlags2(), use.layout };
+        else if (transitioned)
+            state = { use.stages, vk::AccessFlags2(), use.stages, use.layout };
+        else
+            state.readStages |= use.stages;
+    }
+
+    RenderGraph::RenderGraph() : statistics{} {
+    }
+
+    RenderGraph::~RenderGraph() {
+        destroy_transients();
+    }
+
+    void RenderGraph::reset(vk::Device device, vk::PhysicalDevice physicalDevice) noexcept {
+        destroy_transients();
+        this->device = device;
+        this->physicalDevice = physicalDevice;
+        resources.clear();
+        passes.clear();
+        order.clear();
+        finalBarriers = {};
+        statistics = {};
+    }
+
+    [[nodiscard]] uint32_t RenderGraph::import_image(std::string name, vk::ImageAspectFlags aspect, vk::PipelineStageFlags2 waitStage) {
+        Resource resource = {};
+        resource.name = std::move(name);
+        resource.isImage = true;
+        resource.desc.aspect = aspect;
+        resource.waitStage = waitStage;
+        resource.memoryBlock = unused;
+        resources.push_back(resource);
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    [[nodiscard]] uint32_t RenderGraph::create_image(std::string name, const ImageDesc& desc) {
+        Resource resource = {};
+        resource.name = std::move(name);
+        resource.isImage = true;
+        resource.transient = true;
+        resource.desc = desc;
+        resource.memoryBlock = unused;
+        resources.push_back(resource);
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    [[nodiscard]] uint32_t RenderGraph::import_buffer(std::string name) {
+        Resource resource = {};
+        resource.name = std::move(name);
+        resource.memoryBlock = unused;
+        resources.push_back(resource);
+        return static_cast<uint32_t>(resources.size() - 1);
+    }
+
+    [[nodiscard]] uint32_t RenderGraph::add_pass(std::string name, Execute execute) {
+        Pass pass = {};
+        pass.name = std::move(name);
+        pass.execute = std::move(execute);
+        passes.push_back(std::move(pass));
+        return static_cast<uint32_t>(passes.size() - 1);
+    }
+
+    void RenderGraph::use(uint32_t pass, uint32_t resource, ResourceUsage usage) {
+        UsageInfo info = usage_info(usage);
+        for (Use& existing : passes[pass].uses) {
+            if (existing.resource != resource)
+                continue;
+            if (resources[resource].isImage && existing.layout != info.layout)
+                vkInit::errprintDebug("render graph pass uses an image in two layouts");
+            existing.stages |= info.stages;
+            existing.access |= info.access;
+            existing.writes = existing.writes || info.writes;
+            return;
+        }
+        passes[pass].uses.push_back({ resource, info.stages, info.access, info.layout, info.writes });
+    }
+
+    void RenderGraph::keep(uint32_t pass) {
+        passes[pass].keep = true;
+    }
+
+    void RenderGraph::export_resource(uint32_t resource, ResourceUsage usage) {
+        resources[resource].exported = true;
+        resources[resource].exportUsage = usage;
+    }
+
+    void RenderGraph::cull() noexcept {
+        //walking backwards, a pass is needed when it writes something a needed pass or the outside reads
+        std::vector<bool> live(resources.size());
+        for (size_t i = 0; i < resources.size(); i++)
+            live[i] = resources[i].exported;
+        std::vector<bool> needed(passes.size(), false);
+        for (size_t p = passes.size(); p-- > 0;) {
+            bool need = passes[p].keep;
+            for (const Use& use : passes[p].uses)
+                need = need || (use.writes && live[use.resource]);
+            if (!need)
+                continue;
+            needed[p] = true;
+            for (const Use& use : passes[p].uses)
+                if (use.access & ~writeAccessMask)
+                    live[use.resource] = true;
+        }
+
+        order.clear();
+        for (Resource& resource : resources) {
+            resource.firstUse = unused;
+            resource.lastUse = unused;
+        }
+        for (uint32_t p = 0; p < passes.size(); p++) {
+            if (!needed[p])
+                continue;
+            const uint32_t position = static_cast<uint32_t>(order.size());
+            order.push_back(p);
+            for (const Use& use : passes[p].uses) {
+                Resource& resource = resources[use.resource];
+                if (resource.firstUse == unused)
+                    resource.firstUse = position;
+                resource.lastUse = position;
+            }
+        }
+        statistics.passes = static_cast<uint32_t>(order.size());
+        statistics.culledPasses = static_cast<uint32_t>(passes.size() - order.size());
+    }
+
+    [[nodiscard]] std::vector<RenderGraph::State> RenderGraph::final_states() const noexcept {
+        std::vector<State> states(resources.size(), State{});
+        for (uint32_t p : order)
+            for (const Use& use : passes[p].uses)
+                advance(states[use.resource], use, resources[use.resource].isImage && states[use.resource].layout != use.layout);
+        return states;
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> RenderGraph::allocate_transients() noexcept {
+        std::vector<uint32_t> transients;
+        std::vector<vk::MemoryRequirements> requirements(resources.size());
+        for (uint32_t r = 0; r < resources.size(); r++) {
+            Resource& resource = resources[r];
+            if (!resource.transient || resource.firstUse == unused)
+                continue;
+            vk::ImageCreateInfo imageInfo = {};
+            imageInfo.flags = vk::ImageCreateFlags();
+            imageInfo.imageType = vk::ImageType::e2D;
+            imageInfo.extent = vk::Extent3D(resource.desc.extent.width, resource.desc.extent.height, 1);
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = resource.desc.format;
+            imageInfo.tiling = vk::ImageTiling::eOptimal;
+            imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+            imageInfo.usage = resource.desc.usage;
+            imageInfo.sharingMode = vk::SharingMode::eExclusive;
+            imageInfo.samples = vk::SampleCountFlagBits::e1;
+            vk::ResultValue<vk::Image> imageR = device.createImage(imageInfo);
+            if (imageR.result != vk::Result::eSuccess) {
+                vkInit::errprintDebug("failed to create transient image");
+                return std::unexpected(EmptyErr{});
+            }
+            resource.image = imageR.value;
+            requirements[r] = device.getImageMemoryRequirements(resource.image);
+            transients.push_back(r);
+        }
+
+        //biggest first, each one goes to the first block it shares no pass with
+        std::sort(transients.begin(), transients.end(), [&](uint32_t a, uint32_t b) {
+            return requirements[a].size > requirements[b].size;
+        });
+        for (uint32_t r : transients) {
+            Resource& resource = resources[r];
+            statistics.unaliasedBytes += requirements[r].size;
+            uint32_t chosen = unused;
+            for (uint32_t b = 0; b < blocks.size() && chosen == unused; b++) {
+                if (!(blocks[b].memoryTypeBits & requirements[r].memoryTypeBits))
+                    continue;
+                bool overlaps = std::any_of(blocks[b].images.begin(), blocks[b].images.end(), [&](uint32_t other) {
+                    return resources[other].firstUse <= resource.lastUse && resource.firstUse <= resources[other].lastUse;
+                });
+                if (!overlaps)
+                    chosen = b;
+            }
+            if (chosen == unused) {
+                blocks.push_back({ 0, ~0u, {}, nullptr });
+                chosen = static_cast<uint32_t>(blocks.size() - 1);
+            }
+            MemoryBlock& block = blocks[chosen];
+            block.size = std::max(block.size, requirements[r].size);
+            block.memoryTypeBits &= requirements[r].memoryTypeBits;
+            block.images.push_back(r);
+            resource.memoryBlock = chosen;
+        }
+
+        for (MemoryBlock& block : blocks) {
+            auto memory_type_res = vkUtil::findMemoryTypeIndex(physicalDevice, block.memoryTypeBits, vk::MemoryPropertyFlagBits::eDeviceLocal);
+            if (!memory_type_res)
+                return std::unexpected(EmptyErr{});
+            vk::MemoryAllocateInfo allocInfo(block.size, memory_type_res.value());
+            vk::ResultValue<vk::DeviceMemory> memoryR = device.allocateMemory(allocInfo);
+            if (memoryR.result != vk::Result::eSuccess) {
+                vkInit::errprintDebug("failed to allocate transient memory");
+                return std::unexpected(EmptyErr{});
+            }
+            block.memory = memoryR.value;
+            statistics.transientBytes += block.size;
+
+            for (uint32_t r : block.images) {
+                Resource& resource = resources[r];
+                if (device.bindImageMemory(resource.image, block.memory, 0) != vk::Result::eSuccess)
+                    return std::unexpected(EmptyErr{});
+                auto view_res = vkUtil::make_image_view(device, resource.image, resource.desc.format, resource.desc.aspect, 0, 1);
+                if (!view_res)
+                    return std::unexpected(EmptyErr{});
+                resource.view = view_res.value();
+            }
+        }
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> RenderGraph::compile() noexcept {
+        destroy_transients();
+        statistics = {};
+        cull();
+        const std::vector<State> last = final_states();
+        if (!allocate_transients())
+            return std::unexpected(EmptyErr{});
+
+        //every image sharing a block may have touched its memory last frame
+        std::vector<State> blockStates(blocks.size(), State{});
+        for (uint32_t b = 0; b < blocks.size(); b++) {
+            for (uint32_t r : blocks[b].images) {
+                blockStates[b].writeStages |= last[r].writeStages | last[r].readStages;
+                blockStates[b].writeAccess |= last[r].writeAccess;
+            }
+        }
+
+        std::vector<State> states(resources.size(), State{});
+        for (uint32_t r = 0; r < resources.size(); r++) {
+            const Resource& resource = resources[r];
+            if (!resource.isImage)
+                states[r] = last[r];
+            else if (resource.transient && resource.memoryBlock != unused)
+                states[r] = blockStates[resource.memoryBlock];
+            else
+                states[r].writeStages = resource.waitStage;
+            if (resource.isImage)
+                states[r].layout = vk::ImageLayout::eUndefined;
+        }
+
+        for (uint32_t p : order) {
+            Barriers& barriers = passes[p].barriers;
+            barriers = {};
+            for (const Use& use : passes[p].uses)
+                add_barrier(barriers, use.resource, states[use.resource], use);
+            statistics.imageBarriers += static_cast<uint32_t>(barriers.images.size());
+            statistics.memoryBarriers += barriers.hasMemory ? 1 : 0;
+        }
+
+        finalBarriers = {};
+        for (uint32_t r = 0; r < resources.size(); r++) {
+            if (!resources[r].exported || resources[r].firstUse == unused)
+                continue;
+            UsageInfo info = usage_info(resources[r].exportUsage);
+            add_barrier(finalBarriers, r, states[r], { r, info.stages, info.access, info.layout, info.writes });
+        }
+        statistics.imageBarriers += static_cast<uint32_t>(finalBarriers.images.size());
+        statistics.memoryBarriers += finalBarriers.hasMemory ? 1 : 0;
+        return EmptyOk{};
+    }
+
+    void RenderGraph::add_barrier(Barriers& barriers, uint32_t resource, State& state, const Use& use) noexcept {
+        const bool isImage = resources[resource].isImage;
+        const bool transition = isImage && state.layout != use.layout;
+        const vk::ImageLayout oldLayout = state.layout;
+        vk::PipelineStageFlags2 srcStages = state.writeStages;
+        bool needed = transition;
+        if (use.writes) {
+            //write after write and write after read
+            srcStages |= state.readStages;
+            needed = needed || bool(srcStages);
+        }
+        else {
+            //read after write, unless an earlier barrier already made it visible to these stages
+            needed = needed || (bool(state.writeStages) && bool(use.stages & ~state.readStages));
+        }
+        const vk::AccessFlags2 srcAccess = state.writeAccess;
+        advance(state, use, transition);
+        if (!needed)
+            return;
+
+        if (!isImage) {
+            barriers.memory.srcStageMask |= srcStages;
+            barriers.memory.srcAccessMask |= srcAccess;
+            barriers.memory.dstStageMask |= use.stages;
+            barriers.memory.dstAccessMask |= use.access;
+            barriers.hasMemory = true;
+            return;
+        }
+        vk::ImageMemoryBarrier2 barrier = {};
+        barrier.srcStageMask = srcStages;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstStageMask = use.stages;
+        barrier.dstAccessMask = use.access;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = use.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.subresourceRange = vk::ImageSubresourceRange(resources[resource].desc.aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS);
+        barriers.images.push_back(barrier);
+        barriers.imageResources.push_back(resource);
+    }
+
+    void RenderGraph::record_barriers(vk::CommandBuffer commandBuffer, Barriers& barriers) noexcept {
+        if (barriers.images.empty() && !barriers.hasMemory)
+            return;
+        for (size_t i = 0; i < barriers.images.size(); i++)
+            barriers.images[i].image = resources[barriers.imageResources[i]].image;
+        vk::DependencyInfo dependency = {};
+        dependency.memoryBarrierCount = barriers.hasMemory ? 1 : 0;
+        dependency.pMemoryBarriers = &barriers.memory;
+        dependency.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.images.size());
+        dependency.pImageMemoryBarriers = barriers.images.data();
+        commandBuffer.pipelineBarrier2(dependency);
+    }
+
+    void RenderGraph::execute(vk::CommandBuffer commandBuffer) noexcept {
+        for (uint32_t p : order) {
+            record_barriers(commandBuffer, passes[p].barriers);
+            passes[p].execute(commandBuffer);
+        }
+        record_barriers(commandBuffer, finalBarriers);
+    }
+
+    void RenderGraph::bind_image(uint32_t resource, vk::Image image) noexcept {
+        resources[resource].image = image;
+    }
+
+    [[nodiscard]] vk::Image RenderGraph::image(uint32_t resource) const noexcept {
+        return resources[resource].image;
+    }
+
+    [[nodiscard]] vk::ImageView RenderGraph::view(uint32_t resource) const noexcept {
+        return resources[resource].view;
+    }
+
+    [[nodiscard]] RenderGraphStats RenderGraph::stats() const noexcept {
+        return statistics;
+    }
+
+    void RenderGraph::destroy_transients() noexcept {
+        for (Resource& resource : resources) {
+            if (!resource.transient)
+                continue;
+            if (resource.view)
+                device.destroyImageView(resource.view);
+            if (resource.image)
+                device.destroyImage(resource.image);
+            resource.view = nullptr;
+            resource.image = nullptr;
+            resource.memoryBlock = unused;
+        }
+        for (MemoryBlock& block : blocks)
+            device.freeMemory(block.memory);
+        blocks.clear();
+    }
+}
@@ -0,0 +1,168 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.renderGraph;
+
+import <expected>;
+import <functional>;
+import <string>;
+import <vector>;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    ///how a pass touches a resource, decides the stages, accesses and layout it is synchronized with
+    export enum class ResourceUsage {
+        ColorAttachment,
+        DepthAttachment,
+        SampledCompute,
+        StorageReadCompute,
+        StorageWriteCompute,
+        TransferWrite,
+        IndirectRead,
+        VertexShaderRead,
+        Present,
+    };
+
+    export struct ImageDesc {
+        vk::Extent2D extent;
+        vk::Format format;
+        vk::ImageUsageFlags usage;
+        vk::ImageAspectFlags aspect;
+    };
+
+    export struct RenderGraphStats {
+        uint32_t passes;
+        uint32_t culledPasses;
+        uint32_t imageBarriers;
+        uint32_t memoryBarriers;
+        vk::DeviceSize transientBytes;
+        ///what the transient images would take without sharing memory
+        vk::DeviceSize unaliasedBytes;
+    };
+
+    ///frame graph of passes that declare how they use images and buffers.
+    ///
+    ///passes run in declaration order, which every dependency follows since
+    ///they are inferred from it. compile drops passes whose results nobody
+    ///reads, works out the synchronization2 barriers each pass needs before it
+    ///runs and places transient images whose lifetimes do not overlap in the
+    ///same memory. the result is reused every frame, only imported images are
+    ///bound again.
+    ///
+    ///images start every frame with undefined contents. buffers are only
+    ///synchronized with global memory barriers so they carry no handle, and a
+    ///resource's first use in a frame waits for its last use in the previous one.
+    export class RenderGraph {
+    public:
+        using Execute = std::function<void(vk::CommandBuffer)>;
+
+        RenderGraph();
+        ~RenderGraph();
+        RenderGraph(const RenderGraph& ref) = delete;
+        RenderGraph& operator=(const RenderGraph& ref) = delete;
+
+        ///drops every declaration and frees the transient images
+        void reset(vk::Device device, vk::PhysicalDevice physicalDevice) noexcept;
+
+        ///an image owned elsewhere, bound with bind_image before every execute.
+        ///its first use waits for waitStage, the stage its acquire semaphore is waited at
+        [[nodiscard]] uint32_t import_image(std::string name, vk::ImageAspectFlags aspect, vk::PipelineStageFlags2 waitStage);
+        ///an image the graph allocates, it only lives during the frame
+        [[nodiscard]] uint32_t create_image(std::string name, const ImageDesc& desc);
+        [[nodiscard]] uint32_t import_buffer(std::string name);
+
+        [[nodiscard]] uint32_t add_pass(std::string name, Execute execute);
+        ///a pass using a resource several ways gets the usages merged, the
+        ///order inside the pass is its own business
+        void use(uint32_t pass, uint32_t resource, ResourceUsage usage);
+        ///the pass writes something read outside the graph and is never culled
+        void keep(uint32_t pass);
+        ///the resource is used after the graph, in usage
+        void export_resource(uint32_t resource, ResourceUsage usage);
+
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> compile() noexcept;
+
+        void bind_image(uint32_t resource, vk::Image image) noexcept;
+        [[nodiscard]] vk::Image image(uint32_t resource) const noexcept;
+        [[nodiscard]] vk::ImageView view(uint32_t resource) const noexcept;
+
+        void execute(vk::CommandBuffer commandBuffer) noexcept;
+
+        [[nodiscard]] RenderGraphStats stats() const noexcept;
+
+    private:
+        struct Resource {
+            std::string name;
+            bool isImage;
+            bool transient;
+            ImageDesc desc;
+            vk::PipelineStageFlags2 waitStage;
+            vk::Image image;
+            vk::ImageView view;
+            uint32_t memoryBlock;
+            bool exported;
+            ResourceUsage exportUsage;
+            uint32_t firstUse;
+            uint32_t lastUse;
+        };
+
+        struct Use {
+            uint32_t resource;
+            vk::PipelineStageFlags2 stages;
+            vk::AccessFlags2 access;
+            vk::ImageLayout layout;
+            bool writes;
+        };
+
+        ///where a resource was left by the passes recorded so far
+        struct State {
+            vk::PipelineStageFlags2 writeStages;
+            vk::AccessFlags2 writeAccess;
+            vk::PipelineStageFlags2 readStages;
+            vk::ImageLayout layout;
+        };
+
+        struct Barriers {
+            std::vector<vk::ImageMemoryBarrier2> images;
+            std::vector<uint32_t> imageResources;
+            vk::MemoryBarrier2 memory;
+            bool hasMemory;
+        };
+
+        struct Pass {
+            std::string name;
+            Execute execute;
+            std::vector<Use> uses;
+            bool keep;
+            Barriers barriers;
+        };
+
+        ///transient images sharing one allocation, all bound at offset 0
+        struct MemoryBlock {
+            vk::DeviceSize size;
+            uint32_t memoryTypeBits;
+            std::vector<uint32_t> images;
+            vk::DeviceMemory memory;
+        };
+
+        ///what a resource is left in once use ran
+        static void advance(State& state, const Use& use, bool transitioned) noexcept;
+        void cull() noexcept;
+        [[nodiscard]] std::vector<State> final_states() const noexcept;
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> allocate_transients() noexcept;
+        void add_barrier(Barriers& barriers, uint32_t resource, State& state, const Use& use) noexcept;
+        void record_barriers(vk::CommandBuffer commandBuffer, Barriers& barriers) noexcept;
+        void destroy_transients() noexcept;
+
+        vk::Device device;
+        vk::PhysicalDevice physicalDevice;
+        std::vector<Resource> resources;
+        std::vector<Pass> passes;
+        std::vector<uint32_t> order;
+        std::vector<MemoryBlock> blocks;
+        Barriers finalBarriers;
+        RenderGraphStats statistics;
+    };
+}
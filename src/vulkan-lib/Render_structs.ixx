@@ -8,8 +8,27 @@ import <glm/glm.hpp>;
 import <glm/gtc/matrix_transform.hpp>;
 
 namespace vkInit{
+    ///material value telling the shaders to read the per instance material ids
+    export constexpr uint32_t noMaterial = 0xFFFFFFFF;
+
+    ///per draw data pushed as constants, draws differing only in it bind nothing
     export struct ObjectData{
+        ///applied before every instance transform of the draw
         glm::mat4 model;
+        ///material of every instance of the draw, or noMaterial
+        uint32_t material;
+        uint32_t drawIndex;
+        uint32_t padding[2];
     };
+    //the smallest push constant block a device may offer
+    static_assert(sizeof(ObjectData) <= 128);
+
+    export constexpr vk::ShaderStageFlags objectDataStages = vk::ShaderStageFlagBits::eVertex;
+
+    ///the set per draw buffers are pushed to, after the frame and bindless sets
+    export constexpr uint32_t drawSet = 2;
+
+    ///constant_id of shader.vert's INSTANCE_COLORS, tints the first instances
+    export constexpr uint32_t instanceColorsConstant = 0;
 
 }
@@ -24,23 +24,4 @@ namespace vkInit{
         file.close();
         return content;
     }
-
-    export [[nodiscard]] inline auto
-    create_module(std::string filename, vk::Device device) noexcept -> std::expected<vk::ShaderModule, EmptyErr> {
-        std::expected<std::vector<char>, EmptyErr> contentsR = read_file(filename);
-        if (!contentsR)
-            return std::unexpected(EmptyErr{});
-        std::vector<char> contents = contentsR.value();
-        vk::ShaderModuleCreateInfo createInfo = {};
-        createInfo.flags = vk::ShaderModuleCreateFlags();
-        createInfo.codeSize = contents.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t *>(contents.data());
-        vk::ResultValue<vk::ShaderModule> moduleR = device.createShaderModule(createInfo);
-        if (moduleR.result != vk::Result::eSuccess){
-            if constexpr(_DEBUG)
-                std::cerr << "afiled to create shader module with file " << filename << '\n';
-            return std::unexpected(EmptyErr{});
-        }
-        return moduleR.value;
-    }
-}
+}
\ No newline at end of file
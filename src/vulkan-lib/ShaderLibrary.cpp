@@ -0,0 +1,415 @@
+module;
+
+#include "vulkan-lib/Config.h"
+#include <fstream>
+#include <cstring>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+module vulkan_lib.shaderLibrary;
+
+import <algorithm>;
+import <filesystem>;
+import <iostream>;
+import <vector>;
+import vulkan_lib.hash;
+import vulkan_lib.logging;
+import vulkan_lib.shader;
+
+namespace vkl {
+
+    namespace {
+        constexpr uint32_t archiveMagic = 0x41534B56; // "VKSA"
+        constexpr uint32_t archiveVersion = 1;
+        constexpr size_t maxNameLength = 55;
+
+        struct ArchiveHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t count;
+            uint32_t reserved;
+        };
+
+        ///one per blob, right after the header
+        struct ArchiveEntry {
+            ///null terminated file name
+            char name[maxNameLength + 1];
+            uint64_t hash;
+            ///bytes from the start of the archive, a multiple of 4
+            uint32_t offset;
+            uint32_t size;
+        };
+
+        [[nodiscard]] uint64_t hash_code(std::span<const uint32_t> code) noexcept {
+            uint64_t seed = code.size();
+            for (uint32_t word : code)
+                seed = hash_combine(seed, word);
+            return seed;
+        }
+
+        ///every .spv of directory, sorted by name so equal inputs pack the same archive
+        [[nodiscard]] std::vector<std::filesystem::path> spirv_files(const std::string& directory) noexcept {
+            std::vector<std::filesystem::path> files;
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+                if (entry.is_regular_file(error) && entry.path().extension() == ".spv")
+                    files.push_back(entry.path());
+            }
+            std::sort(files.begin(), files.end());
+            return files;
+        }
+
+        ///true when the archive is missing or a .spv was written after it
+        [[nodiscard]] bool archive_stale(const std::string& directory, const std::string& archivePath) noexcept {
+            std::error_code error;
+            const auto archiveTime = std::filesystem::last_write_time(archivePath, error);
+            if (error)
+                return true;
+            for (const std::filesystem::path& file : spirv_files(directory)) {
+                const auto fileTime = std::filesystem::last_write_time(file, error);
+                if (!error && fileTime > archiveTime)
+                    return true;
+            }
+            return false;
+        }
+
+        ///every .spv of directory packed into one archive, as words so the blobs stay aligned
+        [[nodiscard]] std::expected<std::vector<uint32_t>, EmptyErr> pack_words(const std::string& directory) noexcept {
+            const std::vector<std::filesystem::path> files = spirv_files(directory);
+            if (files.empty()) {
+                vkInit::errprintDebug("no .spv files to pack and no shader archive");
+                return std::unexpected(EmptyErr{});
+            }
+
+            std::vector<ArchiveEntry> entries(files.size());
+            std::vector<std::vector<char>> contents(files.size());
+            uint32_t offset = static_cast<uint32_t>(sizeof(ArchiveHeader) + entries.size() * sizeof(ArchiveEntry));
+            for (size_t i = 0; i < files.size(); i++) {
+                const std::string name = files[i].filename().string();
+                auto file_res = vkInit::read_file(files[i].string());
+                if (!file_res)
+                    return std::unexpected(EmptyErr{});
+                contents[i] = std::move(file_res.value());
+                if (name.size() > maxNameLength || contents[i].size() % sizeof(uint32_t) != 0) {
+                    if constexpr (_DEBUG)
+                        std::cerr << "cannot pack " << name << ", name too long or not spir-v\n";
+                    return std::unexpected(EmptyErr{});
+                }
+                std::vector<uint32_t> words(contents[i].size() / sizeof(uint32_t));
+                std::memcpy(words.data(), contents[i].data(), contents[i].size());
+
+                ArchiveEntry& entry = entries[i];
+                std::memset(&entry, 0, sizeof(entry));
+                std::memcpy(entry.name, name.data(), name.size());
+                entry.hash = hash_code(words);
+                entry.offset = offset;
+                entry.size = static_cast<uint32_t>(contents[i].size());
+                offset += entry.size;
+            }
+
+            std::vector<uint32_t> archive(offset / sizeof(uint32_t));
+            char* bytes = reinterpret_cast<char*>(archive.data());
+            const ArchiveHeader header = { archiveMagic, archiveVersion, static_cast<uint32_t>(entries.size()), 0 };
+            std::memcpy(bytes, &header, sizeof(header));
+            std::memcpy(bytes + sizeof(header), entries.data(), entries.size() * sizeof(ArchiveEntry));
+            for (size_t i = 0; i < files.size(); i++)
+                std::memcpy(bytes + entries[i].offset, contents[i].data(), contents[i].size());
+            return archive;
+        }
+    }
+
+    ShaderLibrary::Archive::Archive() : mapping(nullptr), size(0) {
+    }
+
+    ShaderLibrary::Archive::~Archive() {
+        if (!mapping)
+            return;
+#if defined(_WIN32)
+        UnmapViewOfFile(mapping);
+#else
+        munmap(const_cast<void*>(mapping), size);
+#endif
+    }
+
+    ShaderLibrary::ShaderLibrary() : archive(std::make_shared<Archive>()), jobs(nullptr), reloadRunning(false), staleModules(false), repacked(false),
+        modulesCreated(0), moduleHits(0), reloads(0) {
+    }
+
+    ShaderLibrary::~ShaderLibrary() {
+        destroy();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> ShaderLibrary::make(vk::Device device, std::string directory,
+        std::string archivePath) noexcept {
+        destroy();
+        this->device = device;
+        this->directory = std::move(directory);
+        this->archivePath = std::move(archivePath);
+        repacked = false;
+        modulesCreated = 0;
+        moduleHits = 0;
+        reloads = 0;
+
+        //only a development tree has .spv files newer than the archive
+        if (archive_stale(this->directory, this->archivePath)) {
+            if (!pack(this->directory, this->archivePath))
+                return std::unexpected(EmptyErr{});
+            repacked = true;
+        }
+        auto archive_res = map(this->archivePath);
+        if (!archive_res)
+            return std::unexpected(EmptyErr{});
+        std::lock_guard lock(archiveMutex);
+        archive = std::move(archive_res.value());
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] bool ShaderLibrary::begin_reload(JobSystem& jobs) noexcept {
+        if (reloadRunning)
+            return false;
+        this->jobs = &jobs;
+        reloadRunning = true;
+        loaded = nullptr;
+        //the mapped file is left alone, windows refuses to replace it while mapped
+        jobs.submit_background([this]() {
+            auto words_res = pack_words(directory);
+            if (!words_res)
+                return;
+            auto read = std::make_shared<Archive>();
+            read->words = std::move(words_res.value());
+            read->size = read->words.size() * sizeof(uint32_t);
+            if (parse(*read, read->words.data()))
+                loaded = std::move(read);
+        }, &reloading);
+        return true;
+    }
+
+    [[nodiscard]] ArchiveReload ShaderLibrary::finish_reload() noexcept {
+        if (!reloadRunning)
+            return ArchiveReload::None;
+        if (!reloading.done())
+            return ArchiveReload::Running;
+        reloadRunning = false;
+        if (!loaded) {
+            vkInit::errprintDebug("failed to read the changed shaders, keeping the old archive");
+            return ArchiveReload::Failed;
+        }
+        {
+            std::lock_guard lock(archiveMutex);
+            archive = std::move(loaded);
+        }
+        loaded = nullptr;
+        staleModules = true;
+        reloads++;
+        return ArchiveReload::Swapped;
+    }
+
+    void ShaderLibrary::purge_modules() noexcept {
+        if (!staleModules)
+            return;
+        staleModules = false;
+        const std::shared_ptr<const Archive> used = current();
+        std::lock_guard lock(moduleMutex);
+        for (auto module = modules.begin(); module != modules.end();) {
+            const bool kept = std::any_of(used->blobs.begin(), used->blobs.end(),
+                [&module](const auto& blob) { return blob.second.hash == module->first; });
+            if (kept)
+                module++;
+            else {
+                device.destroyShaderModule(module->second);
+                module = modules.erase(module);
+            }
+        }
+    }
+
+    void ShaderLibrary::destroy() noexcept {
+        if (reloadRunning) {
+            jobs->wait(reloading);
+            reloadRunning = false;
+        }
+        loaded = nullptr;
+        staleModules = false;
+        for (auto& [hash, module] : modules)
+            device.destroyShaderModule(module);
+        modules.clear();
+        std::lock_guard lock(archiveMutex);
+        archive = std::make_shared<Archive>();
+    }
+
+    [[nodiscard]] std::shared_ptr<const ShaderLibrary::Archive> ShaderLibrary::current() const noexcept {
+        std::lock_guard lock(archiveMutex);
+        return archive;
+    }
+
+    [[nodiscard]] std::expected<std::span<const uint32_t>, EmptyErr> ShaderLibrary::code(std::string_view name) const noexcept {
+        const std::shared_ptr<const Archive> used = current();
+        auto found = used->blobs.find(name);
+        if (found == used->blobs.end()) {
+            if constexpr (_DEBUG)
+                std::cerr << "shader " << name << " is not in the archive\n";
+            return std::unexpected(EmptyErr{});
+        }
+        return found->second.code;
+    }
+
+    [[nodiscard]] std::expected<vk::ShaderModule, EmptyErr> ShaderLibrary::module(std::string_view name) noexcept {
+        //held until the module is made, a reload may swap the archive meanwhile
+        const std::shared_ptr<const Archive> used = current();
+        auto found = used->blobs.find(name);
+        if (found == used->blobs.end()) {
+            if constexpr (_DEBUG)
+                std::cerr << "shader " << name << " is not in the archive\n";
+            return std::unexpected(EmptyErr{});
+        }
+        const Blob& blob = found->second;
+
+        std::lock_guard lock(moduleMutex);
+        auto cached = modules.find(blob.hash);
+        if (cached != modules.end()) {
+            moduleHits++;
+            return cached->second;
+        }
+        vk::ShaderModuleCreateInfo createInfo = {};
+        createInfo.flags = vk::ShaderModuleCreateFlags();
+        createInfo.codeSize = blob.code.size_bytes();
+        createInfo.pCode = blob.code.data();
+        vk::ResultValue<vk::ShaderModule> moduleR = device.createShaderModule(createInfo);
+        if (moduleR.result != vk::Result::eSuccess) {
+            if constexpr (_DEBUG)
+                std::cerr << "failed to create shader module " << name << '\n';
+            return std::unexpected(EmptyErr{});
+        }
+        modules.emplace(blob.hash, moduleR.value);
+        modulesCreated++;
+        return moduleR.value;
+    }
+
+    [[nodiscard]] ShaderLibraryStats ShaderLibrary::stats() const noexcept {
+        const std::shared_ptr<const Archive> used = current();
+        ShaderLibraryStats result = {};
+        result.repacked = repacked;
+        result.archiveBytes = used->size;
+        result.shaders = static_cast<uint32_t>(used->blobs.size());
+        result.modulesCreated = modulesCreated.load();
+        result.moduleHits = moduleHits.load();
+        result.reloads = reloads;
+        return result;
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> ShaderLibrary::pack(const std::string& directory,
+        const std::string& archivePath) noexcept {
+        auto words_res = pack_words(directory);
+        if (!words_res)
+            return std::unexpected(EmptyErr{});
+        const std::vector<uint32_t>& words = words_res.value();
+
+        //written next to the old archive and renamed over it once complete
+        const std::string temporary = archivePath + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(words.data()), static_cast<std::streamsize>(words.size() * sizeof(uint32_t)));
+            file.flush();
+            if (!file.good()) {
+                vkInit::errprintDebug("failed to write shader archive");
+                return std::unexpected(EmptyErr{});
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, archivePath, error);
+        if (error) {
+            vkInit::errprintDebug("failed to replace shader archive");
+            std::filesystem::remove(temporary, error);
+            return std::unexpected(EmptyErr{});
+        }
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] std::expected<std::shared_ptr<ShaderLibrary::Archive>, EmptyErr> ShaderLibrary::map(const std::string& archivePath) noexcept {
+        auto archive = std::make_shared<Archive>();
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(archivePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            vkInit::errprintDebug("failed to open shader archive");
+            return std::unexpected(EmptyErr{});
+        }
+        LARGE_INTEGER size = {};
+        if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(ArchiveHeader))) {
+            CloseHandle(file);
+            vkInit::errprintDebug("shader archive is truncated");
+            return std::unexpected(EmptyErr{});
+        }
+        //the view keeps the mapping and the file alive, the handles are not needed past it
+        HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (!fileMapping) {
+            vkInit::errprintDebug("failed to map shader archive");
+            return std::unexpected(EmptyErr{});
+        }
+        archive->mapping = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(fileMapping);
+        archive->size = static_cast<size_t>(size.QuadPart);
+#else
+        const int file = open(archivePath.c_str(), O_RDONLY);
+        if (file < 0) {
+            vkInit::errprintDebug("failed to open shader archive");
+            return std::unexpected(EmptyErr{});
+        }
+        struct stat status = {};
+        if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(ArchiveHeader))) {
+            close(file);
+            vkInit::errprintDebug("shader archive is truncated");
+            return std::unexpected(EmptyErr{});
+        }
+        //the mapping outlives the descriptor
+        void* view = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        close(file);
+        archive->mapping = view == MAP_FAILED ? nullptr : view;
+        archive->size = static_cast<size_t>(status.st_size);
+#endif
+        if (!archive->mapping) {
+            vkInit::errprintDebug("failed to map shader archive");
+            return std::unexpected(EmptyErr{});
+        }
+        if (!parse(*archive, archive->mapping))
+            return std::unexpected(EmptyErr{});
+        return archive;
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> ShaderLibrary::parse(Archive& archive, const void* data) noexcept {
+        const char* bytes = static_cast<const char*>(data);
+        if (archive.size < sizeof(ArchiveHeader)) {
+            vkInit::errprintDebug("shader archive is truncated");
+            return std::unexpected(EmptyErr{});
+        }
+        ArchiveHeader header;
+        std::memcpy(&header, bytes, sizeof(header));
+        if (header.magic != archiveMagic || header.version != archiveVersion
+            || sizeof(ArchiveHeader) + size_t(header.count) * sizeof(ArchiveEntry) > archive.size) {
+            vkInit::errprintDebug("shader archive has a foreign or broken header");
+            return std::unexpected(EmptyErr{});
+        }
+        //mappings are page aligned and words 16 byte aligned, the entries follow a 16 byte header
+        const ArchiveEntry* entries = reinterpret_cast<const ArchiveEntry*>(bytes + sizeof(ArchiveHeader));
+        for (uint32_t i = 0; i < header.count; i++) {
+            const ArchiveEntry& entry = entries[i];
+            if (entry.offset % sizeof(uint32_t) != 0 || entry.size % sizeof(uint32_t) != 0
+                || size_t(entry.offset) + entry.size > archive.size || entry.name[maxNameLength] != '\0') {
+                archive.blobs.clear();
+                vkInit::errprintDebug("shader archive has a broken entry");
+                return std::unexpected(EmptyErr{});
+            }
+            const uint32_t* words = reinterpret_cast<const uint32_t*>(bytes + entry.offset);
+            archive.blobs[std::string_view(entry.name)] = { entry.hash, std::span<const uint32_t>(words, entry.size / sizeof(uint32_t)) };
+        }
+        return EmptyOk{};
+    }
+}
@@ -0,0 +1,129 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.shaderLibrary;
+
+import <atomic>;
+import <expected>;
+import <memory>;
+import <mutex>;
+import <span>;
+import <string>;
+import <string_view>;
+import <unordered_map>;
+import <vector>;
+import vulkan_lib.jobSystem;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    export struct ShaderLibraryStats {
+        ///the archive was rebuilt from the .spv files at startup
+        bool repacked;
+        uint64_t archiveBytes;
+        uint32_t shaders;
+        uint32_t modulesCreated;
+        ///module requests answered with a module made before
+        uint32_t moduleHits;
+        uint32_t reloads;
+    };
+
+    ///progress of the archive a reload reads on a worker
+    export enum class ArchiveReload : uint32_t { None, Running, Swapped, Failed };
+
+    ///every spir-v blob of the engine, packed into one archive and mapped once.
+    ///
+    ///the archive is an index of names, content hashes, offsets and sizes
+    ///followed by the blobs, each 4 byte aligned so code hands out spans of
+    ///words straight from the mapping and createShaderModule reads them
+    ///without a copy. make repacks it when a .spv of the directory is newer,
+    ///a build that ships only the archive maps it as it is.
+    ///
+    ///begin_reload reads the .spv files into a new archive in memory on the job
+    ///system's background queue, finish_reload swaps it in at a frame boundary
+    ///without waiting. compiles still running hold on to the archive they
+    ///started with until they finish. the file on disk is repacked by the next
+    ///make that finds it stale.
+    ///
+    ///module keeps one shader module per content hash, two names with the same
+    ///code share it. modules of code a reload dropped live until purge_modules,
+    ///pipelines built from them may be created on any thread.
+    export class ShaderLibrary {
+    public:
+        ShaderLibrary();
+        ~ShaderLibrary();
+        ShaderLibrary(const ShaderLibrary& ref) = delete;
+        ShaderLibrary& operator=(const ShaderLibrary& ref) = delete;
+
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make(vk::Device device, std::string directory = ".",
+            std::string archivePath = "shaders.pak") noexcept;
+        ///waits for a reload still reading, destroys every module and unmaps the archive
+        void destroy() noexcept;
+        ///starts reading the .spv files into a new archive on a worker, false while the
+        ///last one was not finished
+        [[nodiscard]] bool begin_reload(JobSystem& jobs) noexcept;
+        ///swaps in the archive begin_reload read once it is complete, never blocks.
+        ///a failed read keeps the old archive
+        [[nodiscard]] ArchiveReload finish_reload() noexcept;
+        ///destroys the modules of code the last reload dropped. no pipeline may be
+        ///compiling, one could be creating from them
+        void purge_modules() noexcept;
+
+        ///the words of name inside the archive, valid until a reload swaps it
+        [[nodiscard]] std::expected<std::span<const uint32_t>, EmptyErr> code(std::string_view name) const noexcept;
+        ///thread safe
+        [[nodiscard]] std::expected<vk::ShaderModule, EmptyErr> module(std::string_view name) noexcept;
+
+        [[nodiscard]] ShaderLibraryStats stats() const noexcept;
+
+        ///writes every .spv of directory into one archive at archivePath
+        [[nodiscard]] static std::expected<EmptyOk, EmptyErr> pack(const std::string& directory,
+            const std::string& archivePath) noexcept;
+
+    private:
+        struct Blob {
+            uint64_t hash;
+            std::span<const uint32_t> code;
+        };
+
+        ///one packed archive, mapped from disk by make or read into memory by a reload
+        struct Archive {
+            Archive();
+            ~Archive();
+            Archive(const Archive& ref) = delete;
+            Archive& operator=(const Archive& ref) = delete;
+
+            ///the whole file, read only, null for an archive read into words
+            const void* mapping;
+            size_t size;
+            std::vector<uint32_t> words;
+            ///names point into the mapping or the words
+            std::unordered_map<std::string_view, Blob> blobs;
+        };
+
+        [[nodiscard]] static std::expected<std::shared_ptr<Archive>, EmptyErr> map(const std::string& archivePath) noexcept;
+        [[nodiscard]] static std::expected<EmptyOk, EmptyErr> parse(Archive& archive, const void* data) noexcept;
+        [[nodiscard]] std::shared_ptr<const Archive> current() const noexcept;
+
+        vk::Device device;
+        std::string directory;
+        std::string archivePath;
+        mutable std::mutex archiveMutex;
+        std::shared_ptr<const Archive> archive;
+        ///written by the reload job, read once reloading is done
+        std::shared_ptr<const Archive> loaded;
+        JobSystem* jobs;
+        JobCounter reloading;
+        bool reloadRunning;
+        ///a reload dropped code whose modules are still alive
+        bool staleModules;
+        std::mutex moduleMutex;
+        ///by content hash
+        std::unordered_map<uint64_t, vk::ShaderModule> modules;
+        bool repacked;
+        std::atomic<uint32_t> modulesCreated;
+        std::atomic<uint32_t> moduleHits;
+        uint32_t reloads;
+    };
+}
@@ -0,0 +1,215 @@
+module;
+
+#include <immintrin.h>
+
+module vulkan_lib.softwareOcclusion;
+
+import <algorithm>;
+import <cmath>;
+import <limits>;
+
+namespace vkl {
+
+    constexpr float farDepth = 1.0f;
+    constexpr float nearW = 1e-5f;
+    //boxes tested per job, one box is too little work to schedule
+    constexpr uint32_t boxGrain = 64;
+
+    SoftwareOcclusion::SoftwareOcclusion(uint32_t width, uint32_t height) {
+        tilesX = (width + tileWidth - 1) / tileWidth;
+        tilesY = (height + tileHeight - 1) / tileHeight;
+        this->width = tilesX * tileWidth;
+        this->height = tilesY * tileHeight;
+        depth.resize(this->width * this->height);
+        tileMaxDepth.resize(tilesX * tilesY);
+        clear();
+    }
+
+    void SoftwareOcclusion::clear() noexcept {
+        std::fill(depth.begin(), depth.end(), farDepth);
+        std::fill(tileMaxDepth.begin(), tileMaxDepth.end(), farDepth);
+        triangles.clear();
+    }
+
+    void SoftwareOcclusion::add_occluder(std::span<const float> vertices, const glm::mat4& modelViewProjection) noexcept {
+        const size_t vertexCount = vertices.size() / 7;
+        for (size_t first = 0; first + 2 < vertexCount; first += 3) {
+            glm::vec3 screen[3];
+            bool crossesNear = false;
+            for (size_t corner = 0; corner < 3; corner++) {
+                const float* vertex = vertices.data() + (first + corner) * 7;
+                glm::vec4 clip = modelViewProjection * glm::vec4(vertex[0], vertex[1], 0.0f, 1.0f);
+                if (clip.w <= nearW) {
+                    crossesNear = true;
+                    break;
+                }
+                glm::vec3 ndc = glm::vec3(clip) / clip.w;
+                screen[corner] = glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z);
+            }
+            if (crossesNear)
+                continue;
+
+            float area = (screen[1].x - screen[0].x) * (screen[2].y - screen[0].y) -
+                (screen[1].y - screen[0].y) * (screen[2].x - screen[0].x);
+            //occluders are rasterized from both sides
+            if (area < 0.0f) {
+                std::swap(screen[1], screen[2]);
+                area = -area;
+            }
+            if (area < 1e-6f)
+                continue;
+
+            Triangle triangle = {};
+            for (int edge = 0; edge < 3; edge++) {
+                const glm::vec3& a = screen[edge];
+                const glm::vec3& b = screen[(edge + 1) % 3];
+                float edgeA = a.y - b.y;
+                float edgeB = b.x - a.x;
+                //moved inward by half a pixel, the smallest value over a pixel is
+                //at a corner, so a center inside means the whole pixel is
+                float inset = 0.5f * (std::abs(edgeA) + std::abs(edgeB));
+                triangle.edges[edge] = glm::vec3(edgeA, edgeB, -(edgeA * a.x + edgeB * a.y) - inset);
+            }
+            float dzdx = ((screen[1].z - screen[0].z) * (screen[2].y - screen[0].y) -
+                (screen[2].z - screen[0].z) * (screen[1].y - screen[0].y)) / area;
+            float dzdy = ((screen[1].x - screen[0].x) * (screen[2].z - screen[0].z) -
+                (screen[1].z - screen[0].z) * (screen[2].x - screen[0].x)) / area;
+            //raised by the most the plane climbs from a pixel center to a corner, the value
+            //stored is the farthest the triangle gets over the pixel
+            triangle.depthPlane = glm::vec3(dzdx, dzdy, screen[0].z - dzdx * screen[0].x - dzdy * screen[0].y
+                + 0.5f * (std::abs(dzdx) + std::abs(dzdy)));
+
+            float minX = std::min({ screen[0].x, screen[1].x, screen[2].x });
+            float maxX = std::max({ screen[0].x, screen[1].x, screen[2].x });
+            float minY = std::min({ screen[0].y, screen[1].y, screen[2].y });
+            float maxY = std::max({ screen[0].y, screen[1].y, screen[2].y });
+            triangle.minX = std::max(0, static_cast<int>(std::floor(minX)));
+            triangle.maxX = std::min(static_cast<int>(width) - 1, static_cast<int>(std::ceil(maxX)));
+            triangle.minY = std::max(0, static_cast<int>(std::floor(minY)));
+            triangle.maxY = std::min(static_cast<int>(height) - 1, static_cast<int>(std::ceil(maxY)));
+            if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+                continue;
+            triangles.push_back(triangle);
+        }
+    }
+
+    void SoftwareOcclusion::rasterize(JobSystem& jobs) noexcept {
+        jobs.parallel_for(0, tilesY, 1, [this](uint32_t first, uint32_t last) {
+            for (uint32_t tileRow = first; tileRow < last; tileRow++)
+                rasterize_row(tileRow);
+        });
+    }
+
+    void SoftwareOcclusion::rasterize_row(uint32_t tileRow) noexcept {
+        const int rowBegin = static_cast<int>(tileRow * tileHeight);
+        const int rowEnd = rowBegin + static_cast<int>(tileHeight);
+        const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+
+        for (const Triangle& triangle : triangles) {
+            if (triangle.maxY < rowBegin || triangle.minY >= rowEnd)
+                continue;
+            const int yBegin = std::max(triangle.minY, rowBegin);
+            const int yEnd = std::min(triangle.maxY + 1, rowEnd);
+            //rows are a whole number of tiles wide, so 4 wide steps never leave the row
+            const int xBegin = triangle.minX & ~3;
+            const int xEnd = triangle.maxX + 1;
+
+            for (int y = yBegin; y < yEnd; y++) {
+                const float centerY = static_cast<float>(y) + 0.5f;
+                __m128 rowEdges[3];
+                for (int edge = 0; edge < 3; edge++)
+                    rowEdges[edge] = _mm_set1_ps(triangle.edges[edge].y * centerY + triangle.edges[edge].z);
+                const __m128 rowDepth = _mm_set1_ps(triangle.depthPlane.y * centerY + triangle.depthPlane.z);
+                float* row = depth.data() + static_cast<size_t>(y) * width;
+
+                for (int x = xBegin; x < xEnd; x += 4) {
+                    const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+                    __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edges[0].x), centerX), rowEdges[0]), zero);
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edges[1].x), centerX), rowEdges[1]), zero));
+                    inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edges[2].x), centerX), rowEdges[2]), zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+
+                    const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthPlane.x), centerX), rowDepth);
+                    const __m128 old = _mm_loadu_ps(row + x);
+                    const __m128 nearer = _mm_and_ps(inside, _mm_cmplt_ps(z, old));
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(nearer, z), _mm_andnot_ps(nearer, old)));
+                }
+            }
+        }
+
+        //hierarchical level, farthest depth of every tile in this row
+        for (uint32_t tileX = 0; tileX < tilesX; tileX++) {
+            __m128 farthest = _mm_set1_ps(std::numeric_limits<float>::lowest());
+            for (int y = rowBegin; y < rowEnd; y++) {
+                const float* row = depth.data() + static_cast<size_t>(y) * width + tileX * tileWidth;
+                farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(row), _mm_loadu_ps(row + 4)));
+            }
+            alignas(16) float lanes[4];
+            _mm_store_ps(lanes, farthest);
+            tileMaxDepth[tileRow * tilesX + tileX] = std::max({ lanes[0], lanes[1], lanes[2], lanes[3] });
+        }
+    }
+
+    [[nodiscard]] bool SoftwareOcclusion::test_box(const Aabb& box, const glm::mat4& viewProjection) const noexcept {
+        glm::vec2 screenMin(std::numeric_limits<float>::max());
+        glm::vec2 screenMax(std::numeric_limits<float>::lowest());
+        float nearest = std::numeric_limits<float>::max();
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 position((corner & 1) ? box.max.x : box.min.x,
+                (corner & 2) ? box.max.y : box.min.y,
+                (corner & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+            //part of the box is behind the camera, it may cover the whole screen
+            if (clip.w <= nearW)
+                return true;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            glm::vec2 screen((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height);
+            screenMin = glm::min(screenMin, screen);
+            screenMax = glm::max(screenMax, screen);
+            nearest = std::min(nearest, ndc.z);
+        }
+
+        const int xBegin = std::max(0, static_cast<int>(std::floor(screenMin.x)));
+        const int yBegin = std::max(0, static_cast<int>(std::floor(screenMin.y)));
+        const int xEnd = std::min(static_cast<int>(width), static_cast<int>(std::ceil(screenMax.x)));
+        const int yEnd = std::min(static_cast<int>(height), static_cast<int>(std::ceil(screenMax.y)));
+        if (xBegin >= xEnd || yBegin >= yEnd)
+            return false;
+
+        const __m128 nearestDepth = _mm_set1_ps(nearest);
+        const __m128 laneOffsets = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        const __m128 first = _mm_set1_ps(static_cast<float>(xBegin));
+        const __m128 last = _mm_set1_ps(static_cast<float>(xEnd));
+        for (int tileY = yBegin / static_cast<int>(tileHeight); tileY <= (yEnd - 1) / static_cast<int>(tileHeight); tileY++) {
+            for (int tileX = xBegin / static_cast<int>(tileWidth); tileX <= (xEnd - 1) / static_cast<int>(tileWidth); tileX++) {
+                //everything in the tile is nearer than the box
+                if (tileMaxDepth[tileY * tilesX + tileX] < nearest)
+                    continue;
+                const int rowBegin = std::max(yBegin, tileY * static_cast<int>(tileHeight));
+                const int rowEnd = std::min(yEnd, (tileY + 1) * static_cast<int>(tileHeight));
+                const int columnBegin = tileX * static_cast<int>(tileWidth);
+                for (int y = rowBegin; y < rowEnd; y++) {
+                    const float* row = depth.data() + static_cast<size_t>(y) * width;
+                    for (int x = columnBegin; x < columnBegin + static_cast<int>(tileWidth); x += 4) {
+                        const __m128 lane = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+                        const __m128 covered = _mm_and_ps(_mm_cmpge_ps(lane, first), _mm_cmplt_ps(lane, last));
+                        const __m128 behind = _mm_cmpge_ps(_mm_loadu_ps(row + x), nearestDepth);
+                        if (_mm_movemask_ps(_mm_and_ps(covered, behind)) != 0)
+                            return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    void SoftwareOcclusion::test_boxes(std::span<const Aabb> boxes, const glm::mat4& viewProjection, std::span<uint8_t> visible,
+        JobSystem& jobs) const noexcept {
+        jobs.parallel_for(0, static_cast<uint32_t>(boxes.size()), boxGrain, [&](uint32_t first, uint32_t last) {
+            for (uint32_t i = first; i < last; i++)
+                visible[i] = test_box(boxes[i], viewProjection) ? 1 : 0;
+        });
+    }
+}
@@ -0,0 +1,61 @@
+export module vulkan_lib.softwareOcclusion;
+
+import <span>;
+import <vector>;
+import <glm/glm.hpp>;
+import vulkan_lib.bounds;
+import vulkan_lib.jobSystem;
+
+namespace vkl {
+
+    ///cpu occlusion culling for when gpu driven culling is not available.
+    ///a few occluder meshes are rasterized with sse into a low resolution
+    ///depth buffer, split in rows of tiles that are filled in parallel, and
+    ///every tile keeps the farthest depth it holds. boxes are rejected when
+    ///their nearest depth is behind everything under their screen rect.
+    ///
+    ///occluders only write pixels they cover whole, with the farthest depth
+    ///they reach over the pixel, so the buffer never claims more occlusion
+    ///than the meshes give.
+    ///
+    ///depth is the clip space z / w, the same value the gpu depth test compares.
+    export class SoftwareOcclusion {
+    public:
+        static constexpr uint32_t tileWidth = 8;
+        static constexpr uint32_t tileHeight = 8;
+
+        ///width and height are rounded up to whole tiles
+        SoftwareOcclusion(uint32_t width = 256, uint32_t height = 128);
+
+        void clear() noexcept;
+        ///transforms and sets up the triangles of one occluder. vertices use the
+        ///7 float layout of VertexManager with the position in the first two.
+        ///triangles crossing the camera plane are dropped, which only makes the
+        ///buffer less occluding and keeps the test conservative
+        void add_occluder(std::span<const float> vertices, const glm::mat4& modelViewProjection) noexcept;
+        ///rasterizes every added triangle, one tile row per job
+        void rasterize(JobSystem& jobs) noexcept;
+
+        ///false when the box is certainly hidden or outside the screen
+        [[nodiscard]] bool test_box(const Aabb& box, const glm::mat4& viewProjection) const noexcept;
+        ///tests every box in parallel, visible[i] is 1 if boxes[i] may be seen
+        void test_boxes(std::span<const Aabb> boxes, const glm::mat4& viewProjection, std::span<uint8_t> visible, JobSystem& jobs) const noexcept;
+
+    private:
+        struct Triangle {
+            //edge functions a * x + b * y + c, positive at the centers of pixels fully inside
+            glm::vec3 edges[3];
+            //depth plane z = a * x + b * y + c, at a pixel center gives the farthest depth over the pixel
+            glm::vec3 depthPlane;
+            int minX, minY, maxX, maxY;
+        };
+
+        void rasterize_row(uint32_t tileRow) noexcept;
+
+        uint32_t width, height;
+        uint32_t tilesX, tilesY;
+        std::vector<float> depth;
+        std::vector<float> tileMaxDepth;
+        std::vector<Triangle> triangles;
+    };
+}
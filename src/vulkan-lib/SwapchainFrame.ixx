@@ -9,9 +9,13 @@ import <glm/glm.hpp>;
 import <expected>;
 import vulkan_lib.result;
 import vulkan_lib.logging;
+import vulkan_lib.descriptorCache;
 
 export namespace vkInit {
 
+    ///vec4 words a frame starts with room for, 256 full matrices. grows past it on demand
+    constexpr size_t initialInstanceWords = 256 * 4;
+
     struct UBO{
         glm::mat4 view;
         glm::mat4 projection;
@@ -21,22 +25,28 @@ export namespace vkInit {
     export struct SwapchainFrame{
         vk::Image image;
         vk::ImageView view;
-        vk::Framebuffer framebuffer;
-        vk::CommandBuffer commandbuffer;
-        //sync
+        //sync, binary since acquire and present take no timeline semaphores
         vk::Semaphore imageAvailable, renderFinished;
-        vk::Fence inFlightFence;
 
         vk::DescriptorBufferInfo uniformBufferDescriptor;
         vk::DescriptorBufferInfo modelBufferDescriptor;
+        vk::DescriptorBufferInfo drawListDescriptor;
+        vk::DescriptorBufferInfo sceneIdDescriptor;
+        vk::DescriptorBufferInfo materialIdDescriptor;
         vk::DescriptorSet descriptorSet;
 
         UBO cameraData;
         vkUtil::Buffer cameraDataBuffer;
         void *cameraDataWriteLocation;
-        std::vector<glm::mat4>modelTransforms;
-        vkUtil::Buffer modelBuffer;
-        void *modelBufferWriteLocation;
+        ///encoded in the engine's InstanceFormat
+        vkUtil::GrowableBuffer<glm::vec4> instances;
+        ///one per instance, indexes the material table of the bindless set.
+        ///pushed with the draws, never written to a set
+        vkUtil::GrowableBuffer<uint32_t> materialIds;
+        ///scene index of every instance. the tint and the cull's visibility are
+        ///kept per scene instance, a slot holds another one when the visible set changes
+        vkUtil::GrowableBuffer<uint32_t> sceneIds;
+        uint32_t instanceCount;
 
         std::expected<EmptyOk, EmptyErr> make_descriptor_resources(vk::Device device, vk::PhysicalDevice physicalDevice){
             //camera
@@ -66,47 +76,49 @@ export namespace vkInit {
 
             //model
 
-            input.size = 1024 * sizeof(glm::mat4);
-            input.usage = vk::BufferUsageFlagBits::eStorageBuffer;
-            auto modelBuffRes = vkUtil::createBuffer(input);
-            if (!modelBuffRes) {
+            if (!instances.make(device, physicalDevice, vk::BufferUsageFlagBits::eStorageBuffer, initialInstanceWords))
                 return std::unexpected(EmptyErr{});
-            }
-            modelBuffer = modelBuffRes.value();
-            vk::ResultValue<void *> resultModel = device.mapMemory(modelBuffer.bufferMemory, 0, sizeof(UBO));
-            if (resultModel.result != vk::Result::eSuccess){
-                errprintDebug("Failed to map memory");
+            modelBufferDescriptor = instances.descriptor();
+
+            //materials
+
+            if (!materialIds.make(device, physicalDevice, vk::BufferUsageFlagBits::eStorageBuffer, initialInstanceWords / 4))
                 return std::unexpected(EmptyErr{});
-            }
-            modelBufferWriteLocation = resultModel.value;
-        
-            modelTransforms.reserve(1024);
-            for (uint32_t i  = 0; i < 1024; i++){
-                modelTransforms.push_back(glm::mat4(1.0f));
-            }
+            materialIdDescriptor = materialIds.descriptor();
+
+            //scene indices
 
-            modelBufferDescriptor.buffer = modelBuffer.buffer;
-            modelBufferDescriptor.offset = 0;
-            modelBufferDescriptor.range = sizeof(glm::mat4) * 1024;
+            if (!sceneIds.make(device, physicalDevice, vk::BufferUsageFlagBits::eStorageBuffer, initialInstanceWords / 4))
+                return std::unexpected(EmptyErr{});
+            sceneIdDescriptor = sceneIds.descriptor();
             return EmptyOk{};
         }
-        void write_descriptor_set(vk::Device device){
-            vk::WriteDescriptorSet writeInfo = {};
-            writeInfo.dstSet = descriptorSet;
-            writeInfo.dstBinding = 0;
-            writeInfo.descriptorCount = 1;
-            writeInfo.descriptorType = vk::DescriptorType::eUniformBuffer;
-            writeInfo.pBufferInfo = &uniformBufferDescriptor;
-            device.updateDescriptorSets(writeInfo, nullptr);
-            
-            vk::WriteDescriptorSet writeInfo2 = {};
-            writeInfo2.dstSet = descriptorSet;
-            writeInfo2.dstBinding = 1;
-            writeInfo2.descriptorCount = 1;
-            writeInfo2.descriptorType = vk::DescriptorType::eStorageBuffer;
-            writeInfo2.pBufferInfo = &modelBufferDescriptor;
-            device.updateDescriptorSets(writeInfo2, nullptr);
-
+        ///true when the model or scene index buffer was replaced and the sets reading them must be
+        ///written again. the material ids grow too, draws push whichever buffer is current
+        std::expected<bool, EmptyErr> reserve_instances(size_t words, size_t count){
+            auto grown = instances.reserve(words);
+            if (!grown)
+                return grown;
+            if (grown.value())
+                modelBufferDescriptor = instances.descriptor();
+            auto grownIds = materialIds.reserve(count);
+            if (!grownIds)
+                return grownIds;
+            if (grownIds.value())
+                materialIdDescriptor = materialIds.descriptor();
+            auto grownScene = sceneIds.reserve(count);
+            if (!grownScene)
+                return grownScene;
+            if (grownScene.value())
+                sceneIdDescriptor = sceneIds.descriptor();
+            return grown.value() || grownScene.value();
+        }
+        ///queues the set's bindings, the cache drops the ones that did not change
+        void write_descriptor_set(vkl::DescriptorWriteCache& cache){
+            cache.write_buffer(descriptorSet, 0, vk::DescriptorType::eUniformBuffer, uniformBufferDescriptor);
+            cache.write_buffer(descriptorSet, 1, vk::DescriptorType::eStorageBuffer, modelBufferDescriptor);
+            cache.write_buffer(descriptorSet, 2, vk::DescriptorType::eStorageBuffer, drawListDescriptor);
+            cache.write_buffer(descriptorSet, 3, vk::DescriptorType::eStorageBuffer, sceneIdDescriptor);
         }
     };
 }
@@ -22,6 +22,24 @@ namespace vkInit{
         return semaphoreR.value;
     }
 
+    ///timeline semaphore counting up from initialValue, see vkl::QueueTimeline
+    export [[nodiscard]] inline auto
+    make_timeline_semaphore(vk::Device device, uint64_t initialValue = 0) noexcept -> std::expected<vk::Semaphore, EmptyErr> {
+        vk::SemaphoreTypeCreateInfo typeInfo = {};
+        typeInfo.semaphoreType = vk::SemaphoreType::eTimeline;
+        typeInfo.initialValue = initialValue;
+        vk::SemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.pNext = &typeInfo;
+
+        vk::ResultValue<vk::Semaphore> semaphoreR = device.createSemaphore(semaphoreInfo);
+        if (semaphoreR.result != vk::Result::eSuccess){
+            if constexpr (_DEBUG)
+                std::cerr << "Failed to create timeline semaphore\n";
+            return std::unexpected(EmptyErr{});
+        }
+        return semaphoreR.value;
+    }
+
     export [[nodiscard]] inline auto
      make_fence(vk::Device device) noexcept -> std::expected<vk::Fence, EmptyErr> {
         vk::FenceCreateInfo fenceInfo= {};
@@ -0,0 +1,121 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+module vulkan_lib.timeline;
+
+import <limits>;
+import vulkan_lib.sync;
+import vulkan_lib.logging;
+
+namespace vkl {
+
+    QueueTimeline::QueueTimeline() : submittedValue(0), completedValue(0), cpuWaits(0), released(0) {
+    }
+
+    QueueTimeline::~QueueTimeline() {
+        destroy();
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> QueueTimeline::make(vk::Device device) noexcept {
+        destroy();
+        this->device = device;
+        auto timeline_res = vkInit::make_timeline_semaphore(device);
+        if (!timeline_res)
+            return std::unexpected(EmptyErr{});
+        timeline = timeline_res.value();
+        submittedValue = 0;
+        completedValue = 0;
+        return EmptyOk{};
+    }
+
+    void QueueTimeline::destroy() noexcept {
+        if (!timeline)
+            return;
+        for (Release& entry : releases)
+            entry.release();
+        released += releases.size();
+        releases.clear();
+        device.destroySemaphore(timeline);
+        timeline = nullptr;
+    }
+
+    [[nodiscard]] vk::Semaphore QueueTimeline::semaphore() const noexcept {
+        return timeline;
+    }
+
+    [[nodiscard]] uint64_t QueueTimeline::next() const noexcept {
+        return submittedValue + 1;
+    }
+
+    void QueueTimeline::commit(uint64_t value) noexcept {
+        assert(value == submittedValue + 1);
+        submittedValue = value;
+    }
+
+    [[nodiscard]] uint64_t QueueTimeline::submitted() const noexcept {
+        return submittedValue;
+    }
+
+    [[nodiscard]] std::expected<uint64_t, EmptyErr> QueueTimeline::completed() noexcept {
+        if (completedValue == submittedValue)
+            return completedValue;
+        vk::ResultValue<uint64_t> valueR = device.getSemaphoreCounterValue(timeline);
+        if (valueR.result != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to read timeline value");
+            return std::unexpected(EmptyErr{});
+        }
+        completedValue = valueR.value;
+        return completedValue;
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> QueueTimeline::wait(uint64_t value) noexcept {
+        auto completed_res = completed();
+        if (!completed_res)
+            return std::unexpected(EmptyErr{});
+        if (completed_res.value() >= value)
+            return EmptyOk{};
+
+        vk::SemaphoreWaitInfo waitInfo = {};
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &timeline;
+        waitInfo.pValues = &value;
+        if (device.waitSemaphores(waitInfo, std::numeric_limits<uint64_t>::max()) != vk::Result::eSuccess) {
+            vkInit::errprintDebug("failed to wait for timeline value");
+            return std::unexpected(EmptyErr{});
+        }
+        cpuWaits++;
+        completedValue = value;
+        return EmptyOk{};
+    }
+
+    void QueueTimeline::defer(uint64_t value, std::function<void()> release) {
+        releases.push_back({ value, std::move(release) });
+    }
+
+    [[nodiscard]] std::expected<EmptyOk, EmptyErr> QueueTimeline::collect() noexcept {
+        if (releases.empty())
+            return EmptyOk{};
+        auto completed_res = completed();
+        if (!completed_res)
+            return std::unexpected(EmptyErr{});
+        while (!releases.empty() && releases.front().value <= completed_res.value()) {
+            releases.front().release();
+            releases.pop_front();
+            released++;
+        }
+        return EmptyOk{};
+    }
+
+    [[nodiscard]] vk::SemaphoreSubmitInfo QueueTimeline::signal_info(uint64_t value, vk::PipelineStageFlags2 stages) const noexcept {
+        return vk::SemaphoreSubmitInfo(timeline, value, stages);
+    }
+
+    [[nodiscard]] vk::SemaphoreSubmitInfo QueueTimeline::wait_info(uint64_t value, vk::PipelineStageFlags2 stages) const noexcept {
+        return vk::SemaphoreSubmitInfo(timeline, value, stages);
+    }
+
+    [[nodiscard]] TimelineStats QueueTimeline::stats() const noexcept {
+        return { submittedValue, completedValue, cpuWaits, released };
+    }
+}
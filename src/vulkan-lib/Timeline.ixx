@@ -0,0 +1,81 @@
+module;
+
+#include "vulkan-lib/Config.h"
+
+export module vulkan_lib.timeline;
+
+import <deque>;
+import <expected>;
+import <functional>;
+import vulkan_lib.result;
+
+namespace vkl {
+
+    export struct TimelineStats {
+        uint64_t submitted;
+        uint64_t completed;
+        ///waits that had to block, waits on values already reached are free
+        uint64_t cpuWaits;
+        ///releases run once their value completed
+        uint64_t released;
+    };
+
+    ///the one timeline semaphore of a queue.
+    ///
+    ///every submission to the queue signals the next value, so work N is done
+    ///once the counter reads N and a single semaphore stands in for a fence per
+    ///frame. other queues wait on a value to depend on the work before it, and
+    ///resources the gpu may still read are handed to defer with the value of the
+    ///last submission that used them instead of waiting for the device to idle.
+    export class QueueTimeline {
+    public:
+        QueueTimeline();
+        ~QueueTimeline();
+        QueueTimeline(const QueueTimeline& ref) = delete;
+        QueueTimeline& operator=(const QueueTimeline& ref) = delete;
+
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> make(vk::Device device) noexcept;
+        ///runs the pending releases, the queue must be idle
+        void destroy() noexcept;
+
+        [[nodiscard]] vk::Semaphore semaphore() const noexcept;
+        ///value the next submission signals. it only counts as submitted once
+        ///commit is called after the submit succeeded, a failed submit leaves it
+        ///to the next one instead of a value nothing will ever signal
+        [[nodiscard]] uint64_t next() const noexcept;
+        ///the submission signaling value, taken from next, reached the queue
+        void commit(uint64_t value) noexcept;
+        ///value of the last submission
+        [[nodiscard]] uint64_t submitted() const noexcept;
+        ///value the gpu reached, only queried when the last known one is behind
+        [[nodiscard]] std::expected<uint64_t, EmptyErr> completed() noexcept;
+        ///blocks until value completed
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> wait(uint64_t value) noexcept;
+
+        ///runs release once value completed, values are deferred in submission order
+        void defer(uint64_t value, std::function<void()> release);
+        ///runs the releases whose value completed
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> collect() noexcept;
+
+        ///for a submit2 that signals value
+        [[nodiscard]] vk::SemaphoreSubmitInfo signal_info(uint64_t value, vk::PipelineStageFlags2 stages) const noexcept;
+        ///for a submit2 on another queue that waits for value
+        [[nodiscard]] vk::SemaphoreSubmitInfo wait_info(uint64_t value, vk::PipelineStageFlags2 stages) const noexcept;
+
+        [[nodiscard]] TimelineStats stats() const noexcept;
+
+    private:
+        struct Release {
+            uint64_t value;
+            std::function<void()> release;
+        };
+
+        vk::Device device;
+        vk::Semaphore timeline;
+        uint64_t submittedValue;
+        uint64_t completedValue;
+        std::deque<Release> releases;
+        uint64_t cpuWaits;
+        uint64_t released;
+    };
+}
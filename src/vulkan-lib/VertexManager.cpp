@@ -5,6 +5,8 @@ module;
 module vulkan_lib.vertexManager;
 
 import <expected>;
+import <limits>;
+import <algorithm>;
 
 VertexManager::VertexManager(){
     offset = 0;
@@ -20,10 +22,34 @@ void VertexManager::consume(MeshType type, const std::vector<float>& vertexData)
     offsets[static_cast<size_t>(type)] = offset;
     sizes[static_cast<size_t>(type)] = vertexCount;
     offset += vertexCount;
+
+    //positions are the first two floats of every 7 float vertex
+    glm::vec2 minPos(std::numeric_limits<float>::max());
+    glm::vec2 maxPos(std::numeric_limits<float>::lowest());
+    for (uint32_t i = 0; i < vertexCount; i++){
+        glm::vec2 position(vertexData[i * 7], vertexData[i * 7 + 1]);
+        minPos = glm::min(minPos, position);
+        maxPos = glm::max(maxPos, position);
+    }
+    glm::vec2 center = (minPos + maxPos) * 0.5f;
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < vertexCount; i++){
+        glm::vec2 position(vertexData[i * 7], vertexData[i * 7 + 1]);
+        radius = std::max(radius, glm::length(position - center));
+    }
+    bounds[static_cast<size_t>(type)] = glm::vec4(center, 0.0f, radius);
+}
+
+[[nodiscard]] std::span<const float> VertexManager::vertices(MeshType type) const noexcept{
+    return std::span<const float>(lump).subspan(offsets[static_cast<size_t>(type)] * 7, sizes[static_cast<size_t>(type)] * 7);
 }
     
-[[nodiscard]] std::expected<EmptyOk, EmptyErr> VertexManager::finalize(vk::Device device, vk::PhysicalDevice physicalDevice, vk::Queue transferQueue, vk::CommandBuffer cmdBuffer) noexcept{
+[[nodiscard]] std::expected<EmptyOk, EmptyErr> VertexManager::finalize(vk::Device device, vk::PhysicalDevice physicalDevice, vk::Queue transferQueue, vk::CommandBuffer cmdBuffer,
+    vkl::QueueTimeline& transferTimeline, std::span<const uint32_t> queueFamilies) noexcept{
     this->device = device;
+    //the command buffer is reset below, the previous upload must be done with it
+    if (!transferTimeline.wait(transferTimeline.submitted()))
+        return std::unexpected(EmptyErr{});
     vkUtil::BufferInput inputBundle;
     inputBundle.device = device;
     inputBundle.physicalDevice = physicalDevice;
@@ -47,6 +73,8 @@ void VertexManager::consume(MeshType type, const std::vector<float>& vertexData)
     deviceLocalBundle.size = lump.size() * sizeof(float);
     deviceLocalBundle.usage = vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eTransferDst;
     deviceLocalBundle.properties = vk::MemoryPropertyFlagBits::eDeviceLocal;
+    //written on the transfer family and read on graphics, shared so no ownership transfer is needed
+    deviceLocalBundle.queueFamilies = queueFamilies;
     auto vertexBufferRes = vkUtil::createBuffer(deviceLocalBundle);
     if (!vertexBufferRes) {
         return std::unexpected(EmptyErr{});
@@ -62,12 +90,20 @@ void VertexManager::consume(MeshType type, const std::vector<float>& vertexData)
     copyInfo.region.dstOffset = 0;
     copyInfo.region.srcOffset = 0;
     copyInfo.region.size = lump.size() * sizeof(float);
+    copyInfo.timeline = transferTimeline.semaphore();
+    copyInfo.signalValue = transferTimeline.next();
 
     auto copyRes = vkUtil::copyBuffer(copyInfo);
     if (!copyRes) {
+        device.destroyBuffer(stagingBuffer.buffer);
+        device.freeMemory(stagingBuffer.bufferMemory);
         return std::unexpected(EmptyErr{});
     }
-    device.destroyBuffer(stagingBuffer.buffer);
-    device.freeMemory(stagingBuffer.bufferMemory);
+    transferTimeline.commit(copyInfo.signalValue);
+    //the copy still reads the staging buffer, it goes once the transfer queue is past it
+    transferTimeline.defer(copyInfo.signalValue, [device, stagingBuffer]() {
+        device.destroyBuffer(stagingBuffer.buffer);
+        device.freeMemory(stagingBuffer.bufferMemory);
+    });
     return EmptyOk{};
 }
@@ -5,18 +5,29 @@ export module vulkan_lib.vertexManager;
 import vulkan_lib.scene;
 import <array>;
 import <expected>;
+import <span>;
+import <glm/glm.hpp>;
 import vulkan_lib.memory;
 import vulkan_lib.result;
+import vulkan_lib.timeline;
 
 export class VertexManager{
     public:
         VertexManager();
         ~VertexManager();
         void consume(MeshType type, const std::vector<float>& vertexData) noexcept;
-        [[nodiscard]] std::expected<EmptyOk, EmptyErr> finalize(vk::Device device, vk::PhysicalDevice physicalDevice, vk::Queue transferQueue, vk::CommandBuffer cmdBuffer) noexcept;
+        ///uploads the meshes on the transfer queue without waiting, the vertex buffer
+        ///is ready once transferTimeline reaches its submitted value. queueFamilies
+        ///are the distinct families that copy into and draw from it
+        [[nodiscard]] std::expected<EmptyOk, EmptyErr> finalize(vk::Device device, vk::PhysicalDevice physicalDevice, vk::Queue transferQueue, vk::CommandBuffer cmdBuffer,
+            vkl::QueueTimeline& transferTimeline, std::span<const uint32_t> queueFamilies) noexcept;
+        ///cpu copy of a mesh, 7 floats per vertex, used for software occlusion
+        [[nodiscard]] std::span<const float> vertices(MeshType type) const noexcept;
         vkUtil::Buffer vertexBuffer;
         std::array<uint32_t, static_cast<size_t>(MeshType::NUM)> offsets;
         std::array<uint32_t, static_cast<size_t>(MeshType::NUM)> sizes;
+        ///object space bounding sphere of each mesh, xyz center and w radius
+        std::array<glm::vec4, static_cast<size_t>(MeshType::NUM)> bounds;
     private:
         uint32_t offset;
         vk::Device device;
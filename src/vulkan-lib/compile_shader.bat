@@ -1,3 +1,11 @@
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shader.frag -o fragment.spv
 C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shader.vert -o vertex.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shader.vert -DINSTANCE_AFFINE -o vertex_affine.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shader.vert -DINSTANCE_QUAT -o vertex_quat.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe shader.vert -DINSTANCE_QUAT_HALF -o vertex_quat_half.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe depth_reduce.comp -o depth_reduce.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe occlusion_cull.comp -o occlusion_cull.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe occlusion_cull.comp -DINSTANCE_AFFINE -o occlusion_cull_affine.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe occlusion_cull.comp -DINSTANCE_QUAT -o occlusion_cull_quat.spv
+C:\VulkanSDK\1.3.268.0\Bin\glslc.exe occlusion_cull.comp -DINSTANCE_QUAT_HALF -o occlusion_cull_quat_half.spv
 
@@ -1,12 +1,28 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec4 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) flat in uint fragMaterial;
 
 layout(location = 0) out vec4 outColor;
 
-layout(set = 1, binding = 0) uniform sampler2D material;
+struct Material {
+    vec4 color;
+    uint texture;
+    uint padding0, padding1, padding2;
+};
+
+// set 1 is the bindless set, the material table is the first of its buffers
+#define MATERIAL_TABLE 0
+
+layout(std430, set = 1, binding = 0) readonly buffer Materials {
+    Material materials[];
+} buffers[];
+
+layout(set = 1, binding = 1) uniform sampler2D textures[];
 
 void main(){
-    outColor = fragColor * texture(material, fragTexCoord);
+    Material material = buffers[MATERIAL_TABLE].materials[fragMaterial];
+    outColor = fragColor * material.color * texture(textures[nonuniformEXT(material.texture)], fragTexCoord);
 }
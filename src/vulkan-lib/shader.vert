@@ -1,4 +1,5 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout(set = 0, binding = 0) uniform UBO {
     mat4 view;
@@ -6,9 +7,34 @@ layout(set = 0, binding = 0) uniform UBO {
     mat4 viewProjection;
 } cameraData;
 
-layout(std140,set = 0, binding = 1) readonly buffer storageBuffer{
-    mat4 model[];
-}ObjectData;
+#define INSTANCE_BINDING 1
+#include "instance_format.glsl"
+
+// instance indices that survived the occlusion cull
+layout(set = 0, binding = 2) readonly buffer DrawList{
+    uint indices[];
+}drawList;
+
+// scene index of every instance, the list above only holds the ones that survived the frustum
+layout(set = 0, binding = 3) readonly buffer SceneIds{
+    uint ids[];
+}sceneIds;
+
+// material of every instance, indexes the table in the bindless set. pushed per draw
+layout(set = 2, binding = 0) readonly buffer MaterialIds{
+    uint ids[];
+}materialIds;
+
+#define NO_MATERIAL 0xFFFFFFFFu
+
+// set per pipeline variant, a variant without it has the tint compiled out
+layout(constant_id = 0) const bool INSTANCE_COLORS = true;
+
+layout(push_constant) uniform Draw{
+    mat4 model;
+    uint material;
+    uint drawIndex;
+}draw;
 
 layout(location = 0) in vec2 vertexPosition;
 layout(location = 1) in vec3 vertexColor;
@@ -16,16 +42,22 @@ layout(location = 2) in vec2 vertexTexCoord;
 
 layout(location = 0) out vec4 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) flat out uint fragMaterial;
 
 void main() {
-    int instance_index = gl_InstanceIndex;
-    vec2 pos = vertexPosition + vec2(0, instance_index * 1.0f); 
-    gl_Position = cameraData.viewProjection * ObjectData.model[0] * vec4(pos, 0.0, 1.0);
-    if (instance_index == 0)
-        fragColor = vec4(1.0f, 1.0f,1.0f,0.1f);
-    if (instance_index == 1)
-        fragColor = vec4(0.0f, 1.0f,0.0f, 1.0f);
-    if (instance_index == 2)
-        fragColor = vec4(0.0f, 0.0f,1.0f, 1.0f);
+    uint instance_index = drawList.indices[gl_InstanceIndex];
+    gl_Position = cameraData.viewProjection * draw.model * instance_transform(instance_index) * vec4(vertexPosition, 0.0, 1.0);
+    fragColor = vec4(vertexColor, 1.0f);
+    if (INSTANCE_COLORS) {
+        // by scene index, a slot holds another instance whenever the visible set changes
+        uint scene_index = sceneIds.ids[instance_index];
+        if (scene_index == 0)
+            fragColor = vec4(1.0f, 1.0f,1.0f,0.1f);
+        if (scene_index == 1)
+            fragColor = vec4(0.0f, 1.0f,0.0f, 1.0f);
+        if (scene_index == 2)
+            fragColor = vec4(0.0f, 0.0f,1.0f, 1.0f);
+    }
     fragTexCoord = vertexTexCoord;
+    fragMaterial = draw.material != NO_MATERIAL ? draw.material : materialIds.ids[instance_index];
 }